@@ -0,0 +1,42 @@
+#include "../../common/workingdirectory/WorkingDirectoryManager.h"
+
+#include "orders/OrderManager.h"
+#include "orders/OrdersBrowserModel.h"
+
+#include "PaneOrders.h"
+#include "ui_PaneOrders.h"
+
+PaneOrders::PaneOrders(QWidget *parent)
+    : QWidget(parent)
+    , ui(new Ui::PaneOrders)
+{
+    ui->setupUi(this);
+
+    QDir workingDir{WorkingDirectoryManager::instance()->workingDir()};
+
+    auto *ordersBrowserModel
+        = new OrdersBrowserModel{QSharedPointer<OrderManager>::create(workingDir), ui->tableShipments};
+    ui->tableShipments->setModel(ordersBrowserModel);
+    ui->tableShipments->sortByColumn(OrdersBrowserModel::ColumnDate, Qt::DescendingOrder);
+    ui->labelLoading->setVisible(ordersBrowserModel->isLoading());
+
+    _connectSlots();
+}
+
+void PaneOrders::_connectSlots()
+{
+    auto *ordersBrowserModel = static_cast<OrdersBrowserModel *>(ui->tableShipments->model());
+    connect(ui->lineEditOrderId,
+            &QLineEdit::textChanged,
+            ordersBrowserModel,
+            &OrdersBrowserModel::setOrderIdFilter);
+    connect(ordersBrowserModel,
+            &OrdersBrowserModel::loadingChanged,
+            ui->labelLoading,
+            &QLabel::setVisible);
+}
+
+PaneOrders::~PaneOrders()
+{
+    delete ui;
+}
@@ -1,4 +1,7 @@
 SET(PANES_FILES
+    ${CMAKE_CURRENT_LIST_DIR}/PaneOrders.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/PaneOrders.h
+    ${CMAKE_CURRENT_LIST_DIR}/PaneOrders.ui
     ${CMAKE_CURRENT_LIST_DIR}/PaneSettings.cpp
     ${CMAKE_CURRENT_LIST_DIR}/PaneSettings.h
     ${CMAKE_CURRENT_LIST_DIR}/PaneSettings.ui
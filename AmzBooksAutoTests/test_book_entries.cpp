@@ -11,6 +11,8 @@
 #include "CurrencyRateManager.h"
 #include "orders/ActivitySource.h"
 #include "orders/Shipment.h"
+#include "orders/OrderManager.h"
+#include "orders/ShipmentCursor.h"
 #include "books/Activity.h"
 #include <QTemporaryDir>
 #include <QCoroTask>
@@ -50,6 +52,8 @@ private slots:
     void test_factory_shipment_no_conversion();
     void test_factory_shipment_with_conversion();
     void test_factory_shipment_mixed_rates();
+    void test_factory_shipment_cursor();
+    void test_factory_regenerate_dirty();
 };
 
 void TestBookEntries::test_journal_entry_simple()
@@ -1143,6 +1147,138 @@ void TestBookEntries::test_factory_shipment_mixed_rates()
     QCOMPARE(countCustomerEUR, 1);
     QCOMPARE(countCustomerUSD, 1);
 }
+void TestBookEntries::test_factory_shipment_cursor()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QDir dir(tempDir.path());
+
+    QFile companyFile(dir.filePath("company.csv"));
+    companyFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream out(&companyFile);
+    out << "Id;Parameter;Value\n";
+    out << "Currency;Currency;EUR\n";
+    out << "Country;Country Code;FR\n";
+    companyFile.close();
+
+    CompanyInfosTable companyInfos(dir);
+    CurrencyRateManager currencyManager(dir, "");
+    SaleBookAccountsTable saleAccounts(dir);
+    PurchaseBookAccountsTable purchaseAccounts(dir, "FR");
+    JournalTable journalTable(dir);
+    JournalEntryFactory factory(&currencyManager, &companyInfos, &saleAccounts, &purchaseAccounts, &journalTable);
+
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "amazon.fr", "VAT Report"};
+    OrderManager orderManager(dir);
+    const QList<double> rates{0.2, 0.055};
+    for (int i = 0; i < 10; ++i) {
+        const double amount = 10.0 * (i + 1);
+        auto activityResult = Activity::create(
+            QString("ORD-%1").arg(i), QString("ACT-%1").arg(i), "", QDateTime(QDate(2024, 3, 1 + i), QTime(12, 0)),
+            "EUR", "FR", "FR", "FR",
+            Amount{amount, amount * rates[i % 2]}, TaxSource::MarketplaceProvided,
+            "FR", TaxScheme::DomesticVat, TaxJurisdictionLevel::Country,
+            SaleType::Products
+        );
+        QVERIFY(activityResult.ok());
+        Shipment shipment({activityResult.value.value()});
+        orderManager.recordShipmentFromSource(QString("ORD-%1").arg(i), &source, &shipment, QDate());
+    }
+
+    const QDate dateFrom(2024, 3, 1);
+    const QDate dateTo(2024, 3, 31);
+    auto entryFromMap = syncWait(factory.createEntry(
+        &source, orderManager.getShipmentAndRefunds(dateFrom, dateTo, nullptr)));
+    auto cursor = orderManager.openShipmentCursor(dateFrom, dateTo, &source);
+    auto entryFromCursor = syncWait(factory.createEntry(&source, *cursor));
+
+    QVERIFY(!entryFromMap.isNull());
+    QVERIFY(!entryFromCursor.isNull());
+    QCOMPARE(entryFromCursor->getDebitSum(), entryFromMap->getDebitSum());
+    QCOMPARE(entryFromCursor->getCreditSum(), entryFromMap->getCreditSum());
+    QCOMPARE(entryFromCursor->getCredits().size(), entryFromMap->getCredits().size());
+
+    // Nothing in the period => no entry
+    auto emptyCursor = orderManager.openShipmentCursor(QDate(2025, 1, 1), QDate(2025, 1, 31), &source);
+    QVERIFY(syncWait(factory.createEntry(&source, *emptyCursor)).isNull());
+}
+
+void TestBookEntries::test_factory_regenerate_dirty()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QDir dir(tempDir.path());
+
+    QFile companyFile(dir.filePath("company.csv"));
+    companyFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream out(&companyFile);
+    out << "Id;Parameter;Value\n";
+    out << "Currency;Currency;EUR\n";
+    out << "Country;Country Code;FR\n";
+    companyFile.close();
+
+    CompanyInfosTable companyInfos(dir);
+    CurrencyRateManager currencyManager(dir, "");
+    SaleBookAccountsTable saleAccounts(dir);
+    PurchaseBookAccountsTable purchaseAccounts(dir, "FR");
+    JournalTable journalTable(dir);
+    JournalEntryFactory factory(&currencyManager, &companyInfos, &saleAccounts, &purchaseAccounts, &journalTable);
+
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "amazon.fr", "VAT Report"};
+    OrderManager orderManager(dir);
+    const QList<double> rates{0.2, 0.055};
+    for (int i = 0; i < 10; ++i) {
+        const double amount = 10.0 * (i + 1);
+        auto activityResult = Activity::create(
+            QString("ORD-%1").arg(i), QString("ACT-%1").arg(i), "", QDateTime(QDate(2024, 3 + i % 2, 1 + i), QTime(12, 0)),
+            "EUR", "FR", "FR", "FR",
+            Amount{amount, amount * rates[i % 2]}, TaxSource::MarketplaceProvided,
+            "FR", TaxScheme::DomesticVat, TaxJurisdictionLevel::Country,
+            SaleType::Products
+        );
+        QVERIFY(activityResult.ok());
+        Shipment shipment({activityResult.value.value()});
+        orderManager.recordShipmentFromSource(QString("ORD-%1").arg(i), &source, &shipment, QDate());
+    }
+    QDate publishUntil(2024, 4, 30);
+    QVERIFY(orderManager.publish(publishUntil));
+
+    // One entry per dirty month, the same as from the shipments of the month
+    QMap<QDate, QSharedPointer<JournalEntry>> month_entry;
+    auto storeEntry = [&month_entry](const ActivitySource &, const QDate &month, QSharedPointer<JournalEntry> entry) {
+        month_entry[month] = entry;
+        return true;
+    };
+    QCOMPARE(syncWait(factory.regenerateDirtyJournalEntries(&orderManager, storeEntry)), 2);
+    QCOMPARE(month_entry.keys(), (QList<QDate>{QDate(2024, 3, 1), QDate(2024, 4, 1)}));
+    auto cursor = orderManager.openShipmentCursor(QDate(2024, 3, 1), QDate(2024, 3, 31), &source);
+    auto entryFromCursor = syncWait(factory.createEntry(&source, *cursor));
+    QVERIFY(!month_entry[QDate(2024, 3, 1)].isNull());
+    QCOMPARE(month_entry[QDate(2024, 3, 1)]->getDebitSum(), entryFromCursor->getDebitSum());
+    QCOMPARE(month_entry[QDate(2024, 3, 1)]->getCreditSum(), entryFromCursor->getCreditSum());
+    QCOMPARE(month_entry[QDate(2024, 3, 1)]->getCredits().size(), entryFromCursor->getCredits().size());
+
+    // Clean periods are not regenerated, a refused entry keeps its period dirty
+    QCOMPARE(syncWait(factory.regenerateDirtyJournalEntries(&orderManager, storeEntry)), 0);
+    auto activityResult = Activity::create(
+        "ORD-10", "ACT-10", "", QDateTime(QDate(2024, 4, 20), QTime(12, 0)),
+        "EUR", "FR", "FR", "FR",
+        Amount{30.0, 5.0}, TaxSource::MarketplaceProvided,
+        "FR", TaxScheme::DomesticVat, TaxJurisdictionLevel::Country,
+        SaleType::Products
+    );
+    QVERIFY(activityResult.ok());
+    Shipment shipment({activityResult.value.value()});
+    orderManager.recordShipmentFromSource("ORD-10", &source, &shipment, QDate());
+    QVERIFY(orderManager.publish(publishUntil));
+    auto refuseEntry = [](const ActivitySource &, const QDate &, QSharedPointer<JournalEntry>) {
+        return false;
+    };
+    QCOMPARE(syncWait(factory.regenerateDirtyJournalEntries(&orderManager, refuseEntry)), 0);
+    month_entry.clear();
+    QCOMPARE(syncWait(factory.regenerateDirtyJournalEntries(&orderManager, storeEntry)), 1);
+    QCOMPARE(month_entry.keys(), QList<QDate>{QDate(2024, 4, 1)});
+}
+
 QTEST_MAIN(TestBookEntries)
 #include "test_book_entries.moc"
-
@@ -0,0 +1,187 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include "orders/FieldDecoder.h"
+
+// Checks that FieldDecoder gives the values of the Qt functions it replaces in the report importers, and measures
+// both on the fields of a report: run with -tickcounter or -iterations to compare "qt" and "decoder" rows.
+
+class TestFieldDecoder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void test_toDouble_data();
+    void test_toDouble();
+    void test_toDate_data();
+    void test_toDate();
+    void test_dateFormatDetectedOnce();
+    void test_toSharedString();
+    void benchmark_toDouble_data();
+    void benchmark_toDouble();
+    void benchmark_toDate_data();
+    void benchmark_toDate();
+
+private:
+    QList<QByteArray> m_amounts; // As found in TOTAL_ACTIVITY_VALUE_* columns
+    QList<QByteArray> m_dates;
+};
+
+void TestFieldDecoder::initTestCase()
+{
+    for (int i = 0; i < 10000; ++i) {
+        const int cents = (i * 7919) % 100000 - (i % 10 == 0 ? 100000 : 0); // Some refunds
+        m_amounts << QByteArray::number(cents / 100.0, 'f', 2);
+        m_dates << QDate(2024, 1, 1).addDays(i % 366).toString("dd-MM-yyyy").toUtf8();
+    }
+}
+
+void TestFieldDecoder::test_toDouble_data()
+{
+    QTest::addColumn<QByteArray>("field");
+    QTest::newRow("integer") << QByteArray("42");
+    QTest::newRow("decimal") << QByteArray("19.99");
+    QTest::newRow("negative") << QByteArray("-3.33");
+    QTest::newRow("plus") << QByteArray("+3.5");
+    QTest::newRow("spaces") << QByteArray("  1.25 ");
+    QTest::newRow("exponent") << QByteArray("1.5e3");
+    QTest::newRow("leading point") << QByteArray(".5");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("comma") << QByteArray("1,5");
+    QTest::newRow("text") << QByteArray("N/A");
+    QTest::newRow("plus minus") << QByteArray("+-1");
+    QTest::newRow("trailing text") << QByteArray("12abc");
+}
+
+void TestFieldDecoder::test_toDouble()
+{
+    QFETCH(QByteArray, field);
+    bool okQt = false;
+    const double expected = QString::fromUtf8(field).toDouble(&okQt);
+    bool ok = !okQt;
+    QCOMPARE(FieldDecoder::toDouble(field, &ok), expected);
+    QCOMPARE(ok, okQt);
+}
+
+void TestFieldDecoder::test_toDate_data()
+{
+    QTest::addColumn<QByteArray>("field");
+    QTest::newRow("dash") << QByteArray("31-01-2024");
+    QTest::newRow("slash") << QByteArray("29/02/2024");
+    QTest::newRow("iso") << QByteArray("2024-12-31");
+    QTest::newRow("invalid day") << QByteArray("31-02-2024");
+    QTest::newRow("invalid month") << QByteArray("2024-13-01");
+    QTest::newRow("one digit") << QByteArray("1-2-2024");
+    QTest::newRow("time") << QByteArray("2024-12-31 10:00");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("text") << QByteArray("yesterday!");
+}
+
+void TestFieldDecoder::test_toDate()
+{
+    QFETCH(QByteArray, field);
+    const QString dateStr = QString::fromUtf8(field);
+    QDate expected = QDate::fromString(dateStr, "dd-MM-yyyy");
+    if (!expected.isValid()) expected = QDate::fromString(dateStr, "dd/MM/yyyy");
+    if (!expected.isValid()) expected = QDate::fromString(dateStr, "yyyy-MM-dd");
+
+    FieldDecoder decoder;
+    QCOMPARE(decoder.toDate(field), expected);
+    // Same once another format was detected
+    FieldDecoder decoderIso;
+    QVERIFY(decoderIso.toDate("2020-01-01").isValid());
+    QCOMPARE(decoderIso.toDate(field), expected);
+}
+
+void TestFieldDecoder::test_dateFormatDetectedOnce()
+{
+    FieldDecoder decoder;
+    QCOMPARE(decoder.dateFormat(), FieldDecoder::DateFormat::Unknown);
+    QCOMPARE(decoder.toDate(""), QDate());
+    QCOMPARE(decoder.dateFormat(), FieldDecoder::DateFormat::Unknown);
+    QCOMPARE(decoder.toDate("05/03/2024"), QDate(2024, 3, 5));
+    QCOMPARE(decoder.dateFormat(), FieldDecoder::DateFormat::DayMonthYearSlash);
+    // A row in another format is still read, the format of the file is kept
+    QCOMPARE(decoder.toDate("2024-03-06"), QDate(2024, 3, 6));
+    QCOMPARE(decoder.dateFormat(), FieldDecoder::DateFormat::DayMonthYearSlash);
+}
+
+void TestFieldDecoder::test_toSharedString()
+{
+    FieldDecoder decoder;
+    const QString first = decoder.toSharedString("DE");
+    const QString second = decoder.toSharedString("DE");
+    QCOMPARE(first, QString("DE"));
+    QCOMPARE(second.constData(), first.constData()); // Not allocated again
+    QCOMPARE(decoder.toSharedString("FR"), QString("FR"));
+    QCOMPARE(decoder.toSharedString(""), QString());
+    QCOMPARE(decoder.toSharedString("Émilie"), QString("Émilie"));
+
+    for (int i = 0; i < FieldDecoder::MAX_SHARED_STRINGS + 10; ++i) {
+        const QByteArray value = QByteArray::number(i);
+        QCOMPARE(decoder.toSharedString(value), QString::number(i));
+    }
+}
+
+void TestFieldDecoder::benchmark_toDouble_data()
+{
+    QTest::addColumn<bool>("useDecoder");
+    QTest::newRow("qt") << false;
+    QTest::newRow("decoder") << true;
+}
+
+void TestFieldDecoder::benchmark_toDouble()
+{
+    QFETCH(bool, useDecoder);
+    double sum = 0.;
+    if (useDecoder) {
+        QBENCHMARK {
+            for (const auto &amount : std::as_const(m_amounts)) {
+                sum += FieldDecoder::toDouble(amount);
+            }
+        }
+    } else {
+        QBENCHMARK {
+            for (const auto &amount : std::as_const(m_amounts)) {
+                sum += QString::fromUtf8(amount).toDouble();
+            }
+        }
+    }
+    QVERIFY(sum != 0.);
+}
+
+void TestFieldDecoder::benchmark_toDate_data()
+{
+    QTest::addColumn<bool>("useDecoder");
+    QTest::newRow("qt") << false;
+    QTest::newRow("decoder") << true;
+}
+
+void TestFieldDecoder::benchmark_toDate()
+{
+    QFETCH(bool, useDecoder);
+    qint64 days = 0;
+    if (useDecoder) {
+        FieldDecoder decoder;
+        QBENCHMARK {
+            for (const auto &date : std::as_const(m_dates)) {
+                days += decoder.toDate(date).toJulianDay();
+            }
+        }
+    } else {
+        QBENCHMARK {
+            for (const auto &date : std::as_const(m_dates)) {
+                // Same formats tried, in the same order, as the importers did
+                const QString dateStr = QString::fromUtf8(date);
+                QDate parsed = QDate::fromString(dateStr, "dd-MM-yyyy");
+                if (!parsed.isValid()) parsed = QDate::fromString(dateStr, "dd/MM/yyyy");
+                if (!parsed.isValid()) parsed = QDate::fromString(dateStr, "yyyy-MM-dd");
+                days += parsed.toJulianDay();
+            }
+        }
+    }
+    QVERIFY(days > 0);
+}
+
+QTEST_MAIN(TestFieldDecoder)
+#include "test_field_decoder.moc"
@@ -3,8 +3,14 @@
 #include <QDir>
 #include <QDebug>
 #include <QCoroTask>
+#include <QSettings>
 
+#include "orders/ClosedKeySet.h"
+#include "orders/ContentHash.h"
+#include "orders/CsvStreamReader.h"
+#include "orders/ImportedRowIndex.h"
 #include "orders/ImporterFileAmazonVatEu.h"
+#include "orders/OrderManager.h"
 #include "utils/CsvReader.h"
 
 // We need a main for QCoro tests if we use QCoroTest, or just use QTEST_MAIN and block on tasks.
@@ -22,6 +28,14 @@ private slots:
     void initTestCase();
     void cleanupTestCase();
     void test_allFiles();
+    void test_csvStreamReader();
+    void test_contentHash();
+    void test_closedKeySet();
+    void test_loadReportStreamed();
+    void test_loadReportParallel();
+    void test_importedRowIndex();
+    void test_reimportReadsNewRowsOnly();
+    void test_reportIdentityFromContent();
 
 private:
     QString m_reportsPath;
@@ -180,5 +194,460 @@ void TestFileImportAmz::test_allFiles()
     }
 }
 
+void TestFileImportAmz::test_csvStreamReader()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString filePath = tempDir.filePath("quoted.csv");
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("\xEF\xBB\xBF" "A,B,C\r\n"
+               "1,\"two, with comma\",3\r\n"
+               "\r\n"
+               "\"multi\nline\",\"say \"\"hi\"\"\",\r\n"
+               "last,,end");
+    file.close();
+
+    CsvStreamReader reader(filePath);
+    QVERIFY(reader.open());
+    QVERIFY(reader.readRecord());
+    QCOMPARE(reader.fields().size(), 3);
+    QCOMPARE(reader.fieldString(0), QString("A")); // BOM skipped
+    QCOMPARE(reader.fieldString(2), QString("C")); // CR dropped
+    QVERIFY(reader.readRecord());
+    QCOMPARE(reader.fieldString(1), QString("two, with comma"));
+    const qint64 thirdRecordOffset = reader.pos();
+    QVERIFY(reader.readRecord()); // Blank line skipped
+    QCOMPARE(reader.fields().size(), 3);
+    QCOMPARE(reader.fieldString(0), QString("multi\nline"));
+    QCOMPARE(reader.fieldString(1), QString("say \"hi\""));
+    QCOMPARE(reader.fieldString(2), QString());
+    QVERIFY(reader.readRecord()); // No newline at the end of the file
+    QCOMPARE(reader.fieldString(0), QString("last"));
+    QCOMPARE(reader.fieldString(2), QString("end"));
+    QCOMPARE(reader.fieldString(5), QString());
+    QVERIFY(!reader.readRecord());
+    QVERIFY(reader.errorString().isEmpty());
+
+    // Byte range ending inside the third record still reads it whole
+    CsvStreamReader rangeReader(filePath);
+    QVERIFY(rangeReader.open(thirdRecordOffset, thirdRecordOffset + 4));
+    QVERIFY(rangeReader.readRecord());
+    QCOMPARE(rangeReader.fieldString(0), QString("multi\nline"));
+    QVERIFY(!rangeReader.readRecord());
+
+    // Chunks never start inside a quoted field, whatever their size
+    CsvStreamReader headerReader(filePath);
+    QVERIFY(headerReader.open());
+    QVERIFY(headerReader.readRecord());
+    for (int nChunks : {1, 2, 3, 8}) {
+        const QList<qint64> boundaries = CsvStreamReader::splitRecords(filePath, headerReader.pos(), nChunks);
+        QVERIFY(boundaries.size() >= 2);
+        QVERIFY(boundaries.size() <= nChunks + 1);
+        QStringList firstFields;
+        for (qsizetype i = 1; i < boundaries.size(); ++i) {
+            CsvStreamReader chunkReader(filePath);
+            QVERIFY(chunkReader.open(boundaries[i - 1], boundaries[i]));
+            while (chunkReader.readRecord()) {
+                firstFields << chunkReader.fieldString(0);
+            }
+        }
+        QCOMPARE(firstFields, QStringList({"1", "multi\nline", "last"}));
+    }
+}
+
+void TestFileImportAmz::test_contentHash()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QByteArray content = "A,B,C\n";
+    for (int i = 0; content.size() < 3 * ContentHash::BLOCK_SIZE + 12345; ++i) {
+        content += QByteArray::number(i) + ",\"text, with\nnewline\"," + QByteArray::number(i * 7) + "\n";
+    }
+    auto writeFile = [&tempDir](const QString &fileName, const QByteArray &data) {
+        QFile file(tempDir.filePath(fileName));
+        if (!file.open(QIODevice::WriteOnly)) {
+            return QString();
+        }
+        file.write(data);
+        return file.fileName();
+    };
+    const QString filePath = writeFile("report.csv", content);
+    const ContentHash contentHash = ContentHash::hashFile(filePath);
+    const QByteArray expected = contentHash.result();
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(contentHash.headHash(),
+             QCryptographicHash::hash(content.left(ContentHash::BLOCK_SIZE), ContentHash::ALGORITHM));
+
+    // Hashed by the reader as it reads the records
+    CsvStreamReader reader(filePath);
+    reader.enableContentHash();
+    QVERIFY(reader.open());
+    QCOMPARE(reader.contentHash().headHash(), contentHash.headHash()); // From the first buffer
+    QVERIFY(reader.contentHash().result().isEmpty());
+    while (reader.readRecord()) {
+    }
+    QCOMPARE(reader.contentHash().result(), expected);
+
+    // Or by the readers of byte ranges, appended to the header buffer in order
+    CsvStreamReader headerReader(filePath);
+    headerReader.enableContentHash();
+    QVERIFY(headerReader.open());
+    QVERIFY(headerReader.readRecord());
+    for (int nChunks : {1, 2, 3, 7}) {
+        const QList<qint64> boundaries = CsvStreamReader::splitRecords(filePath, headerReader.pos(), nChunks);
+        QVERIFY(boundaries.size() >= 2);
+        ContentHash rangesHash = headerReader.contentHash();
+        for (qsizetype i = 1; i < boundaries.size(); ++i) {
+            CsvStreamReader chunkReader(filePath);
+            chunkReader.enableContentHash();
+            QVERIFY(chunkReader.open(boundaries[i - 1], boundaries[i]));
+            while (chunkReader.readRecord()) {
+            }
+            QVERIFY(rangesHash.append(chunkReader.contentHash()));
+        }
+        QCOMPARE(rangesHash.result(), expected);
+    }
+
+    // A change after the head only changes the whole hash
+    QByteArray changed = content;
+    changed[changed.size() - 2] = 'X';
+    const ContentHash changedHash = ContentHash::hashFile(writeFile("changed.csv", changed));
+    QCOMPARE(changedHash.headHash(), contentHash.headHash());
+    QVERIFY(changedHash.result() != expected);
+    const ContentHash smallHash = ContentHash::hashFile(writeFile("small.csv", content.left(100)));
+    QCOMPARE(smallHash.headHash(), QCryptographicHash::hash(content.left(100), ContentHash::ALGORITHM));
+}
+
+void TestFileImportAmz::test_closedKeySet()
+{
+    ClosedKeySet closedKeys;
+    QVERIFY(!closedKeys.contains("event_SALE"));
+    QStringList keys;
+    for (int i = 0; i < 200000; ++i) {
+        keys << QString("event%1_SALE").arg(i);
+    }
+    QVERIFY(closedKeys.add(keys));
+    for (const auto &key : std::as_const(keys)) {
+        QVERIFY(closedKeys.contains(key));
+    }
+    // Exact whatever the filter matches
+    for (int i = 0; i < 200000; ++i) {
+        QVERIFY(!closedKeys.contains(QString("event%1_REFUND").arg(i)));
+    }
+}
+
+void TestFileImportAmz::test_loadReportStreamed()
+{
+    QDir reportDir(m_reportsPath);
+    QFileInfoList files = reportDir.entryInfoList({"*.csv"}, QDir::Files);
+    if (files.isEmpty()) {
+        QSKIP("No CSV files found in reports directory.");
+    }
+
+    auto shipmentsCbor = [](const AbstractImporter::OrderInfos &orderInfos) {
+        QList<QByteArray> cbors;
+        for (const auto &shipment : orderInfos.shipments) {
+            cbors << "S" + shipment.toCbor();
+        }
+        for (const auto &refund : orderInfos.refunds) {
+            cbors << "R" + refund.toCbor();
+        }
+        std::sort(cbors.begin(), cbors.end());
+        return cbors;
+    };
+
+    for (const QFileInfo &fileInfo : std::as_const(files)) {
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QVERIFY(QDir(tempDir.path()).mkdir("whole"));
+        QVERIFY(QDir(tempDir.path()).mkdir("streamed"));
+        ImporterFileAmazonVatEu importer(tempDir.filePath("whole"));
+        ImporterFileAmazonVatEu importerStreamed(tempDir.filePath("streamed"));
+
+        auto result = QCoro::waitFor(importer.loadReport(fileInfo.absoluteFilePath()));
+        QVERIFY2(result.errorReturned.isEmpty(), qPrintable(result.errorReturned));
+
+        // The batches hold the same shipments, grouped the same way
+        AbstractImporter::OrderInfos merged;
+        int nBatches = 0;
+        auto resultStreamed = QCoro::waitFor(importerStreamed.loadReportStreamed(
+            fileInfo.absoluteFilePath(), [&merged, &nBatches](AbstractImporter::OrderInfos &&orderInfos) {
+                ++nBatches;
+                merged.shipments << orderInfos.shipments;
+                merged.refunds << orderInfos.refunds;
+                merged.orderId_store.insert(orderInfos.orderId_store);
+            }));
+        QVERIFY2(resultStreamed.errorReturned.isEmpty(), qPrintable(resultStreamed.errorReturned));
+        QVERIFY(nBatches > 0);
+        QCOMPARE(shipmentsCbor(merged), shipmentsCbor(*result.orderInfos));
+        QCOMPARE(merged.orderId_store, result.orderInfos->orderId_store);
+        QCOMPARE(resultStreamed.orderInfos->dateMin, result.orderInfos->dateMin);
+        QCOMPARE(resultStreamed.orderInfos->dateMax, result.orderInfos->dateMax);
+        QVERIFY(resultStreamed.orderInfos->shipments.isEmpty());
+
+        // Recorded as imported like a whole import
+        auto again = QCoro::waitFor(importerStreamed.loadReportStreamed(
+            fileInfo.absoluteFilePath(), [](AbstractImporter::OrderInfos &&) {}));
+        QVERIFY(!again.errorReturned.isEmpty());
+    }
+}
+
+void TestFileImportAmz::test_loadReportParallel()
+{
+    QDir reportDir(m_reportsPath);
+    QFileInfoList files = reportDir.entryInfoList({"*.csv"}, QDir::Files);
+    if (files.isEmpty()) {
+        QSKIP("No CSV files found in reports directory.");
+    }
+
+    for (const QFileInfo &fileInfo : std::as_const(files)) {
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QVERIFY(QDir(tempDir.path()).mkdir("sequential"));
+        QVERIFY(QDir(tempDir.path()).mkdir("parallel"));
+        ImporterFileAmazonVatEu importer(tempDir.filePath("sequential"));
+        importer.setParsingThreadCount(1);
+        ImporterFileAmazonVatEu importerParallel(tempDir.filePath("parallel"));
+        importerParallel.setParsingThreadCount(7); // Chunk boundaries unrelated to the event groups
+
+        auto result = QCoro::waitFor(importer.loadReport(fileInfo.absoluteFilePath()));
+        QVERIFY2(result.errorReturned.isEmpty(), qPrintable(result.errorReturned));
+        auto resultParallel = QCoro::waitFor(importerParallel.loadReport(fileInfo.absoluteFilePath()));
+        QVERIFY2(resultParallel.errorReturned.isEmpty(), qPrintable(resultParallel.errorReturned));
+
+        // Same shipments in the same order
+        const auto &orderInfos = *result.orderInfos;
+        const auto &orderInfosParallel = *resultParallel.orderInfos;
+        QCOMPARE(orderInfosParallel.shipments.size(), orderInfos.shipments.size());
+        for (qsizetype i = 0; i < orderInfos.shipments.size(); ++i) {
+            QCOMPARE(orderInfosParallel.shipments[i].toCbor(), orderInfos.shipments[i].toCbor());
+        }
+        QCOMPARE(orderInfosParallel.refunds.size(), orderInfos.refunds.size());
+        for (qsizetype i = 0; i < orderInfos.refunds.size(); ++i) {
+            QCOMPARE(orderInfosParallel.refunds[i].toCbor(), orderInfos.refunds[i].toCbor());
+        }
+        QCOMPARE(orderInfosParallel.invoicingInfos.size(), orderInfos.invoicingInfos.size());
+        for (qsizetype i = 0; i < orderInfos.invoicingInfos.size(); ++i) {
+            QCOMPARE(orderInfosParallel.invoicingInfos[i].shipmentOrRefundId, orderInfos.invoicingInfos[i].shipmentOrRefundId);
+        }
+        QCOMPARE(orderInfosParallel.orderId_store, orderInfos.orderId_store);
+        QCOMPARE(orderInfosParallel.dateMin, orderInfos.dateMin);
+        QCOMPARE(orderInfosParallel.dateMax, orderInfos.dateMax);
+    }
+}
+
+void TestFileImportAmz::test_importedRowIndex()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QList<qint64> fingerprints;
+    for (qint64 i = 0; i < 1234; ++i) {
+        fingerprints << i * 7919 - 5000;
+    }
+
+    // Staged rows are only recorded once committed, for their source
+    ImportedRowIndex index(QDir(tempDir.path()), "source");
+    QVERIFY(index.imported(fingerprints).isEmpty());
+    QVERIFY(index.addPending(fingerprints.mid(0, 100)));
+    QVERIFY(index.imported(fingerprints).isEmpty());
+    index.clearPending();
+    QVERIFY(index.commitPending());
+    QVERIFY(index.imported(fingerprints).isEmpty());
+    QVERIFY(index.addPending(fingerprints.mid(0, 700)));
+    QVERIFY(index.commitPending());
+
+    // Looked up by batches, from another connection
+    ImportedRowIndex otherIndex(QDir(tempDir.path()), "source");
+    const QSet<qint64> imported = otherIndex.imported(fingerprints);
+    QCOMPARE(imported, QSet<qint64>(fingerprints.cbegin(), fingerprints.cbegin() + 700));
+    ImportedRowIndex otherSource(QDir(tempDir.path()), "other");
+    QVERIFY(otherSource.imported(fingerprints).isEmpty());
+
+    // Cleared for the source only
+    QVERIFY(otherSource.addPending(fingerprints));
+    QVERIFY(otherSource.commitPending());
+    QVERIFY(index.clear());
+    QVERIFY(otherIndex.imported(fingerprints).isEmpty());
+    QCOMPARE(otherSource.imported(fingerprints).size(), fingerprints.size());
+}
+
+void TestFileImportAmz::test_reimportReadsNewRowsOnly()
+{
+    QDir reportDir(m_reportsPath);
+    QFileInfoList files = reportDir.entryInfoList({"*.csv"}, QDir::Files);
+    if (files.isEmpty()) {
+        QSKIP("No CSV files found in reports directory.");
+    }
+
+    // Shipments and refunds by event id and transaction type
+    auto cborByKey = [](const AbstractImporter::OrderInfos &orderInfos) {
+        QMap<QString, QByteArray> cbors;
+        qsizetype iShipment = 0;
+        qsizetype iRefund = 0;
+        for (const auto &invoicingInfo : orderInfos.invoicingInfos) {
+            const QString &key = invoicingInfo.shipmentOrRefundId;
+            cbors[key] = key.endsWith("_SALE") ? orderInfos.shipments[iShipment++].toCbor()
+                                               : orderInfos.refunds[iRefund++].toCbor();
+        }
+        return cbors;
+    };
+
+    for (const QFileInfo &fileInfo : std::as_const(files)) {
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        QDir dir(tempDir.path());
+        for (const auto &subDir : {"importer", "whole", "secondHalf", "orders"}) {
+            QVERIFY(dir.mkdir(subDir));
+        }
+
+        // A first report with the first half of the rows, the second one with all of them
+        CsvStreamReader headerReader(fileInfo.absoluteFilePath());
+        QVERIFY(headerReader.open());
+        QVERIFY(headerReader.readRecord());
+        const QList<qint64> boundaries = CsvStreamReader::splitRecords(
+                    fileInfo.absoluteFilePath(), headerReader.pos(), 2);
+        QVERIFY(boundaries.size() >= 2);
+        QFile file(fileInfo.absoluteFilePath());
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray content = file.readAll();
+        const QByteArray header = content.left(headerReader.pos());
+        const QByteArray firstHalf = content.mid(headerReader.pos(), boundaries[1] - headerReader.pos());
+        const QByteArray secondHalf = content.mid(boundaries[1]);
+        auto writeReport = [&dir](const QString &fileName, const QByteArray &data) {
+            QFile report(dir.filePath(fileName));
+            if (!report.open(QIODevice::WriteOnly)) {
+                return QString();
+            }
+            report.write(data);
+            return report.fileName();
+        };
+        const QString filePathFirstHalf = writeReport("first-half.csv", header + firstHalf);
+        const QString filePathWhole = writeReport("whole.csv", content);
+        const QString filePathRewritten = writeReport("whole-rewritten.csv", content + "\n"); // Same rows
+        const QString filePathSecondHalf = writeReport("second-half.csv", header + secondHalf);
+
+        ImporterFileAmazonVatEu importer(dir.filePath("importer"));
+        auto resultFirstHalf = QCoro::waitFor(importer.loadReport(filePathFirstHalf));
+        QVERIFY2(resultFirstHalf.errorReturned.isEmpty(), qPrintable(resultFirstHalf.errorReturned));
+        QVERIFY(importer.commitImportedRows());
+        auto result = QCoro::waitFor(importer.loadReport(filePathWhole));
+        QVERIFY2(result.errorReturned.isEmpty(), qPrintable(result.errorReturned));
+        QVERIFY(importer.commitImportedRows());
+
+        // Events with rows in the second half, each with all its rows as in a whole import
+        ImporterFileAmazonVatEu importerWhole(dir.filePath("whole"));
+        auto resultWhole = QCoro::waitFor(importerWhole.loadReport(filePathWhole));
+        QVERIFY2(resultWhole.errorReturned.isEmpty(), qPrintable(resultWhole.errorReturned));
+        ImporterFileAmazonVatEu importerSecondHalf(dir.filePath("secondHalf"));
+        auto resultSecondHalf = QCoro::waitFor(importerSecondHalf.loadReport(filePathSecondHalf));
+        QVERIFY2(resultSecondHalf.errorReturned.isEmpty(), qPrintable(resultSecondHalf.errorReturned));
+        const auto cborsWhole = cborByKey(*resultWhole.orderInfos);
+        QMap<QString, QByteArray> expected;
+        for (const auto &key : cborByKey(*resultSecondHalf.orderInfos).keys()) {
+            expected[key] = cborsWhole.value(key);
+        }
+        QCOMPARE(cborByKey(*result.orderInfos), expected);
+
+        // Rows not committed, as if their orders failed to be recorded, are read again
+        auto resultNotCommitted = QCoro::waitFor(importerWhole.loadReport(filePathRewritten));
+        QVERIFY2(resultNotCommitted.errorReturned.isEmpty(), qPrintable(resultNotCommitted.errorReturned));
+        QCOMPARE(cborByKey(*resultNotCommitted.orderInfos), cborsWhole);
+
+        // Nothing new in a report with the same rows, read or streamed
+        auto resultRewritten = QCoro::waitFor(importer.loadReport(filePathRewritten));
+        QVERIFY2(resultRewritten.errorReturned.isEmpty(), qPrintable(resultRewritten.errorReturned));
+        QVERIFY(resultRewritten.orderInfos->shipments.isEmpty());
+        QVERIFY(resultRewritten.orderInfos->refunds.isEmpty());
+        const QString filePathStreamed = writeReport("whole-streamed.csv", content + "\n\n");
+        int nShipments = 0;
+        auto resultStreamed = QCoro::waitFor(importer.loadReportStreamed(
+            filePathStreamed, [&nShipments](AbstractImporter::OrderInfos &&orderInfos) {
+                nShipments += orderInfos.shipments.size() + orderInfos.refunds.size();
+            }));
+        QVERIFY2(resultStreamed.errorReturned.isEmpty(), qPrintable(resultStreamed.errorReturned));
+        QCOMPARE(nShipments, 0);
+
+        // Forgotten with the orders recorded from them
+        OrderManager orderManager(QDir(dir.filePath("orders")));
+        orderManager.addClearedCallback([&importer]() {
+            QVERIFY(importer.clearImportedRows());
+        });
+        orderManager.deleteDatabase();
+        auto resultAfterReset = QCoro::waitFor(importer.loadReport(writeReport("whole-reset.csv", content + "\n\n\n")));
+        QVERIFY2(resultAfterReset.errorReturned.isEmpty(), qPrintable(resultAfterReset.errorReturned));
+        QCOMPARE(cborByKey(*resultAfterReset.orderInfos), cborsWhole);
+    }
+}
+
+void TestFileImportAmz::test_reportIdentityFromContent()
+{
+    QDir reportDir(m_reportsPath);
+    QFileInfoList files = reportDir.entryInfoList({"*.csv"}, QDir::Files);
+    if (files.isEmpty()) {
+        QSKIP("No CSV files found in reports directory.");
+    }
+    const QFileInfo fileInfo = files.first();
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QDir dir(tempDir.path());
+
+    // Working directory of an older version: the report was recorded by file name, and copied
+    QVERIFY(dir.mkpath("importer/reports/Amazon_EU_VAT_Report/2024"));
+    QVERIFY(QFile::copy(fileInfo.absoluteFilePath(),
+                        dir.filePath("importer/reports/Amazon_EU_VAT_Report/2024/" + fileInfo.fileName())));
+    {
+        QSettings settings(dir.filePath("importer/importer.ini"), QSettings::IniFormat);
+        settings.setValue("Reports/ImportedIds", QStringList{fileInfo.fileName(), "lost.csv"});
+    }
+
+    // Same content under another name, sequential or parallel, whole or streamed
+    QVERIFY(QFile::copy(fileInfo.absoluteFilePath(), dir.filePath("renamed.csv")));
+    ImporterFileAmazonVatEu importer(dir.filePath("importer"));
+    auto result = QCoro::waitFor(importer.loadReport(dir.filePath("renamed.csv")));
+    QVERIFY(result.errorReturned.contains(fileInfo.fileName()));
+    QVERIFY(!QSettings(dir.filePath("importer/importer.ini"), QSettings::IniFormat).contains("Reports/ImportedIds"));
+    importer.setParsingThreadCount(3);
+    result = QCoro::waitFor(importer.loadReport(dir.filePath("renamed.csv")));
+    QVERIFY(result.errorReturned.contains(fileInfo.fileName()));
+    // Rejected before any batch is passed downstream
+    int nBatches = 0;
+    result = QCoro::waitFor(importer.loadReportStreamed(
+        dir.filePath("renamed.csv"), [&nBatches](AbstractImporter::OrderInfos &&) {
+            ++nBatches;
+        }));
+    QVERIFY(result.errorReturned.contains(fileInfo.fileName()));
+    QCOMPARE(nBatches, 0);
+
+    // A report with another content is imported once, whatever its name
+    QVERIFY(dir.mkdir("other"));
+    ImporterFileAmazonVatEu importerOther(dir.filePath("other"));
+    result = QCoro::waitFor(importerOther.loadReport(dir.filePath("renamed.csv")));
+    QVERIFY2(result.errorReturned.isEmpty(), qPrintable(result.errorReturned));
+    QVERIFY(QFile::rename(dir.filePath("renamed.csv"), dir.filePath("renamed-again.csv")));
+    result = QCoro::waitFor(importerOther.loadReport(dir.filePath("renamed-again.csv")));
+    QVERIFY(result.errorReturned.contains("renamed.csv"));
+
+    // Another content under a name imported before: both copies are kept
+    QFile report(dir.filePath("renamed-again.csv"));
+    QVERIFY(report.open(QIODevice::ReadOnly));
+    const QByteArray content = report.readAll();
+    report.close();
+    QFile changedReport(dir.filePath("renamed.csv"));
+    QVERIFY(changedReport.open(QIODevice::WriteOnly));
+    changedReport.write(content + "\n");
+    changedReport.close();
+    result = QCoro::waitFor(importerOther.loadReport(dir.filePath("renamed.csv")));
+    QVERIFY2(result.errorReturned.isEmpty(), qPrintable(result.errorReturned));
+    QStringList copies;
+    QDirIterator it(dir.filePath("other/reports"), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        copies << QFileInfo(it.next()).fileName();
+    }
+    copies.sort();
+    QCOMPARE(copies, QStringList({"renamed (2).csv", "renamed.csv"}));
+}
+
 QTEST_MAIN(TestFileImportAmz)
 #include "test_file_import_amazon.moc"
@@ -1,8 +1,14 @@
 #include <QtTest>
 #include <QCoreApplication>
 #include <QTemporaryDir>
+#include <QTimeZone>
+#include <QThread>
 #include <QSqlQuery>
+#include <QSqlDatabase>
+#include <QJsonDocument>
+#include <QCryptographicHash>
 #include "orders/OrderManager.h"
+#include "orders/OrderManager_sql_schema.h"
 #include "orders/Shipment.h"
 #include "orders/Refund.h"
 #include "books/Activity.h"
@@ -11,6 +17,54 @@
 #include "orders/ActivityUpdate.h"
 #include "orders/Address.h"
 #include "orders/InvoicingInfo.h"
+#include "orders/ShipmentCursor.h"
+#include "orders/ShipmentQuery.h"
+#include "orders/OrderManagerAsync.h"
+#include "orders/OrderTimeline.h"
+#include "orders/KeysetPager.h"
+#include "orders/OrdersBrowserModel.h"
+#include <QCoroTask>
+
+namespace {
+    // Activity sold from FR to countryTo, where its VAT is paid and declared
+    Activity makeActivity(const QString &orderId,
+                          const QString &activityId,
+                          const QString &subActivityId,
+                          const QDateTime &dateTime,
+                          const Amount &amount,
+                          const QString &countryTo = "DE",
+                          TaxScheme taxScheme = TaxScheme::EuOssUnion)
+    {
+        auto actRes = Activity::create(orderId, activityId, subActivityId, dateTime, "EUR", "FR", countryTo, countryTo,
+             amount, TaxSource::MarketplaceProvided, countryTo, taxScheme, TaxJurisdictionLevel::Country, SaleType::Products);
+        if (!actRes.ok()) {
+            qFatal("Invalid test activity %s: %s", qPrintable(activityId), qPrintable(actRes.errors.value(0).message));
+        }
+        return *actRes.value;
+    }
+
+    // Shipment of one activity at 10:00
+    Shipment makeShipment(const QString &orderId,
+                          const QString &activityId,
+                          const QDate &date,
+                          const Amount &amount,
+                          const QString &countryTo = "DE",
+                          TaxScheme taxScheme = TaxScheme::EuOssUnion)
+    {
+        return Shipment({makeActivity(orderId, activityId, "", QDateTime(date, QTime(10, 0)), amount, countryTo, taxScheme)});
+    }
+
+    // Same with 20% of the amount as taxes
+    Shipment makeShipment(const QString &orderId,
+                          const QString &activityId,
+                          const QDate &date,
+                          double amount,
+                          const QString &countryTo = "DE",
+                          TaxScheme taxScheme = TaxScheme::EuOssUnion)
+    {
+        return makeShipment(orderId, activityId, date, Amount(amount, amount * 0.2), countryTo, taxScheme);
+    }
+}
 
 class TestOrderManager : public QObject
 {
@@ -30,6 +84,28 @@ private slots:
     void test_invoicingInfos();
     void test_getShipmentOrRefundIfDifferent();
     void test_store_recording_and_querying();
+    void test_recordOrderInfos();
+    void test_activitiesTable();
+    void test_shipmentCursor();
+    void test_shipmentQuery();
+    void test_reversalStoredNegated();
+    void test_migrationReversalNegated();
+    void test_shipmentHeads();
+    void test_contentHashes();
+    void test_cborEncoding();
+    void test_publishBatched();
+    void test_threadConnections();
+    void test_async();
+    void test_archiveYears();
+    void test_clearUnpublished();
+    void test_compactAndDelete();
+    void test_periodAggregates();
+    void test_changeLog();
+    void test_dirtyPeriods();
+    void test_orderTimeline();
+    void test_keysetPager();
+    void test_ordersBrowserModel();
+    void test_shipmentPagerWithoutSource();
 };
 
 void TestOrderManager::initTestCase()
@@ -48,6 +124,19 @@ void TestOrderManager::test_init()
     // Check if DB exists
     QFile dbFile(tempDir.filePath("Orders.db"));
     QVERIFY(dbFile.exists());
+
+    // Created at the last version, without going through the migrations
+    QSqlQuery q(manager.m_db);
+    QVERIFY(q.exec("PRAGMA user_version"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), OrderManagerSql::SCHEMA_VERSION);
+    QVERIFY(q.exec("SELECT name FROM pragma_table_info('shipments')"));
+    QStringList columns;
+    while (q.next()) {
+        columns << q.value(0).toString();
+    }
+    QVERIFY(columns.contains("current_data"));
+    QVERIFY(!columns.contains("current_json"));
 }
 
 void TestOrderManager::test_recordShipmentDraft()
@@ -123,10 +212,10 @@ void TestOrderManager::test_record_publish_update()
         QCOMPARE(q.value(0).toInt(), 1); 
         
         // Verify Content updated
-        q.exec("SELECT current_json FROM shipments");
+        q.exec("SELECT current_data FROM shipments");
         QVERIFY(q.next());
         // Simple check that it's updated (e.g. time)
-        QVERIFY(q.value(0).toString().contains("12:00:00"));
+        QCOMPARE(Shipment::fromCbor(q.value(0).toByteArray()).getActivities().first().getDateTime().time(), QTime(12, 0));
     }
     
     // Check we have 1 shipment (Draft)
@@ -680,5 +769,1326 @@ void TestOrderManager::test_store_recording_and_querying()
     QCOMPARE(results[sourceA]["Store2"].size(), 1);
 }
 
+void TestOrderManager::test_recordOrderInfos()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    auto makeInfos = [](double amount) {
+        AbstractImporter::OrderInfos infos;
+        for (int i = 0; i < 3; ++i) {
+            infos.shipments.append(makeShipment(QString("ord%1").arg(i), QString("act%1").arg(i), QDate(2023, 1, 1 + i), amount));
+            infos.orderId_store.insert(QString("ord%1").arg(i), "amazon.de");
+        }
+        infos.refunds.append(Refund({makeActivity("ord0", "act0_ref", "", QDateTime(QDate(2023, 1, 10), QTime(10, 0)), Amount(-amount, -amount * 0.2))}));
+        infos.orderAddresses.append({"ord0", Address("John Doe", "Street", "", "", "City", "12345", "DE", "", "", "", "", "")});
+        infos.invoicingInfos.append({"act0", InvoicingInfo(&infos.shipments.first(), {}, "INV-001")});
+        return infos;
+    };
+
+    // 1. New rows are recorded as drafts, with stores, addresses and invoicing infos
+    QVERIFY(manager.recordOrderInfos(makeInfos(100.0), source));
+    {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT COUNT(*) FROM shipments WHERE status = 'Draft'");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 4);
+        q.exec("SELECT COUNT(*) FROM orders WHERE store = 'amazon.de'");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 3);
+        q.exec("SELECT COUNT(*) FROM orders WHERE address_json IS NOT NULL");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 1);
+    }
+    auto info = manager.getInvoicingInfo("act0");
+    QVERIFY(info);
+    QCOMPARE(info->getInvoiceNumber().value(), QString("INV-001"));
+    QCOMPARE(manager.getLastDateTime(&source), QDateTime(QDate(2023, 1, 10), QTime(10, 0)));
+
+    // 2. Same report again after publish => no change
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+    QVERIFY(manager.recordOrderInfos(makeInfos(100.0), source));
+    {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT COUNT(*) FROM shipments");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 4);
+    }
+
+    // 3. Conflicting amounts => reversal + new version for each of the 4 published rows
+    QVERIFY(manager.recordOrderInfos(makeInfos(200.0), source, QDate(2023, 2, 15)));
+    {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT COUNT(*) FROM shipments WHERE status = 'Draft' AND root_id IS NOT NULL");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 8);
+    }
+    auto results = manager.getShipmentAndRefunds(QDate(2023, 1, 1), QDate(2023, 3, 1), nullptr);
+    double sum = 0;
+    for (auto it = results.begin(); it != results.end(); ++it) {
+        for (const auto &act : it.value()->getActivities()) {
+            sum += act.getAmountTaxed();
+        }
+    }
+    // 3 shipments of 200 minus a refund of 200
+    QCOMPARE(sum, 400.0);
+}
+
+void TestOrderManager::test_activitiesTable()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    // 1. Activities are written with the shipment
+    Shipment ship100 = makeShipment("ordA", "actA", QDate(2023, 1, 5), 100.0);
+    manager.recordOrder("ordA", "amazon.de");
+    manager.recordShipmentFromSource("ordA", &source, &ship100, QDate());
+    {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT COUNT(*), SUM(amount_taxed), SUM(amount_taxes) FROM activities WHERE shipment_id = 'actA'");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 1);
+        QCOMPARE(q.value(1).toDouble(), 100.0);
+        QCOMPARE(q.value(2).toDouble(), 20.0);
+    }
+    auto totals = manager.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 3, 1));
+    QCOMPARE(totals.size(), 1);
+    QCOMPARE(totals.first().store, QString("amazon.de"));
+    QCOMPARE(totals.first().taxScheme, TaxScheme::EuOssUnion);
+    QCOMPARE(totals.first().amountTaxed, 100.0);
+    QCOMPARE(totals.first().count, 1);
+
+    // 2. Publish reads the amounts from the activities table
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+    {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT amount FROM financial_events WHERE shipment_id = 'actA'");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toDouble(), 120.0);
+    }
+
+    // 3. Conflict => the reversal is stored negated, so totals give the new version only
+    Shipment ship150 = makeShipment("ordA", "actA", QDate(2023, 1, 5), 150.0);
+    manager.recordShipmentFromSource("ordA", &source, &ship150, QDate(2023, 2, 15));
+    totals = manager.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 3, 1));
+    QCOMPARE(totals.size(), 1);
+    QCOMPARE(totals.first().amountTaxed, 150.0);
+    QCOMPARE(totals.first().amountTaxes, 30.0);
+    QCOMPARE(totals.first().count, 3);
+
+    // 4. Credit notes keep positive amounts
+    publishUntil = QDate(2023, 3, 1);
+    manager.publish(publishUntil);
+    {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT amount FROM financial_events WHERE type = 'CreditNote'");
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toDouble(), 120.0);
+    }
+}
+
+void TestOrderManager::test_shipmentCursor()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource sourceEu{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    ActivitySource sourceTemu{ActivitySourceType::API, "Temu", "Temu EU", "Orders"};
+
+    Shipment ship3 = makeShipment("c", "c", QDate(2023, 1, 3), 30.0);
+    Shipment ship1 = makeShipment("a", "a", QDate(2023, 1, 1), 10.0);
+    Shipment ship2 = makeShipment("b", "b", QDate(2023, 1, 2), 20.0);
+    manager.recordOrder("c", "amazon.de");
+    manager.recordShipmentFromSource("c", &sourceEu, &ship3, QDate());
+    manager.recordShipmentFromSource("a", &sourceEu, &ship1, QDate());
+    manager.recordShipmentFromSource("b", &sourceTemu, &ship2, QDate());
+
+    // 1. All sources, in event date order, with the store of the order
+    auto cursor = manager.openShipmentCursor(QDate(2023, 1, 1), QDate(2023, 12, 31));
+    QStringList ids;
+    while (cursor->next()) {
+        ids << cursor->getId();
+        if (cursor->getId() == "c") {
+            QCOMPARE(cursor->getStore(), QString("amazon.de"));
+            QCOMPARE(cursor->getActivitySource(), sourceEu);
+        } else if (cursor->getId() == "b") {
+            QCOMPARE(cursor->getActivitySource(), sourceTemu);
+        }
+    }
+    QCOMPARE(ids, QStringList({"a", "b", "c"}));
+
+    // 2. Restricted to one source
+    cursor = manager.openShipmentCursor(QDate(), QDate(), &sourceEu);
+    ids.clear();
+    while (cursor->next()) {
+        ids << cursor->getId();
+    }
+    QCOMPARE(ids, QStringList({"a", "c"}));
+
+    // 3. Reversals are negated, like in getShipmentAndRefunds
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+    Shipment ship1Changed = makeShipment("a", "a", QDate(2023, 1, 1), 15.0);
+    manager.recordShipmentFromSource("a", &sourceEu, &ship1Changed, QDate(2023, 2, 10));
+    cursor = manager.openShipmentCursor(QDate(2023, 2, 1), QDate(2023, 2, 28), &sourceEu);
+    double sum = 0.;
+    int count = 0;
+    while (cursor->next()) {
+        sum += cursor->getShipment().getActivities().first().getAmountTaxed();
+        ++count;
+    }
+    QCOMPARE(count, 2);
+    QCOMPARE(sum, 5.0);
+}
+
+void TestOrderManager::test_shipmentQuery()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource sourceEu{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    ActivitySource sourceUs{ActivitySourceType::Report, "Amazon", "Amazon US", "Tax Report"};
+    ActivitySource sourceTemu{ActivitySourceType::API, "Temu", "Temu EU", "Orders"};
+
+    auto ids = [](const QMultiMap<QDateTime, QSharedPointer<Shipment>> &results) {
+        QStringList ids;
+        for (const auto &shipment : results) {
+            ids << shipment->getId();
+        }
+        ids.sort();
+        return ids;
+    };
+
+    Shipment shipA = makeShipment("a", "a", QDate(2023, 1, 5), 10.0, "DE", TaxScheme::EuOssUnion);
+    Shipment shipB = makeShipment("b", "b", QDate(2023, 1, 5), 20.0, "FR", TaxScheme::DomesticVat);
+    Shipment shipC = makeShipment("c", "c", QDate(2023, 1, 5), 30.0, "IT", TaxScheme::EuOssUnion);
+    manager.recordOrder("a", "amazon.de");
+    manager.recordOrder("b", "amazon.fr");
+    manager.recordShipmentFromSource("a", &sourceEu, &shipA, QDate());
+    manager.recordShipmentFromSource("b", &sourceUs, &shipB, QDate());
+    manager.recordShipmentFromSource("c", &sourceTemu, &shipC, QDate());
+
+    ShipmentQuery query;
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"a", "b", "c"}));
+
+    query.sources = {sourceEu, sourceTemu};
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"a", "c"}));
+
+    query = ShipmentQuery();
+    query.channels = {"Amazon"};
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"a", "b"}));
+
+    query = ShipmentQuery();
+    query.stores = {"amazon.fr"};
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"b"}));
+
+    query = ShipmentQuery();
+    query.taxSchemes = {TaxScheme::EuOssUnion};
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"a", "c"}));
+    query.countryCodesTo = {"IT"};
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"c"}));
+
+    // Residual callback on top of the SQL filter
+    query = ShipmentQuery();
+    query.channels = {"Amazon"};
+    auto results = manager.getShipmentAndRefunds(query, [](const ActivitySource*, const Shipment *shipment) {
+        return shipment->getActivities().first().getAmountTaxed() > 15.0;
+    });
+    QCOMPARE(ids(results), QStringList({"b"}));
+
+    // Status and revision kind
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+    Shipment shipAChanged = makeShipment("a", "a", QDate(2023, 1, 5), 15.0, "DE", TaxScheme::EuOssUnion);
+    manager.recordShipmentFromSource("a", &sourceEu, &shipAChanged, QDate(2023, 2, 10));
+
+    query = ShipmentQuery();
+    query.statuses = {"Draft"};
+    QCOMPARE(manager.getShipmentAndRefunds(query).size(), 2);
+    query.revisionKinds = {RevisionKind::Reversal};
+    results = manager.getShipmentAndRefunds(query);
+    QCOMPARE(results.size(), 1);
+    QCOMPARE(results.first()->getActivities().first().getAmountTaxed(), -10.0);
+
+    query = ShipmentQuery();
+    query.revisionKinds = {RevisionKind::Original};
+    QCOMPARE(ids(manager.getShipmentAndRefunds(query)), QStringList({"a", "b", "c"}));
+
+    auto bySource = manager.getActivitySource_store_ShipmentAndRefunds(query);
+    QCOMPARE(bySource.size(), 3);
+    QCOMPARE(bySource[sourceUs]["amazon.fr"].size(), 1);
+}
+
+void TestOrderManager::test_reversalStoredNegated()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    Shipment ship100 = makeShipment("ordR", "actR", QDate(2023, 1, 5), 100.0);
+    manager.recordShipmentFromSource("ordR", &source, &ship100, QDate());
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+    Shipment ship150 = makeShipment("ordR", "actR", QDate(2023, 1, 5), 150.0);
+    manager.recordShipmentFromSource("ordR", &source, &ship150, QDate(2023, 2, 10));
+
+    QSqlQuery q(manager.m_db);
+    q.exec("SELECT revision_kind, current_data FROM shipments ORDER BY revision_kind");
+    QHash<QString, double> kind_amount;
+    while (q.next()) {
+        Shipment shipment = Shipment::fromCbor(q.value(1).toByteArray());
+        kind_amount[q.value(0).toString()] = shipment.getActivities().first().getAmountTaxed();
+    }
+    QCOMPARE(kind_amount.size(), 3);
+    QCOMPARE(kind_amount["Original"], 100.0);
+    QCOMPARE(kind_amount["Reversal"], -100.0);
+    QCOMPARE(kind_amount["NewVersion"], 150.0);
+
+    // A second change before publish updates the NewVersion draft only
+    Shipment ship170 = makeShipment("ordR", "actR", QDate(2023, 1, 5), 170.0);
+    manager.recordShipmentFromSource("ordR", &source, &ship170, QDate(2023, 2, 10));
+    auto totals = manager.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 3, 1));
+    QCOMPARE(totals.size(), 1);
+    QCOMPARE(totals.first().amountTaxed, 170.0);
+}
+
+void TestOrderManager::test_migrationReversalNegated()
+{
+    QTemporaryDir tempDir;
+    const QString connectionName = "test_migrationReversalNegated";
+    const QString reversalJson = QJsonDocument(makeShipment("ordM", "actM", QDate(2023, 1, 5), 100.0).toJson()).toJson(QJsonDocument::Compact);
+    {
+        // Orders.db created before the migrations: reversal rows store the content they reverse
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(QDir(tempDir.path()).absoluteFilePath("Orders.db"));
+        QVERIFY(db.open());
+        QSqlQuery q(db);
+        QVERIFY(q.exec("CREATE TABLE orders (id TEXT PRIMARY KEY, address_json TEXT, store TEXT)"));
+        QVERIFY(q.exec("CREATE TABLE shipments (id TEXT PRIMARY KEY, order_id TEXT NOT NULL, status TEXT NOT NULL, "
+                       "original_json TEXT NOT NULL, current_json TEXT NOT NULL, published_json TEXT, publication_date TEXT, "
+                       "event_date TEXT, source_key TEXT, root_id TEXT, FOREIGN KEY(order_id) REFERENCES orders(id))"));
+        QVERIFY(q.exec("CREATE TABLE financial_events (id TEXT PRIMARY KEY, shipment_id TEXT NOT NULL, type TEXT NOT NULL, "
+                       "event_date TEXT NOT NULL, amount REAL NOT NULL, currency TEXT NOT NULL, content_json TEXT NOT NULL, "
+                       "FOREIGN KEY(shipment_id) REFERENCES shipments(id))"));
+        QVERIFY(q.exec("CREATE TABLE invoicing_infos (shipment_root_id TEXT PRIMARY KEY, json TEXT NOT NULL)"));
+        QVERIFY(q.exec("INSERT INTO orders (id) VALUES ('ordM')"));
+        QVERIFY(q.exec(QString("INSERT INTO shipments (id, order_id, status, original_json, current_json, event_date, source_key, root_id) "
+                               "VALUES ('actM', 'ordM', 'Published', '%1', '%1', '2023-01-05T10:00:00', '', NULL), "
+                               "('actM-rev-1', 'ordM', 'Draft', '%1', '%1', '2023-02-10', '', 'actM')").arg(reversalJson)));
+        QVERIFY(q.exec("INSERT INTO invoicing_infos (shipment_root_id, json) VALUES ('actM', '{\"invoiceNumber\":\"INV-M\",\"items\":[]}')"));
+        q.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    OrderManager manager(tempDir.path());
+    QSqlQuery q(manager.m_db);
+    QVERIFY(q.exec("PRAGMA user_version"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), OrderManagerSql::SCHEMA_VERSION);
+    QVERIFY(q.exec("SELECT revision_kind, current_data FROM shipments WHERE id = 'actM-rev-1'"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toString(), QString("Reversal"));
+    Shipment reversal = Shipment::fromCbor(q.value(1).toByteArray());
+    QCOMPARE(reversal.getActivities().first().getAmountTaxed(), -100.0);
+    QVERIFY(q.exec("SELECT amount_taxed FROM activities WHERE shipment_id = 'actM-rev-1'"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toDouble(), -100.0);
+
+    // JSON columns converted to binary content then dropped
+    QVERIFY(q.exec("SELECT current_data, content_hash FROM shipments WHERE id = 'actM'"));
+    QVERIFY(q.next());
+    QCOMPARE(Shipment::fromCbor(q.value(0).toByteArray()).getActivities().first().getAmountTaxed(), 100.0);
+    QCOMPARE(q.value(1).toByteArray(), QCryptographicHash::hash(q.value(0).toByteArray(), QCryptographicHash::Sha1));
+    QVERIFY(!q.exec("SELECT current_json FROM shipments"));
+    QVERIFY(!q.exec("SELECT content_json FROM financial_events"));
+    auto info = manager.getInvoicingInfo("actM-rev-1");
+    QVERIFY(info);
+    QCOMPARE(info->getInvoiceNumber(), std::optional<QString>("INV-M"));
+    QVERIFY(!info->getInvoiceLink());
+}
+
+void TestOrderManager::test_shipmentHeads()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    auto heads = [&manager]() {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT head_id, published_head_id FROM shipment_heads WHERE root_id = 'actH'");
+        return q.next() ? QStringList{q.value(0).toString(), q.value(1).toString()} : QStringList();
+    };
+    auto headAmount = [&manager](QString *status) {
+        auto head = manager.getHeadShipment("actH", status);
+        return head ? head->getActivities().first().getAmountTaxed() : 0.;
+    };
+
+    // 1. New row is its own head, not published yet
+    Shipment ship100 = makeShipment("ordH", "actH", QDate(2023, 1, 5), 100.0);
+    manager.recordShipmentFromSource("ordH", &source, &ship100, QDate());
+    QCOMPARE(heads(), QStringList({"actH", ""}));
+    QString status;
+    QCOMPARE(headAmount(&status), 100.0);
+    QCOMPARE(status, QString("Draft"));
+
+    // 2. Publish
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+    QCOMPARE(heads(), QStringList({"actH", "actH"}));
+    QCOMPARE(headAmount(&status), 100.0);
+    QCOMPARE(status, QString("Published"));
+
+    // 3. Conflict => the new version becomes the head, the published head doesn't move
+    Shipment ship150 = makeShipment("ordH", "actH", QDate(2023, 1, 5), 150.0);
+    manager.recordShipmentFromSource("ordH", &source, &ship150, QDate(2023, 2, 10));
+    QStringList headIds = heads();
+    QVERIFY(headIds[0].startsWith("actH-v-"));
+    QCOMPARE(headIds[1], QString("actH"));
+    QCOMPARE(headAmount(&status), 150.0);
+    QCOMPARE(status, QString("Draft"));
+    QVERIFY(!manager.getShipmentOrRefundIfDifferent("ordH", &source, &ship150));
+    QVERIFY(manager.getShipmentOrRefundIfDifferent("ordH", &source, &ship100));
+
+    // 4. Publishing the revisions moves the published head to the new version
+    publishUntil = QDate(2023, 3, 1);
+    manager.publish(publishUntil);
+    QCOMPARE(heads(), QStringList({headIds[0], headIds[0]}));
+
+    // 5. Re-import of the published new version => no change
+    manager.recordShipmentFromSource("ordH", &source, &ship150, QDate(2023, 3, 10));
+    QSqlQuery q(manager.m_db);
+    q.exec("SELECT COUNT(*) FROM shipments");
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 3);
+}
+
+void TestOrderManager::test_contentHashes()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    auto countShipments = [&manager]() {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT COUNT(*) FROM shipments");
+        return q.next() ? q.value(0).toInt() : -1;
+    };
+    auto currentData = [&manager](const QString &id) {
+        QSqlQuery q(manager.m_db);
+        q.prepare("SELECT current_data FROM shipments WHERE id = ?");
+        q.addBindValue(id);
+        return q.exec() && q.next() ? q.value(0).toByteArray() : QByteArray();
+    };
+
+    // 1. Hashes are written with the row
+    Shipment ship100 = makeShipment("ordC", "actC", QDate(2023, 1, 5), 100.0);
+    manager.recordShipmentFromSource("ordC", &source, &ship100, QDate());
+    QSqlQuery q(manager.m_db);
+    QVERIFY(q.exec("SELECT current_data, content_hash, tax_hash FROM shipments WHERE id = 'actC'"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(1).toByteArray(), QCryptographicHash::hash(q.value(0).toByteArray(), QCryptographicHash::Sha1));
+    QCOMPARE(q.value(2).toByteArray(), ship100.taxHash());
+    q.finish();
+
+    // 2. Tax hash ignores the time of day, not the amounts
+    Shipment ship100Later({makeActivity("ordC", "actC", "", QDateTime(QDate(2023, 1, 5), QTime(18, 30)), Amount(100.0, 20.0))});
+    QCOMPARE(ship100Later.taxHash(), ship100.taxHash());
+    QVERIFY(makeShipment("ordC", "actC", QDate(2023, 1, 5), 150.0).taxHash() != ship100.taxHash());
+    QVERIFY(ship100.negated().taxHash() != ship100.taxHash());
+
+    QDate publishUntil(2023, 2, 1);
+    manager.publish(publishUntil);
+
+    // 3. Unchanged re-import => nothing written
+    manager.recordShipmentFromSource("ordC", &source, &ship100, QDate(2023, 2, 10));
+    QCOMPARE(countShipments(), 1);
+    QVERIFY(!manager.getShipmentOrRefundIfDifferent("ordC", &source, &ship100));
+
+    // 4. Content-only change => updated in place, no revision
+    manager.recordShipmentFromSource("ordC", &source, &ship100Later, QDate(2023, 2, 10));
+    QCOMPARE(countShipments(), 1);
+    QCOMPARE(currentData("actC"), ship100Later.toCbor());
+    QVERIFY(!manager.getShipmentOrRefundIfDifferent("ordC", &source, &ship100Later));
+
+    // 5. Tax change => reversal + new version
+    Shipment ship150 = makeShipment("ordC", "actC", QDate(2023, 1, 5), 150.0);
+    QVERIFY(manager.getShipmentOrRefundIfDifferent("ordC", &source, &ship150));
+    manager.recordShipmentFromSource("ordC", &source, &ship150, QDate(2023, 2, 10));
+    QCOMPARE(countShipments(), 3);
+    QVERIFY(q.exec("SELECT current_data, content_hash, tax_hash FROM shipments WHERE revision_kind = 'Reversal'"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(1).toByteArray(), QCryptographicHash::hash(q.value(0).toByteArray(), QCryptographicHash::Sha1));
+    QCOMPARE(q.value(2).toByteArray(), ship100Later.negated().taxHash());
+}
+
+void TestOrderManager::test_cborEncoding()
+{
+    // Local (offset-less) and UTC date times, several activities
+    auto actLocal = Activity::create("ordB", "actB", "1", QDateTime(QDate(2023, 1, 5), QTime(10, 0, 30)), "EUR", "FR", "DE", "DE",
+         Amount(119.99, 19.16), TaxSource::MarketplaceProvided, "DE", TaxScheme::EuOssUnion, TaxJurisdictionLevel::Country, SaleType::Products);
+    auto actUtc = Activity::create("ordB", "actB", "2", QDateTime(QDate(2023, 1, 5), QTime(23, 30), QTimeZone::UTC), "EUR", "FR", "DE", "DE",
+         Amount(4.99, 0.80), TaxSource::MarketplaceProvided, "DE", TaxScheme::EuOssUnion, TaxJurisdictionLevel::Country, SaleType::Service,
+         "", "DE-BUS");
+    Shipment shipment({*actLocal.value, *actUtc.value});
+
+    const QByteArray data = shipment.toCbor();
+    QCOMPARE(data, shipment.toCbor()); // Deterministic, as needed by content_hash
+    QVERIFY(data.size() < QJsonDocument(shipment.toJson()).toJson(QJsonDocument::Compact).size() / 2);
+
+    Shipment decoded = Shipment::fromCbor(data);
+    QCOMPARE(decoded.toJson(), shipment.toJson());
+    QCOMPARE(decoded.getActivities()[0].getDateTime().timeSpec(), Qt::LocalTime);
+    QCOMPARE(decoded.getActivities()[1].getDateTime().timeSpec(), Qt::UTC);
+    QCOMPARE(decoded.taxHash(), shipment.taxHash());
+
+    // Invoicing infos, with and without the optional fields
+    auto item = LineItem::create("SKU1", "Item 1", 119.99, 0.19, 2);
+    InvoicingInfo info(nullptr, {*item.value}, "INV-B");
+    InvoicingInfo decodedInfo = InvoicingInfo::fromCbor(info.toCbor());
+    QCOMPARE(decodedInfo.toJson(), info.toJson());
+    QVERIFY(!decodedInfo.getInvoiceLink());
+    InvoicingInfo emptyInfo(nullptr);
+    QCOMPARE(InvoicingInfo::fromCbor(emptyInfo.toCbor()).toJson(), emptyInfo.toJson());
+}
+
+void TestOrderManager::test_publishBatched()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    // Two activities without sub activity ID + one with
+    const QDateTime dateTime(QDate(2023, 1, 5), QTime(10, 0));
+    Shipment shipMulti({makeActivity("ordP", "actP", "", dateTime, Amount(10.0, 2.0)),
+                        makeActivity("ordP", "actP", "", dateTime, Amount(20.0, 4.0)),
+                        makeActivity("ordP", "actP", "fee", dateTime, Amount(5.0, 1.0))});
+    Shipment shipSingle({makeActivity("ordP", "actS", "", dateTime, Amount(100.0, 20.0))});
+    manager.recordShipmentFromSource("ordP", &source, &shipMulti, QDate());
+    manager.recordShipmentFromSource("ordP", &source, &shipSingle, QDate());
+
+    auto eventIds = [&manager]() {
+        QStringList ids;
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT id FROM financial_events ORDER BY id");
+        while (q.next()) {
+            ids << q.value(0).toString();
+        }
+        return ids;
+    };
+    auto countDrafts = [&manager]() {
+        QSqlQuery q(manager.m_db);
+        q.exec("SELECT COUNT(*) FROM shipments WHERE status = 'Draft'");
+        return q.next() ? q.value(0).toInt() : -1;
+    };
+
+    // 1. Cancelled => rolled back
+    QDate publishUntil(2023, 2, 1);
+    QList<QPair<int, int>> progress;
+    QVERIFY(!manager.publish(publishUntil, [&progress](int done, int total) {
+        progress << qMakePair(done, total);
+        return false;
+    }));
+    QCOMPARE(progress, (QList<QPair<int, int>>{{2, 2}}));
+    QCOMPARE(countDrafts(), 2);
+    QVERIFY(eventIds().isEmpty());
+
+    // 2. Published with unique, deterministic event IDs
+    progress.clear();
+    QVERIFY(manager.publish(publishUntil, [&progress](int done, int total) {
+        progress << qMakePair(done, total);
+        return true;
+    }));
+    QCOMPARE(progress, (QList<QPair<int, int>>{{2, 2}}));
+    QCOMPARE(countDrafts(), 0);
+    QCOMPARE(eventIds(), QStringList({"INV-actP", "INV-actP#1", "INV-actP-fee", "INV-actS"}));
+
+    // 3. Nothing left to publish
+    progress.clear();
+    QVERIFY(manager.publish(publishUntil, [&progress](int done, int total) {
+        progress << qMakePair(done, total);
+        return true;
+    }));
+    QVERIFY(progress.isEmpty());
+}
+
+void TestOrderManager::test_threadConnections()
+{
+    QTemporaryDir tempDir1;
+    QTemporaryDir tempDir2;
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    const QDate dateFrom(2023, 1, 1);
+    const QDate dateTo(2023, 1, 31);
+
+    // 1. Two instances (two companies) keep their own connection
+    OrderManager manager1(tempDir1.path());
+    OrderManager manager2(tempDir2.path());
+    QVERIFY(manager1.m_db.connectionName() != manager2.m_db.connectionName());
+    Shipment ship100 = makeShipment("ordT", "actT1", QDate(2023, 1, 5), 100.0);
+    Shipment ship200 = makeShipment("ordT", "actT2", QDate(2023, 1, 5), 200.0);
+    manager1.recordShipmentFromSource("ordT", &source, &ship100, QDate());
+    manager2.recordShipmentFromSource("ordT", &source, &ship200, QDate());
+    QCOMPARE(manager1.getActivityTotals(dateFrom, dateTo).first().amountTaxed, 100.0);
+    QCOMPARE(manager2.getActivityTotals(dateFrom, dateTo).first().amountTaxed, 200.0);
+
+    QSqlQuery q(manager1.m_db);
+    QVERIFY(q.exec("PRAGMA journal_mode"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toString(), QString("wal"));
+    q.finish();
+
+    // 2. A worker thread reads with its own connection while the creating thread writes
+    QVERIFY(manager1.m_db.transaction());
+    Shipment ship300 = makeShipment("ordT", "actT3", QDate(2023, 1, 5), 300.0);
+    manager1.recordShipmentFromSource("ordT", &source, &ship300, QDate());
+    QCOMPARE(manager1.getActivityTotals(dateFrom, dateTo).first().amountTaxed, 400.0);
+
+    double workerAmount = 0.;
+    QString workerConnectionName;
+    QThread *thread = QThread::create([&]() {
+        workerConnectionName = manager1._db().connectionName();
+        workerAmount = manager1.getActivityTotals(dateFrom, dateTo).first().amountTaxed;
+    });
+    thread->start();
+    QVERIFY(thread->wait(10000));
+    delete thread;
+    QCOMPARE(workerAmount, 100.0); // Not committed yet
+    QVERIFY(workerConnectionName.startsWith(manager1.m_db.connectionName() + "-"));
+    QVERIFY(!QSqlDatabase::contains(workerConnectionName)); // Removed when the thread finished
+    QVERIFY(manager1.m_db.commit());
+
+    thread = QThread::create([&]() {
+        workerAmount = manager1.getActivityTotals(dateFrom, dateTo).first().amountTaxed;
+    });
+    thread->start();
+    QVERIFY(thread->wait(10000));
+    delete thread;
+    QCOMPARE(workerAmount, 400.0);
+}
+
+void TestOrderManager::test_async()
+{
+    QTemporaryDir tempDir;
+    OrderManagerAsync orderManagerAsync(QSharedPointer<OrderManager>::create(tempDir.path()));
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    // Writes queued without waiting run in call order on the database thread
+    auto task1 = orderManagerAsync.recordShipmentFromSource("ordA", source, makeShipment("ordA", "actA1", QDate(2023, 1, 5), 100.0), QDate());
+    auto task2 = orderManagerAsync.recordShipmentFromSource("ordA", source, makeShipment("ordA", "actA1", QDate(2023, 1, 5), 150.0), QDate());
+    auto task3 = orderManagerAsync.recordShipmentFromSource("ordA", source, makeShipment("ordA", "actA2", QDate(2023, 1, 5), 50.0), QDate());
+    QCoro::waitFor(std::move(task1));
+    QCoro::waitFor(std::move(task2));
+    QCoro::waitFor(std::move(task3));
+
+    auto totals = QCoro::waitFor(orderManagerAsync.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 1, 31)));
+    QCOMPARE(totals.size(), 1);
+    QCOMPARE(totals.first().amountTaxed, 200.0);
+
+    QThread *progressThread = nullptr;
+    const bool published = QCoro::waitFor(orderManagerAsync.publish(QDate(2023, 2, 1), [&progressThread](int, int) {
+        progressThread = QThread::currentThread();
+        return true;
+    }));
+    QVERIFY(published);
+    QVERIFY(progressThread);
+    QVERIFY(progressThread != QThread::currentThread());
+
+    auto different = QCoro::waitFor(orderManagerAsync.getShipmentOrRefundIfDifferent("ordA", source, makeShipment("ordA", "actA1", QDate(2023, 1, 5), 150.0)));
+    QVERIFY(!different);
+    ShipmentQuery shipmentQuery;
+    shipmentQuery.dateFrom = QDate(2023, 1, 1);
+    shipmentQuery.dateTo = QDate(2023, 1, 31);
+    auto source_store_shipments = QCoro::waitFor(orderManagerAsync.getActivitySource_store_ShipmentAndRefunds(shipmentQuery));
+    QCOMPARE(source_store_shipments.value(source).value(QString()).size(), 2);
+}
+
+void TestOrderManager::test_archiveYears()
+{
+    QTemporaryDir tempDir;
+    QDir dir(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    auto sumTaxed = [](const QList<OrderManager::ActivityTotal> &totals) {
+        double sum = 0.;
+        for (const auto &total : totals) {
+            sum += total.amountTaxed;
+        }
+        return sum;
+    };
+    auto cursorIds = [](OrderManager &manager, const QDate &dateFrom, const QDate &dateTo) {
+        QStringList ids;
+        auto cursor = manager.openShipmentCursor(dateFrom, dateTo);
+        while (cursor->next()) {
+            ids << cursor->getId();
+        }
+        return ids;
+    };
+
+    OrderManager manager(dir);
+    const Shipment shipA = makeShipment("ordA", "actordA", QDate(2022, 3, 1), 100.0);
+    const Shipment shipB = makeShipment("ordB", "actordB", QDate(2023, 12, 30), 200.0);
+    const Shipment shipC = makeShipment("ordC", "actordC", QDate(2022, 6, 1), 50.0);
+    const Shipment shipD = makeShipment("ordD", "actordD", QDate(2024, 2, 1), 30.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA, QDate());
+    manager.recordShipmentFromSource("ordB", &source, &shipB, QDate());
+    manager.recordShipmentFromSource("ordC", &source, &shipC, QDate());
+    manager.recordShipmentFromSource("ordD", &source, &shipD, QDate());
+    QDate publishUntil(2023, 12, 31);
+    QVERIFY(manager.publish(publishUntil));
+    // ordC is corrected in 2024: its revision group stays in Orders.db
+    const Shipment shipC2 = makeShipment("ordC", "actordC", QDate(2022, 6, 1), 60.0);
+    manager.recordShipmentFromSource("ordC", &source, &shipC2, QDate(2024, 1, 10));
+
+    const QDate dateFrom(2022, 1, 1);
+    const QDate dateTo(2024, 12, 31);
+    const double taxedBefore = sumTaxed(manager.getActivityTotals(dateFrom, dateTo));
+    const QStringList idsBefore = cursorIds(manager, dateFrom, dateTo);
+    QCOMPARE(taxedBefore, 100.0 + 200.0 + 60.0 + 30.0);
+    QCOMPARE(idsBefore.size(), 6);
+
+    // 1. Copy of the groups closed at the end of 2022, Orders.db unchanged
+    const QString copyPath = dir.absoluteFilePath("Copy.db");
+    QVERIFY(manager.copyDatabase(copyPath, 2022));
+    {
+        QSqlDatabase copyDb = QSqlDatabase::addDatabase("QSQLITE", "test_archiveYears_copy");
+        copyDb.setDatabaseName(copyPath);
+        QVERIFY(copyDb.open());
+        QSqlQuery q(copyDb);
+        QVERIFY(q.exec("SELECT id FROM shipments"));
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toString(), QString("actordA"));
+        QVERIFY(!q.next());
+        QVERIFY(q.exec("SELECT COUNT(*) FROM financial_events"));
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toInt(), 1);
+        q.finish();
+        copyDb.close();
+    }
+    QSqlDatabase::removeDatabase("test_archiveYears_copy");
+    QCOMPARE(cursorIds(manager, dateFrom, dateTo), idsBefore);
+
+    // 2. Closed years moved into their partitions
+    QVERIFY(manager.archiveYears(2023));
+    QVERIFY(dir.exists("Orders-2022.db"));
+    QVERIFY(dir.exists("Orders-2023.db"));
+    QVERIFY(!dir.exists("Orders-2024.db"));
+    QStringList liveIds;
+    {
+        QSqlQuery q(manager.m_db);
+        QVERIFY(q.exec("SELECT id FROM shipments ORDER BY id"));
+        while (q.next()) {
+            liveIds << q.value(0).toString();
+        }
+        QVERIFY(q.exec("SELECT id FROM orders ORDER BY id"));
+        QStringList orderIds;
+        while (q.next()) {
+            orderIds << q.value(0).toString();
+        }
+        QCOMPARE(orderIds, QStringList({"ordC", "ordD"}));
+    }
+    QCOMPARE(liveIds.size(), 4);
+    QVERIFY(!liveIds.contains("actordA"));
+    QVERIFY(!liveIds.contains("actordB"));
+
+    // 3. Period queries attach the partitions they span, read-only
+    QCOMPARE(sumTaxed(manager.getActivityTotals(dateFrom, dateTo)), taxedBefore);
+    QCOMPARE(cursorIds(manager, dateFrom, dateTo), idsBefore);
+    QCOMPARE(sumTaxed(manager.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 12, 31))), 200.0);
+    {
+        QSqlQuery q(manager.m_db);
+        QVERIFY(!q.exec("DELETE FROM y2023.shipments"));
+    }
+    QCOMPARE(sumTaxed(manager.getActivityTotals(QDate(2024, 1, 1), dateTo)), 30.0 - 50.0 + 60.0);
+
+    // 4. Nothing left to archive
+    QVERIFY(manager.archiveYears(2023));
+    QCOMPARE(sumTaxed(manager.getActivityTotals(dateFrom, dateTo)), taxedBefore);
+
+    // 5. Partitions found again by a new instance
+    OrderManager reopened(dir);
+    QCOMPARE(sumTaxed(reopened.getActivityTotals(dateFrom, dateTo)), taxedBefore);
+}
+
+void TestOrderManager::test_clearUnpublished()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    auto count = [&manager](const QString &sql) {
+        QSqlQuery q(manager.m_db);
+        return q.exec(sql) && q.next() ? q.value(0).toInt() : -1;
+    };
+
+    const Shipment shipA = makeShipment("ordA", "actordA", QDate(2023, 1, 5), 100.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA, QDate());
+    QDate publishUntil(2023, 12, 31);
+    QVERIFY(manager.publish(publishUntil));
+    // Conflict on a published shipment (Reversal + NewVersion drafts) and a new draft shipment with an invoicing info
+    const Shipment shipA2 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), 120.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA2, QDate(2023, 2, 1));
+    const Shipment shipB = makeShipment("ordB", "actordB", QDate(2023, 1, 5), 50.0);
+    manager.recordShipmentFromSource("ordB", &source, &shipB, QDate());
+    InvoicingInfo info(&shipB, {}, "INV-B");
+    manager.recordInvoicingInfo("actordB", &info);
+    QCOMPARE(count("SELECT COUNT(*) FROM shipments WHERE status = 'Draft'"), 3);
+
+    manager.clearUnpublished();
+    QCOMPARE(count("SELECT COUNT(*) FROM shipments"), 1);
+    QCOMPARE(count("SELECT COUNT(*) FROM activities"), 1);
+    QCOMPARE(count("SELECT COUNT(*) FROM shipment_heads WHERE root_id = 'actordA' AND head_id = 'actordA'"), 1);
+    QCOMPARE(count("SELECT COUNT(*) FROM shipment_heads"), 1);
+    QVERIFY(manager.getInvoicingInfo("actordB").isNull());
+    QCOMPARE(manager.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 12, 31)).first().amountTaxed, 100.0);
+
+    // The published shipment is back to its published content: the same conflict gives a new revision
+    manager.recordShipmentFromSource("ordA", &source, &shipA2, QDate(2023, 2, 1));
+    QCOMPARE(count("SELECT COUNT(*) FROM shipments WHERE root_id = 'actordA' AND status = 'Draft'"), 2);
+}
+
+void TestOrderManager::test_compactAndDelete()
+{
+    QTemporaryDir tempDir;
+    QDir dir(tempDir.path());
+    OrderManager manager(dir);
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    auto count = [&manager](const QString &sql) {
+        QSqlQuery q(manager.m_db);
+        return q.exec(sql) && q.next() ? q.value(0).toInt() : -1;
+    };
+
+    const Shipment shipA = makeShipment("ordA", "actordA", QDate(2023, 1, 5), 100.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA, QDate());
+    QDate publishUntil(2023, 12, 31);
+    QVERIFY(manager.publish(publishUntil));
+    const Shipment shipA2 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), 120.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA2, QDate(2023, 2, 1));
+
+    // Left behind: a superseded revision pair of actordA, a revision of a missing root, an invoicing info without shipment
+    {
+        QSqlQuery q(manager.m_db);
+        QVERIFY(q.exec("INSERT INTO shipments (id, order_id, status, current_data, event_date, root_id, revision_kind) VALUES "
+                       "('actordA-rev-1', 'ordA', 'Draft', x'00', '2023-01-20', 'actordA', 'Reversal'), "
+                       "('actordA-v-1', 'ordA', 'Draft', x'00', '2023-01-20', 'actordA', 'NewVersion'), "
+                       "('actordZ-rev-1', 'ordA', 'Draft', x'00', '2023-01-20', 'actordZ', 'Reversal')"));
+        QVERIFY(q.exec("INSERT INTO invoicing_infos (shipment_root_id, data) VALUES ('ghost', x'00')"));
+    }
+    const int draftsBefore = count("SELECT COUNT(*) FROM shipments WHERE status = 'Draft'");
+
+    OrderManager::CompactionReport report = manager.compact();
+    QCOMPARE(report.draftsPruned, 3);
+    QCOMPARE(report.invoicingInfosPruned, 1);
+    QCOMPARE(count("SELECT COUNT(*) FROM shipments WHERE status = 'Draft'"), draftsBefore - 3);
+    QCOMPARE(count("SELECT COUNT(*) FROM shipment_heads WHERE head_id LIKE 'actordA-v-%'"), 1);
+    QCOMPARE(count("PRAGMA auto_vacuum"), 2);
+    QVERIFY(report.bytesBefore > 0);
+    QCOMPARE(report.bytesReclaimed, report.bytesBefore - report.bytesAfter);
+    QVERIFY(report.msecs >= 0);
+
+    // Nothing left to prune
+    report = manager.compact();
+    QCOMPARE(report.draftsPruned, 0);
+    QCOMPARE(report.invoicingInfosPruned, 0);
+
+    // Deleted rows and partitions, their pages reclaimed by the next compaction
+    for (int i = 0; i < 500; ++i) {
+        const QString orderId = QString("ord%1").arg(i);
+        const Shipment shipment = makeShipment(orderId, "act" + orderId, QDate(2022, 1, 1).addDays(i % 300), 10.0 + i);
+        manager.recordShipmentFromSource(orderId, &source, &shipment, QDate());
+    }
+    publishUntil = QDate(2022, 12, 31);
+    QVERIFY(manager.publish(publishUntil));
+    QVERIFY(manager.archiveYears(2022));
+    QVERIFY(dir.exists("Orders-2022.db"));
+    manager.deleteDatabase();
+    QVERIFY(!dir.exists("Orders-2022.db"));
+    QCOMPARE(count("SELECT COUNT(*) FROM shipments"), 0);
+    QCOMPARE(count("SELECT COUNT(*) FROM orders"), 0);
+    QVERIFY(manager.getActivityTotals(QDate(2022, 1, 1), QDate(2023, 12, 31)).isEmpty());
+    report = manager.compact();
+    QVERIFY(report.bytesReclaimed > 0);
+}
+
+void TestOrderManager::test_periodAggregates()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    ActivitySource otherSource{ActivitySourceType::API, "Temu", "Temu EU", "Orders"};
+    auto sumTaxed = [](const QList<PeriodAggregate> &aggregates) {
+        double sum = 0.;
+        for (const auto &aggregate : aggregates) {
+            sum += aggregate.amountTaxed;
+        }
+        return sum;
+    };
+
+    const Shipment shipA = makeShipment("ordA", "actordA", QDate(2023, 1, 5), Amount(100.0, 20.0));
+    const Shipment shipB = makeShipment("ordB", "actordB", QDate(2023, 1, 20), Amount(50.0, 10.0));
+    const Shipment shipC = makeShipment("ordC", "actordC", QDate(2023, 2, 10), Amount(200.0, 40.0));
+    manager.recordOrder("ordA", "amazon.de");
+    manager.recordOrder("ordB", "amazon.de");
+    manager.recordShipmentFromSource("ordA", &source, &shipA, QDate());
+    manager.recordShipmentFromSource("ordB", &source, &shipB, QDate());
+    manager.recordShipmentFromSource("ordC", &otherSource, &shipC, QDate());
+
+    // 1. Drafts are not aggregated, publish adds the published rows of January
+    QVERIFY(manager.getPeriodAggregates(QDate(2023, 1, 1), QDate(2023, 2, 1)).isEmpty());
+    QDate publishUntil(2023, 1, 31);
+    QVERIFY(manager.publish(publishUntil));
+    auto aggregates = manager.getPeriodAggregates(QDate(2023, 1, 1), QDate(2023, 2, 1));
+    QCOMPARE(aggregates.size(), 1);
+    QCOMPARE(aggregates.first().month, QDate(2023, 1, 1));
+    QCOMPARE(aggregates.first().source, source);
+    QCOMPARE(aggregates.first().store, QString("amazon.de"));
+    QCOMPARE(aggregates.first().taxScheme, TaxScheme::EuOssUnion);
+    QCOMPARE(aggregates.first().countryCodeFrom, QString("FR"));
+    QCOMPARE(aggregates.first().countryCodeTo, QString("DE"));
+    QCOMPARE(aggregates.first().amountTaxed, 150.0);
+    QCOMPARE(aggregates.first().amountTaxes, 30.0);
+    QCOMPARE(aggregates.first().count, 2);
+
+    // 2. Same taxes but another amount: the published row is updated in place, and its aggregate with it
+    const Shipment shipB60 = makeShipment("ordB", "actordB", QDate(2023, 1, 20), Amount(60.0, 10.0));
+    manager.recordShipmentFromSource("ordB", &source, &shipB60, QDate());
+    aggregates = manager.getPeriodAggregates(QDate(2023, 1, 1), QDate(2023, 1, 1));
+    QCOMPARE(aggregates.size(), 1);
+    QCOMPARE(aggregates.first().amountTaxed, 160.0);
+    QCOMPARE(aggregates.first().count, 2);
+
+    // 3. Conflict dated in February: the reversal and the new version are aggregated there once published
+    const Shipment shipA130 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), Amount(130.0, 26.0));
+    manager.recordShipmentFromSource("ordA", &source, &shipA130, QDate(2023, 2, 15));
+    publishUntil = QDate(2023, 2, 28);
+    QVERIFY(manager.publish(publishUntil));
+    aggregates = manager.getPeriodAggregates(QDate(2023, 2, 1), QDate(2023, 2, 1), &source);
+    QCOMPARE(aggregates.size(), 1);
+    QCOMPARE(aggregates.first().month, QDate(2023, 2, 1));
+    QCOMPARE(aggregates.first().amountTaxed, 30.0);
+    QCOMPARE(aggregates.first().amountTaxes, 6.0);
+    QCOMPARE(aggregates.first().count, 0);
+    QCOMPARE(manager.getPeriodAggregates(QDate(2023, 2, 1), QDate(2023, 2, 1), &otherSource).size(), 1);
+
+    // 4. Everything published, the aggregates give the activity totals
+    double totalTaxed = 0.;
+    for (const auto &total : manager.getActivityTotals(QDate(2023, 1, 1), QDate(2023, 2, 28))) {
+        totalTaxed += total.amountTaxed;
+    }
+    QCOMPARE(totalTaxed, 390.0);
+    QCOMPARE(sumTaxed(manager.getPeriodAggregates(QDate(2023, 1, 1), QDate(2023, 2, 1))), totalTaxed);
+
+    // 5. Migration 9 backfills the same aggregates from the published rows
+    {
+        QSqlQuery q(manager.m_db);
+        QVERIFY(q.exec("DELETE FROM period_aggregates"));
+        QVERIFY(q.exec(OrderManagerSql::MIGRATIONS[8].last()));
+    }
+    QCOMPARE(sumTaxed(manager.getPeriodAggregates(QDate(2023, 1, 1), QDate(2023, 2, 1))), totalTaxed);
+    QCOMPARE(manager.getPeriodAggregates(QDate(2023, 1, 1), QDate(2023, 1, 1)).first().amountTaxed, 160.0);
+
+    manager.deleteDatabase();
+    QVERIFY(manager.getPeriodAggregates(QDate(), QDate()).isEmpty());
+}
+
+void TestOrderManager::test_changeLog()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    auto readChanges = [&manager](qint64 seq) {
+        QList<OrderManager::Change> changes;
+        manager.changesSince(seq, [&changes](const OrderManager::Change &change) {
+            changes << change;
+            return true;
+        });
+        return changes;
+    };
+    QCOMPARE(manager.getLastChangeSeq(), 0);
+
+    // 1. Recorded then published, unchanged rows recorded again are not logged
+    const Shipment shipA = makeShipment("ordA", "actordA", QDate(2023, 1, 5), 100.0);
+    const Shipment shipB = makeShipment("ordB", "actordB", QDate(2023, 1, 20), 50.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA, QDate());
+    manager.recordShipmentFromSource("ordB", &source, &shipB, QDate());
+    manager.recordShipmentFromSource("ordB", &source, &shipB, QDate());
+    QDate publishUntil(2023, 1, 31);
+    QVERIFY(manager.publish(publishUntil));
+    auto changes = readChanges(0);
+    QCOMPARE(changes.size(), 4);
+    QCOMPARE(changes[0].kind, ChangeKind::Recorded);
+    QCOMPARE(changes[0].shipmentId, shipA.getId());
+    QCOMPARE(changes[0].source, source);
+    QCOMPARE(changes[0].eventDate, QDate(2023, 1, 5));
+    QCOMPARE(changes[1].kind, ChangeKind::Recorded);
+    QCOMPARE(changes[2].kind, ChangeKind::Published);
+    QCOMPARE(changes[2].shipmentId, shipA.getId());
+    QCOMPARE(changes[3].kind, ChangeKind::Published);
+    QCOMPARE(changes[3].shipmentId, shipB.getId());
+    for (int i = 1; i < changes.size(); ++i) {
+        QVERIFY(changes[i].seq > changes[i - 1].seq);
+    }
+    const qint64 checkpoint = manager.getLastChangeSeq();
+    QCOMPARE(checkpoint, changes.last().seq);
+
+    // 2. A conflict logs its two revisions in the period of the new date
+    const Shipment shipA150 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), 150.0);
+    manager.recordShipmentFromSource("ordA", &source, &shipA150, QDate(2023, 2, 15));
+    changes = readChanges(checkpoint);
+    QCOMPARE(changes.size(), 2);
+    for (const auto &change : changes) {
+        QCOMPARE(change.kind, ChangeKind::Revised);
+        QCOMPARE(change.rootId, shipA.getId());
+        QCOMPARE(change.eventDate, QDate(2023, 2, 15));
+    }
+
+    // 3. The callback stops the stream, the returned sequence is where to resume
+    int streamed = 0;
+    const qint64 resumeSeq = manager.changesSince(0, [&streamed](const OrderManager::Change &) {
+        return ++streamed < 2;
+    });
+    QCOMPARE(streamed, 2);
+    QCOMPARE(readChanges(resumeSeq).size(), 4);
+
+    // 4. Cleared drafts are logged as removed, pruning keeps the last change
+    manager.clearUnpublished();
+    changes = readChanges(checkpoint);
+    QCOMPARE(changes.size(), 4);
+    QCOMPARE(changes[2].kind, ChangeKind::Removed);
+    QCOMPARE(changes[3].kind, ChangeKind::Removed);
+    const qint64 lastSeq = manager.getLastChangeSeq();
+    manager.pruneChanges(lastSeq);
+    QCOMPARE(readChanges(0).size(), 1);
+    QCOMPARE(manager.getLastChangeSeq(), lastSeq);
+
+    // 5. Deleting the database logs a reset, the sequence going on
+    manager.deleteDatabase();
+    changes = readChanges(lastSeq);
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().kind, ChangeKind::Reset);
+    QVERIFY(changes.first().shipmentId.isEmpty());
+    QVERIFY(changes.first().seq > lastSeq);
+}
+
+void TestOrderManager::test_dirtyPeriods()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    // 1. Drafts don't invalidate anything, publish marks the periods of the published rows
+    const Shipment shipA = makeShipment("ordA", "actordA", QDate(2023, 1, 5), Amount(100.0, 20.0));
+    const Shipment shipB = makeShipment("ordB", "actordB", QDate(2023, 2, 20), Amount(50.0, 10.0));
+    manager.recordOrder("ordA", "amazon.de");
+    manager.recordShipmentFromSource("ordA", &source, &shipA, QDate());
+    manager.recordShipmentFromSource("ordB", &source, &shipB, QDate());
+    QVERIFY(manager.getDirtyPeriods().isEmpty());
+    QDate publishUntil(2023, 1, 31);
+    QVERIFY(manager.publish(publishUntil));
+    auto dirtyPeriods = manager.getDirtyPeriods();
+    QCOMPARE(dirtyPeriods.size(), 1);
+    QCOMPARE(dirtyPeriods.first().source, source);
+    QCOMPARE(dirtyPeriods.first().store, QString("amazon.de"));
+    QCOMPARE(dirtyPeriods.first().month, QDate(2023, 1, 1));
+    manager.markPeriodClean(dirtyPeriods.first());
+    QVERIFY(manager.getDirtyPeriods().isEmpty());
+
+    // 2. A published row updated in place marks its period again
+    const Shipment shipA110 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), Amount(110.0, 20.0));
+    manager.recordShipmentFromSource("ordA", &source, &shipA110, QDate());
+    dirtyPeriods = manager.getDirtyPeriods();
+    QCOMPARE(dirtyPeriods.size(), 1);
+    QCOMPARE(dirtyPeriods.first().month, QDate(2023, 1, 1));
+
+    // 3. Changed again while being regenerated => stays dirty
+    const Shipment shipA120 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), Amount(120.0, 20.0));
+    manager.recordShipmentFromSource("ordA", &source, &shipA120, QDate());
+    manager.markPeriodClean(dirtyPeriods.first());
+    QCOMPARE(manager.getDirtyPeriods().size(), 1);
+    manager.markPeriodClean(manager.getDirtyPeriods().first());
+    QVERIFY(manager.getDirtyPeriods().isEmpty());
+
+    // 4. A conflict only invalidates the period of its revisions once published
+    const Shipment shipA150 = makeShipment("ordA", "actordA", QDate(2023, 1, 5), Amount(150.0, 30.0));
+    manager.recordShipmentFromSource("ordA", &source, &shipA150, QDate(2023, 3, 10));
+    QVERIFY(manager.getDirtyPeriods().isEmpty());
+    publishUntil = QDate(2023, 3, 31);
+    QVERIFY(manager.publish(publishUntil));
+    dirtyPeriods = manager.getDirtyPeriods();
+    QCOMPARE(dirtyPeriods.size(), 2);
+    QCOMPARE(dirtyPeriods[0].month, QDate(2023, 2, 1)); // ordB, no store
+    QVERIFY(dirtyPeriods[0].store.isEmpty());
+    QCOMPARE(dirtyPeriods[1].month, QDate(2023, 3, 1));
+
+    manager.deleteDatabase();
+    QVERIFY(manager.getDirtyPeriods().isEmpty());
+}
+
+void TestOrderManager::test_orderTimeline()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+
+    QVERIFY(!manager.getOrderTimeline("ordA").found);
+
+    const Shipment ship = makeShipment("ordA", "act1", QDate(2023, 1, 5), 100.0);
+    const Shipment otherShip = makeShipment("ordA", "act2", QDate(2023, 1, 8), 40.0);
+    manager.recordOrder("ordA", "amazon.de");
+    manager.recordAddressTo("ordA", Address("John Doe", "Street", "", "", "City", "12345", "DE", "", "", "", "", ""));
+    manager.recordShipmentFromSource("ordA", &source, &ship, QDate());
+    manager.recordShipmentFromSource("ordA", &source, &otherShip, QDate());
+    InvoicingInfo info(&ship, {}, "INV-A1");
+    manager.recordInvoicingInfo(ship.getId(), &info);
+    QDate publishUntil(2023, 1, 31);
+    QVERIFY(manager.publish(publishUntil));
+    // Conflict on the first shipment: reversal + new version, drafts
+    const Shipment ship150 = makeShipment("ordA", "act1", QDate(2023, 1, 5), 150.0);
+    manager.recordShipmentFromSource("ordA", &source, &ship150, QDate(2023, 2, 10));
+
+    const OrderTimeline timeline = manager.getOrderTimeline("ordA");
+    QVERIFY(timeline.found);
+    QCOMPARE(timeline.store, QString("amazon.de"));
+    QVERIFY(timeline.addressTo);
+    QCOMPARE(timeline.addressTo->getFullName(), QString("John Doe"));
+
+    QCOMPARE(timeline.revisions.size(), 4);
+    QCOMPARE(timeline.revisions[0].id, ship.getId());
+    QCOMPARE(timeline.revisions[0].status, QString("Published"));
+    QVERIFY(timeline.revisions[0].publicationDate.isValid());
+    QVERIFY(timeline.revisions[0].isPublishedHead);
+    QVERIFY(!timeline.revisions[0].isHead);
+    QCOMPARE(timeline.revisions[0].source, source);
+    QCOMPARE(timeline.revisions[1].id, otherShip.getId());
+    QVERIFY(timeline.revisions[1].isHead);
+    int reversals = 0;
+    for (int i = 2; i < 4; ++i) {
+        const auto &revision = timeline.revisions[i];
+        QCOMPARE(revision.rootId, ship.getId());
+        QCOMPARE(revision.status, QString("Draft"));
+        QCOMPARE(revision.eventDate.date(), QDate(2023, 2, 10));
+        if (revision.revisionKind == RevisionKind::Reversal) {
+            ++reversals;
+            QCOMPARE(revision.shipment->getActivities().first().getAmountTaxed(), -100.0);
+        } else {
+            QCOMPARE(revision.revisionKind, RevisionKind::NewVersion);
+            QVERIFY(revision.isHead);
+            QCOMPARE(revision.shipment->getActivities().first().getAmountTaxed(), 150.0);
+        }
+    }
+    QCOMPARE(reversals, 1);
+
+    QCOMPARE(timeline.financialEvents.size(), 2);
+    QCOMPARE(timeline.financialEvents[0].shipmentId, ship.getId());
+    QCOMPARE(timeline.financialEvents[0].type, QString("Invoice"));
+    QCOMPARE(timeline.financialEvents[0].amount, 120.0);
+    QCOMPARE(timeline.financialEvents[1].shipmentId, otherShip.getId());
+
+    QCOMPARE(timeline.rootId_invoicingInfo.size(), 1);
+    QCOMPARE(timeline.rootId_invoicingInfo.value(ship.getId())->getInvoiceNumber().value(), QString("INV-A1"));
+}
+
+void TestOrderManager::test_keysetPager()
+{
+    QTemporaryDir tempDir;
+    OrderManager manager(tempDir.path());
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    auto recordShipment = [&](const QString &orderId, const QDate &date, double amount, const QDate &conflictDate = QDate()) {
+        Shipment shipment = makeShipment(orderId, orderId + "-act", date, amount);
+        manager.recordShipmentFromSource(orderId, &source, &shipment, conflictDate);
+    };
+    // 25 shipments over 5 days, 5 per day so that pages end in the middle of a day
+    for (int i = 0; i < 25; ++i) {
+        recordShipment(QString("ord%1").arg(i, 2, 10, QChar('0')), QDate(2023, 3, 1 + i / 5), 10.0 + i);
+    }
+
+    ShipmentQuery shipmentQuery;
+    auto pager = manager.openShipmentPager(shipmentQuery);
+    pager->setPageSize(10);
+    QList<QVariantList> rows;
+    QList<int> pageSizes;
+    while (!pager->atEnd()) {
+        const auto page = pager->fetchPage();
+        pageSizes << page.size();
+        rows << page;
+        if (pageSizes.size() == 1) {
+            // Rows recorded between two pages are read if they sort after the last row read
+            recordShipment("ord_late", QDate(2023, 4, 1), 99.0);
+        }
+    }
+    QCOMPARE(pageSizes, (QList<int>{10, 10, 6}));
+    QCOMPARE(rows.size(), 26);
+    QSet<QString> ids;
+    for (int i = 0; i < rows.size(); ++i) {
+        QCOMPARE(rows[i].size(), 7); // Without the key columns
+        ids << rows[i][0].toString();
+        QCOMPARE(rows[i][3].toString(), source.toKey());
+        if (i > 0) {
+            QVERIFY(rows[i - 1][4].toString() <= rows[i][4].toString());
+        }
+    }
+    QCOMPARE(ids.size(), 26);
+    QCOMPARE(rows.last()[1].toString(), QString("ord_late"));
+    QVERIFY(pager->fetchPage().isEmpty());
+
+    // Filters of the ShipmentQuery apply to every page
+    shipmentQuery.dateFrom = QDate(2023, 3, 2);
+    shipmentQuery.dateTo = QDate(2023, 3, 3);
+    pager = manager.openShipmentPager(shipmentQuery);
+    pager->setPageSize(3);
+    rows.clear();
+    while (!pager->atEnd()) {
+        rows << pager->fetchPage();
+    }
+    QCOMPARE(rows.size(), 5); // dateTo is the start of the day
+
+    // ActivityUpdate reads the history one page at a time, most recent first
+    recordShipment("ordH", QDate(2023, 5, 1), 100.0);
+    QDate publishUntil(2023, 5, 31);
+    QVERIFY(manager.publish(publishUntil));
+    recordShipment("ordH", QDate(2023, 5, 1), 150.0, QDate(2023, 6, 10));
+    publishUntil = QDate(2023, 6, 30);
+    QVERIFY(manager.publish(publishUntil));
+
+    ActivityUpdate model;
+    auto historyPager = QSharedPointer<KeysetPager>::create(
+                manager._db(),
+                OrderManagerSql::SELECT_FINANCIAL_EVENTS_OF_ROOT_PAGE,
+                OrderManagerSql::FINANCIAL_EVENTS_PAGE_KEYS,
+                QVariantList{"ordH-act", "ordH-act"},
+                KeysetPager::Order::Descending);
+    historyPager->setPageSize(2);
+    model.setPager(historyPager, [](const QVariantList &row) -> ActivityUpdateItem {
+        return {QDateTime::fromString(row[0].toString(), Qt::ISODate), row[1].toString(), row[2].toString(),
+                row[3].toDouble(), row[4].toString(), "Issued"};
+    });
+    QCOMPARE(model.rowCount(), 0);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.rowCount(), 2);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.rowCount(), 3); // Invoice, credit note, new invoice
+    QVERIFY(!model.canFetchMore(QModelIndex()));
+    for (int i = 1; i < model.rowCount(); ++i) {
+        QVERIFY(model.data(model.index(i - 1, 0)).toDateTime() >= model.data(model.index(i, 0)).toDateTime());
+    }
+
+    ActivityUpdate *lazyModel = manager.createActivityUpdateModel("ordH-act");
+    QCOMPARE(lazyModel->rowCount(), 3);
+    QVERIFY(!lazyModel->canFetchMore(QModelIndex()));
+    delete lazyModel;
+}
+
+void TestOrderManager::test_ordersBrowserModel()
+{
+    QTemporaryDir tempDir;
+    auto manager = QSharedPointer<OrderManager>::create(QDir(tempDir.path()));
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    for (int i = 0; i < 30; ++i) {
+        const QString orderId = QString("ord%1").arg(i, 2, 10, QChar('0'));
+        Shipment shipment = makeShipment(orderId, orderId + "-act", QDate(2023, 3, 1 + i % 10), Amount(10.0 + i, 2.0));
+        manager->recordOrder(orderId, "amazon.de");
+        manager->recordShipmentFromSource(orderId, &source, &shipment, QDate());
+    }
+
+    OrdersBrowserModel model(manager);
+    // The first page is read on the worker thread
+    QTRY_VERIFY(!model.isLoading());
+    QCOMPARE(model.rowCount(), 30);
+    QVERIFY(!model.canFetchMore(QModelIndex()));
+    QCOMPARE(model.columnCount(), int(OrdersBrowserModel::ColumnCount));
+    for (int i = 1; i < model.rowCount(); ++i) {
+        QVERIFY(model.getRow(i - 1).eventDate <= model.getRow(i).eventDate);
+    }
+    QCOMPARE(model.getRow(0).store, QString("amazon.de"));
+    QCOMPARE(model.getRow(0).source, source);
+    QCOMPARE(model.data(model.index(0, OrdersBrowserModel::ColumnSource)).toString(), QString("Amazon Amazon EU"));
+
+    auto fetchAll = [&model]() {
+        QTRY_VERIFY(!model.isLoading());
+        while (model.canFetchMore(QModelIndex())) {
+            model.fetchMore(QModelIndex());
+            QTRY_VERIFY(!model.isLoading());
+        }
+    };
+
+    // Sorting starts again from the first page
+    model.setPageSize(10);
+    model.sort(OrdersBrowserModel::ColumnOrder, Qt::DescendingOrder);
+    QVERIFY(model.isLoading());
+    QTRY_VERIFY(!model.isLoading());
+    QCOMPARE(model.rowCount(), 10);
+    QCOMPARE(model.getRow(0).orderId, QString("ord29"));
+    QVERIFY(model.canFetchMore(QModelIndex()));
+    fetchAll();
+    QCOMPARE(model.rowCount(), 30);
+    QCOMPARE(model.getRow(29).orderId, QString("ord00"));
+
+    // No index to read the stores in order, the sort is kept
+    model.sort(OrdersBrowserModel::ColumnStore, Qt::AscendingOrder);
+    QVERIFY(!model.isLoading());
+    QCOMPARE(model.getRow(0).orderId, QString("ord29"));
+
+    // Typing is debounced: only the last filter is read, once typing pauses
+    model.setOrderIdFilter("ord1");
+    model.setOrderIdFilter("ord2");
+    QVERIFY(!model.isLoading());
+    QCOMPARE(model.rowCount(), 30);
+    QTRY_COMPARE(model.getShipmentQuery().orderIdPrefix, QString("ord2"));
+    fetchAll();
+    QCOMPARE(model.rowCount(), 10);
+    for (int i = 0; i < model.rowCount(); ++i) {
+        QVERIFY(model.getRow(i).orderId.startsWith("ord2"));
+    }
+
+    // Structured filters keep the order id filter
+    ShipmentQuery shipmentQuery;
+    shipmentQuery.dateFrom = QDate(2023, 3, 1);
+    shipmentQuery.dateTo = QDate(2023, 3, 5);
+    model.setShipmentQuery(shipmentQuery);
+    fetchAll();
+    QCOMPARE(model.getShipmentQuery().orderIdPrefix, QString("ord2"));
+    QCOMPARE(model.rowCount(), 4); // ord20 to ord23, dateTo being the start of the day
+}
+
+void TestOrderManager::test_shipmentPagerWithoutSource()
+{
+    QTemporaryDir tempDir;
+    ActivitySource source{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+    auto readSortedBySource = [](const OrderManager &manager) {
+        auto pager = manager.openShipmentPager(ShipmentQuery(), OrderManager::ShipmentSort::Source);
+        pager->setPageSize(10);
+        QList<QVariantList> rows;
+        while (!pager->atEnd()) {
+            rows << pager->fetchPage();
+        }
+        return rows;
+    };
+    {
+        OrderManager manager(tempDir.path());
+        // More rows without source than a page, so that pages end on them
+        for (int i = 0; i < 25; ++i) {
+            const QString orderId = QString("ord%1").arg(i, 2, 10, QChar('0'));
+            const Shipment shipment = makeShipment(orderId, orderId + "-act", QDate(2023, 3, 1 + i % 5), 10.0 + i);
+            manager.recordShipmentFromSource(orderId, i < 20 ? nullptr : &source, &shipment, QDate());
+        }
+        const QList<QVariantList> rows = readSortedBySource(manager);
+        QCOMPARE(rows.size(), 25);
+        QCOMPARE(rows.first()[3].toString(), QString());
+        QCOMPARE(rows.last()[3].toString(), source.toKey());
+
+        // Rows recorded without source before migration 12
+        QSqlQuery q(manager.m_db);
+        QVERIFY(q.exec("UPDATE shipments SET source_key = NULL WHERE source_key = ''"));
+        QVERIFY(q.exec(QString("PRAGMA user_version = %1").arg(OrderManagerSql::SCHEMA_VERSION - 1)));
+    }
+    OrderManager manager(tempDir.path());
+    QSqlQuery q(manager.m_db);
+    QVERIFY(q.exec("SELECT COUNT(*) FROM shipments WHERE source_key IS NULL"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 0);
+    QCOMPARE(readSortedBySource(manager).size(), 25);
+}
+
 QTEST_MAIN(TestOrderManager)
 #include "test_order_manager.moc"
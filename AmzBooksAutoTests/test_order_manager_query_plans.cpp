@@ -0,0 +1,187 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include "orders/OrderManager.h"
+#include "orders/OrderManager_sql_schema.h"
+#include "orders/ShipmentQuery.h"
+
+// Runs EXPLAIN QUERY PLAN on every statement of OrderManager and fails if one of them
+// falls back to a full table scan, so that a schema or query change can't silently drop an index.
+
+class TestOrderManagerQueryPlans : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_schemaVersion();
+    void test_noFullTableScan_data();
+    void test_noFullTableScan();
+    void test_keysetPagesInIndexOrder_data();
+    void test_keysetPagesInIndexOrder();
+
+private:
+    QTemporaryDir m_tempDir;
+    QSharedPointer<OrderManager> m_manager;
+    QSqlDatabase m_db;
+};
+
+static const QString CONNECTION_NAME = "TestOrderManagerQueryPlans";
+
+void TestOrderManagerQueryPlans::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    // Creates Orders.db and applies all migrations
+    m_manager = QSharedPointer<OrderManager>::create(QDir(m_tempDir.path()));
+
+    m_db = QSqlDatabase::addDatabase("QSQLITE", CONNECTION_NAME);
+    m_db.setDatabaseName(QDir(m_tempDir.path()).absoluteFilePath("Orders.db"));
+    QVERIFY2(m_db.open(), qPrintable(m_db.lastError().text()));
+
+    // Connection-local tables of the publish and archiving statements
+    QSqlQuery query(m_db);
+    for (const QString &sql : OrderManagerSql::CREATE_PUBLISH_BATCH + OrderManagerSql::CREATE_ARCHIVE_BATCH) {
+        QVERIFY2(query.exec(sql), qPrintable(query.lastError().text()));
+    }
+}
+
+void TestOrderManagerQueryPlans::cleanupTestCase()
+{
+    m_db.close();
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(CONNECTION_NAME);
+    m_manager.reset();
+}
+
+void TestOrderManagerQueryPlans::test_schemaVersion()
+{
+    QSqlQuery query(m_db);
+    QVERIFY(query.exec("PRAGMA user_version"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), OrderManagerSql::SCHEMA_VERSION);
+}
+
+void TestOrderManagerQueryPlans::test_noFullTableScan_data()
+{
+    QTest::addColumn<QString>("sql");
+    for (const QString &sql : OrderManagerSql::ALL_QUERIES) {
+        QTest::newRow(qPrintable(sql.simplified().left(80))) << sql;
+    }
+    // Copies to an attached partition, checked on main
+    for (const QString &sql : OrderManagerSql::COPY_ARCHIVE_BATCH) {
+        QTest::newRow(qPrintable(sql.simplified().left(80))) << sql.arg("main");
+    }
+
+    // Period queries compiled from ShipmentQuery filters
+    auto addShipmentQuery = [](const char *name, const ShipmentQuery &shipmentQuery) {
+        QVariantList bindValues;
+        QTest::newRow(name) << OrderManagerSql::SELECT_SHIPMENTS_QUERY.arg(shipmentQuery.toWhereClause(bindValues));
+    };
+    ShipmentQuery shipmentQuery;
+    addShipmentQuery("ShipmentQuery period", shipmentQuery);
+    shipmentQuery.sources = {ActivitySource{ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"},
+                             ActivitySource{ActivitySourceType::API, "Temu", "Temu EU", "Orders"}};
+    addShipmentQuery("ShipmentQuery sources", shipmentQuery);
+    shipmentQuery = ShipmentQuery();
+    shipmentQuery.channels = {"Amazon"};
+    shipmentQuery.stores = {"amazon.de"};
+    addShipmentQuery("ShipmentQuery channels stores", shipmentQuery);
+    shipmentQuery = ShipmentQuery();
+    shipmentQuery.statuses = {"Draft"};
+    shipmentQuery.revisionKinds = {RevisionKind::Reversal, RevisionKind::NewVersion};
+    addShipmentQuery("ShipmentQuery status revision kinds", shipmentQuery);
+    shipmentQuery = ShipmentQuery();
+    shipmentQuery.taxSchemes = {TaxScheme::EuOssUnion};
+    shipmentQuery.countryCodesFrom = {"FR"};
+    shipmentQuery.countryCodesTo = {"DE", "IT"};
+    addShipmentQuery("ShipmentQuery activities", shipmentQuery);
+}
+
+void TestOrderManagerQueryPlans::test_noFullTableScan()
+{
+    QFETCH(QString, sql);
+
+    QSqlQuery query(m_db);
+    QVERIFY2(query.prepare("EXPLAIN QUERY PLAN " + sql), qPrintable(query.lastError().text()));
+    const int nParams = sql.count('?');
+    for (int i = 0; i < nParams; ++i) {
+        query.addBindValue(QString());
+    }
+    QVERIFY2(query.exec(), qPrintable(query.lastError().text()));
+
+    while (query.next()) {
+        const QString detail = query.value("detail").toString();
+        // "SCAN <table>" (or "SCAN TABLE <table>" in older SQLite) is a full scan, even with a covering index.
+        // Scans of subqueries / co-routines and constant rows are fine, as well as the scan of the connection-local
+        // archive_batch, which lists the rows being archived.
+        const bool isFullScan = detail.startsWith("SCAN ")
+                && !detail.startsWith("SCAN (")
+                && !detail.startsWith("SCAN SUBQUERY")
+                && !detail.startsWith("SCAN CONSTANT ROW")
+                && !detail.startsWith("SCAN archive_batch");
+        QVERIFY2(!isFullScan, qPrintable(QString("Full table scan: %1\n%2").arg(detail, sql)));
+    }
+}
+
+void TestOrderManagerQueryPlans::test_keysetPagesInIndexOrder_data()
+{
+    QTest::addColumn<QString>("sql");
+    // Pages of OrderManager::openShipmentPager() for each sort, first and next ones, both ways
+    const QList<QPair<QString, QStringList>> sorts{
+        {"event date", OrderManagerSql::SHIPMENTS_PAGE_KEYS_EVENT_DATE},
+        {"order id", OrderManagerSql::SHIPMENTS_PAGE_KEYS_ORDER_ID},
+        {"id", OrderManagerSql::SHIPMENTS_PAGE_KEYS_ID},
+        {"source", OrderManagerSql::SHIPMENTS_PAGE_KEYS_SOURCE},
+        {"status", OrderManagerSql::SHIPMENTS_PAGE_KEYS_STATUS}};
+    for (const auto &[name, keyColumns] : sorts) {
+        QVariantList bindValues;
+        const QString where = ShipmentQuery().toWhereClause(bindValues, "main", keyColumns == OrderManagerSql::SHIPMENTS_PAGE_KEYS_EVENT_DATE);
+        for (const bool descending : {false, true}) {
+            QStringList orderBy;
+            QStringList placeholders;
+            for (const auto &column : keyColumns) {
+                orderBy << (descending ? column + " DESC" : column);
+                placeholders << "?";
+            }
+            const QString keyCondition = QString(" AND (%1) %2 (%3)").arg(
+                        keyColumns.join(", "), QString(descending ? "<" : ">"), placeholders.join(", "));
+            for (const QString &condition : {QString(), keyCondition}) {
+                const QString rowName = QString("%1 %2 %3").arg(
+                            name,
+                            QString(descending ? "descending" : "ascending"),
+                            QString(condition.isEmpty() ? "first" : "next"));
+                QTest::newRow(qPrintable(rowName)) << OrderManagerSql::SELECT_SHIPMENTS_PAGE.arg(
+                                                          keyColumns.join(", "), where, orderBy.join(", "), condition);
+            }
+        }
+    }
+}
+
+void TestOrderManagerQueryPlans::test_keysetPagesInIndexOrder()
+{
+    QFETCH(QString, sql);
+
+    QSqlQuery query(m_db);
+    QVERIFY2(query.prepare("EXPLAIN QUERY PLAN " + sql), qPrintable(query.lastError().text()));
+    const int nParams = sql.count('?');
+    for (int i = 0; i < nParams; ++i) {
+        query.addBindValue(QString());
+    }
+    QVERIFY2(query.exec(), qPrintable(query.lastError().text()));
+
+    while (query.next()) {
+        const QString detail = query.value("detail").toString();
+        // The rows must come in index order: a page stops after LIMIT rows instead of sorting the whole table.
+        // Walking an index in order (SCAN ... USING INDEX) is fine here for the same reason
+        QVERIFY2(!detail.contains("TEMP B-TREE"), qPrintable(QString("Sorted page: %1\n%2").arg(detail, sql)));
+        QVERIFY2(!detail.startsWith("SCAN s") || detail.contains("USING"),
+                 qPrintable(QString("Full table scan: %1\n%2").arg(detail, sql)));
+    }
+}
+
+QTEST_MAIN(TestOrderManagerQueryPlans)
+#include "test_order_manager_query_plans.moc"
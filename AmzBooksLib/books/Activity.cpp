@@ -1,5 +1,8 @@
 #include "Activity.h"
 
+#include <QDataStream>
+#include <QTimeZone>
+
 Result<Activity> Activity::create(QString eventId,
                                   QString activityId,
                                   QString subActivityId,
@@ -77,6 +80,24 @@ bool Activity::isDifferentTaxes(const Activity &other) const
             || m_vatTerritoryTo != other.m_vatTerritoryTo;
 }
 
+void Activity::addTaxFieldsToHash(QCryptographicHash &hash) const
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream << getAmountTaxes() + 0.0 // -0.0 == 0.0 for isDifferentTaxes
+           << m_currency
+           << m_dateTime.date()
+           << m_countryCodeFrom
+           << m_countryCodeTo
+           << m_countryCodeVatPaidTo
+           << m_taxDeclaringCountryCode
+           << static_cast<int>(m_taxScheme)
+           << static_cast<int>(m_saleType)
+           << m_vatTerritoryFrom
+           << m_vatTerritoryTo;
+    hash.addData(bytes);
+}
+
 Activity::Activity(QString eventId,
                    QString activityId,
                    QString subActivityId,
@@ -114,6 +135,14 @@ Activity::Activity(QString eventId,
 {
 }
 
+Activity Activity::negated() const
+{
+    Activity activity(*this);
+    activity.m_amountSource = Amount(-m_amountSource.getAmountTaxed(), -m_amountSource.getTaxes());
+    activity.m_AmountTaxesComputed = -m_AmountTaxesComputed;
+    return activity;
+}
+
 void Activity::setTaxes(double taxes)
 {
     if (m_taxSource == TaxSource::MarketplaceProvided)
@@ -301,3 +330,58 @@ Activity Activity::fromJson(const QJsonObject &json)
         json["taxesComputed"].toDouble()
     );
 }
+
+QCborArray Activity::toCbor() const
+{
+    // Local times (as parsed from offset-less ISO strings) have no offset, the others keep theirs
+    const QCborValue utcOffset = m_dateTime.timeSpec() == Qt::LocalTime
+            ? QCborValue() : QCborValue(m_dateTime.offsetFromUtc());
+    return QCborArray{
+        m_eventId,
+        m_activityId,
+        m_subActivityId,
+        m_dateTime.toMSecsSinceEpoch(),
+        utcOffset,
+        m_currency,
+        m_countryCodeFrom,
+        m_countryCodeTo,
+        m_countryCodeVatPaidTo,
+        m_amountSource.getAmountTaxed(),
+        m_amountSource.getTaxes(),
+        static_cast<int>(m_taxSource),
+        m_taxDeclaringCountryCode,
+        static_cast<int>(m_taxScheme),
+        static_cast<int>(m_taxJurisdictionLevel),
+        static_cast<int>(m_saleType),
+        m_vatTerritoryFrom,
+        m_vatTerritoryTo,
+        m_AmountTaxesComputed
+    };
+}
+
+Activity Activity::fromCbor(const QCborArray &cbor)
+{
+    const qint64 msecs = cbor[3].toInteger();
+    const QDateTime dateTime = cbor[4].isInteger()
+            ? QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::fromSecondsAheadOfUtc(int(cbor[4].toInteger())))
+            : QDateTime::fromMSecsSinceEpoch(msecs);
+    return Activity(
+        cbor[0].toString(),
+        cbor[1].toString(),
+        cbor[2].toString(),
+        dateTime,
+        cbor[5].toString(),
+        cbor[6].toString(),
+        cbor[7].toString(),
+        cbor[8].toString(),
+        Amount(cbor[9].toDouble(), cbor[10].toDouble()),
+        static_cast<TaxSource>(cbor[11].toInteger()),
+        cbor[12].toString(),
+        static_cast<TaxScheme>(cbor[13].toInteger()),
+        static_cast<TaxJurisdictionLevel>(cbor[14].toInteger()),
+        static_cast<SaleType>(cbor[15].toInteger()),
+        cbor[16].toString(),
+        cbor[17].toString(),
+        cbor[18].toDouble()
+    );
+}
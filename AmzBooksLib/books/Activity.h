@@ -8,6 +8,8 @@
 #include <QDateTime>
 
 #include <QJsonObject>
+#include <QCborArray>
+#include <QCryptographicHash>
 #include "orders/Amount.h"
 
 #include "TaxJurisdictionLevel.h"
@@ -38,11 +40,19 @@ public:
 
     static Activity fromJson(const QJsonObject &json);
     QJsonObject toJson() const;
+    // Positional encoding of toJson() fields, used by Shipment::toCbor()
+    static Activity fromCbor(const QCborArray &cbor);
+    QCborArray toCbor() const;
 
     bool isDifferentTaxes(const Activity &other) const;
+    // Feeds the fields compared by isDifferentTaxes, so that equal hashes mean no tax difference
+    void addTaxFieldsToHash(QCryptographicHash &hash) const;
 
     void setTaxes(double taxes);
 
+    // Same activity with opposite amounts (source and computed taxes), used for reversals
+    Activity negated() const;
+
     const QString& getEventId() const noexcept;
     const QString& getActivityId() const noexcept;
     const QString& getSubActivityId() const noexcept;
@@ -6,6 +6,9 @@
 #include "JournalTable.h"
 #include "orders/ActivitySource.h"
 #include "orders/Shipment.h"
+#include "orders/ShipmentCursor.h"
+#include "orders/PeriodAggregate.h"
+#include "orders/OrderManager.h"
 #include "books/Activity.h"
 
 JournalEntryFactory::JournalEntryFactory(
@@ -159,6 +162,40 @@ QSharedPointer<JournalEntry> JournalEntryFactory::createEntry(PurchaseInformatio
     return entry;
 }
 
+void JournalEntryFactory::SaleTotals::add(const Shipment &shipmentOrRefund)
+{
+    for (const Activity &activity : shipmentOrRefund.getActivities()) {
+        VatKey key;
+        key.scheme = activity.getTaxScheme();
+        key.countryFrom = activity.getCountryCodeFrom();
+        key.countryTo = activity.getCountryCodeTo();
+        key.vatRate = activity.getVatRate() * 100.0;
+        key.currency = activity.getCurrency();
+
+        double amountUntaxed = activity.getAmountUntaxed();
+        double amountTaxes = activity.getAmountTaxes();
+        double amountTotal = activity.getAmountTaxed();
+
+        revenueByVat[key] += amountUntaxed;
+        vatByVat[key] += amountTaxes;
+        totalByCurrency[key.currency] += amountTotal;
+    }
+}
+
+void JournalEntryFactory::SaleTotals::add(const PeriodAggregate &aggregate)
+{
+    VatKey key;
+    key.scheme = aggregate.taxScheme;
+    key.countryFrom = aggregate.countryCodeFrom;
+    key.countryTo = aggregate.countryCodeTo;
+    key.vatRate = aggregate.vatRate * 100.0;
+    key.currency = aggregate.currency;
+
+    revenueByVat[key] += aggregate.amountTaxed - aggregate.amountTaxes;
+    vatByVat[key] += aggregate.amountTaxes;
+    totalByCurrency[key.currency] += aggregate.amountTaxed;
+}
+
 QCoro::Task<QSharedPointer<JournalEntry>> JournalEntryFactory::createEntry(
     ActivitySource *source,
     const QMultiMap<QDateTime, QSharedPointer<Shipment>> &shipmentAndRefunds,
@@ -167,60 +204,101 @@ QCoro::Task<QSharedPointer<JournalEntry>> JournalEntryFactory::createEntry(
     if (shipmentAndRefunds.isEmpty()) {
         co_return nullptr;
     }
-    
+
+    SaleTotals totals;
+    for (auto it = shipmentAndRefunds.constBegin(); it != shipmentAndRefunds.constEnd(); ++it) {
+        totals.add(*it.value());
+    }
+    co_return co_await _createSaleEntry(source, shipmentAndRefunds.firstKey().date(), totals, callbackAddIfMissing);
+}
+
+QCoro::Task<QSharedPointer<JournalEntry>> JournalEntryFactory::createEntry(
+    ActivitySource *source,
+    ShipmentCursor &cursor,
+    std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing)
+{
+    SaleTotals totals;
+    QDate entryDate;
+    while (cursor.next()) {
+        if (!entryDate.isValid()) {
+            entryDate = cursor.getDateTime().date(); // Rows come in event date order
+        }
+        totals.add(cursor.getShipment());
+    }
+    if (!entryDate.isValid()) {
+        co_return nullptr;
+    }
+    co_return co_await _createSaleEntry(source, entryDate, totals, callbackAddIfMissing);
+}
+
+QCoro::Task<QSharedPointer<JournalEntry>> JournalEntryFactory::createEntry(
+    ActivitySource *source,
+    const QList<PeriodAggregate> &aggregates,
+    std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing)
+{
+    SaleTotals totals;
+    QDate entryDate;
+    for (const PeriodAggregate &aggregate : aggregates) {
+        if (!entryDate.isValid() || aggregate.month < entryDate) {
+            entryDate = aggregate.month;
+        }
+        totals.add(aggregate);
+    }
+    if (!entryDate.isValid()) {
+        co_return nullptr;
+    }
+    co_return co_await _createSaleEntry(source, entryDate, totals, callbackAddIfMissing);
+}
+
+QCoro::Task<int> JournalEntryFactory::regenerateDirtyJournalEntries(
+    OrderManager *orderManager,
+    std::function<bool(const ActivitySource &source, const QDate &month, QSharedPointer<JournalEntry> entry)> callbackEntry,
+    std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing)
+{
+    // Dirty periods are per store, entries per source and month
+    QHash<ActivitySource, QMap<QDate, QList<OrderManager::DirtyPeriod>>> source_month_dirtyPeriods;
+    const QList<OrderManager::DirtyPeriod> dirtyPeriods = orderManager->getDirtyPeriods();
+    for (const auto &dirtyPeriod : dirtyPeriods) {
+        source_month_dirtyPeriods[dirtyPeriod.source][dirtyPeriod.month] << dirtyPeriod;
+    }
+
+    int regenerated = 0;
+    for (auto itSource = source_month_dirtyPeriods.cbegin(); itSource != source_month_dirtyPeriods.cend(); ++itSource) {
+        ActivitySource source = itSource.key();
+        for (auto itMonth = itSource.value().cbegin(); itMonth != itSource.value().cend(); ++itMonth) {
+            const QDate month = itMonth.key();
+            const QList<PeriodAggregate> aggregates = orderManager->getPeriodAggregates(month, month, &source);
+            QSharedPointer<JournalEntry> entry = co_await createEntry(&source, aggregates, callbackAddIfMissing);
+            if (callbackEntry(source, month, entry)) {
+                for (const auto &dirtyPeriod : itMonth.value()) {
+                    orderManager->markPeriodClean(dirtyPeriod);
+                }
+                ++regenerated;
+            }
+        }
+    }
+    co_return regenerated;
+}
+
+QCoro::Task<QSharedPointer<JournalEntry>> JournalEntryFactory::_createSaleEntry(
+    ActivitySource *source,
+    QDate entryDate,
+    SaleTotals totals,
+    std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing)
+{
     QString companyCurrency = m_companyInfos->getCurrency();
     QString companyCountry = m_companyInfos->getCompanyCountryCode();
-    QDate entryDate = shipmentAndRefunds.firstKey().date();
-    
+
     auto entry = QSharedPointer<JournalEntry>::create(entryDate, companyCurrency);
-    
+
     // Get journal code for this activity source
     QString journalCode = m_journalTable->getJournal(source);
     QString customerAccount = m_journalTable->getCustomerAccount(source);
-    
-    // Aggregate all activities by TaxScheme, Country Routes, VAT rate and Currency
-    struct VatKey {
-        TaxScheme scheme;
-        QString countryFrom;
-        QString countryTo;
-        double vatRate;
-        QString currency;
-        
-        bool operator<(const VatKey &other) const {
-            if (scheme != other.scheme) return scheme < other.scheme;
-            if (countryFrom != other.countryFrom) return countryFrom < other.countryFrom;
-            if (countryTo != other.countryTo) return countryTo < other.countryTo;
-            if (qAbs(vatRate - other.vatRate) > 0.001) return vatRate < other.vatRate;
-            return currency < other.currency;
-        }
-    };
-    
-    QMap<VatKey, double> revenueByVat;
-    QMap<VatKey, double> vatByVat;
-    QMap<QString, double> totalByCurrency;
-    
-    // Process all shipments
-    for (const auto &shipment : shipmentAndRefunds.values()) {
-        const QList<Activity> &activities = shipment->getActivities();
-        
-        for (const Activity &activity : activities) {
-            VatKey key;
-            key.scheme = activity.getTaxScheme();
-            key.countryFrom = activity.getCountryCodeFrom();
-            key.countryTo = activity.getCountryCodeTo();
-            key.vatRate = activity.getVatRate() * 100.0;
-            key.currency = activity.getCurrency();
-            
-            double amountUntaxed = activity.getAmountUntaxed();
-            double amountTaxes = activity.getAmountTaxes();
-            double amountTotal = activity.getAmountTaxed();
-            
-            revenueByVat[key] += amountUntaxed;
-            vatByVat[key] += amountTaxes;
-            totalByCurrency[key.currency] += amountTotal;
-        }
-    }
-    
+
+    const QMap<VatKey, double> &revenueByVat = totals.revenueByVat;
+    const QMap<VatKey, double> &vatByVat = totals.vatByVat;
+    const QMap<QString, double> &totalByCurrency = totals.totalByCurrency;
+
     // Common title for all lines in this entry
     // "Vente <Channel> <Subchannel> - <JournalCode>"
     QString commonTitle = QString("Vente %1 %2 - %3")
@@ -233,7 +311,7 @@ QCoro::Task<QSharedPointer<JournalEntry>> JournalEntryFactory::createEntry(
     for (auto it = revenueByVat.constBegin(); it != revenueByVat.constEnd(); ++it) {
         const VatKey &key = it.key();
         double revenueAmount = it.value();
-        double vatAmount = vatByVat[key];
+        double vatAmount = vatByVat.value(key);
         
         // Resolve Accounts
         VatCountries vc = m_saleBookAccounts->resolveVatCountries(
@@ -4,7 +4,9 @@
 #include <QSharedPointer>
 #include <QMultiMap>
 #include <QDateTime>
+#include <QMap>
 #include "JournalEntry.h"
+#include "TaxScheme.h"
 #include "PurchaseInvoiceManager.h"
 #include <QCoroTask>
 #include <functional>
@@ -16,6 +18,9 @@ class PurchaseBookAccountsTable;
 class JournalTable;
 class ActivitySource;
 class Shipment;
+class ShipmentCursor;
+struct PeriodAggregate;
+class OrderManager;
 
 class JournalEntryFactory
 {
@@ -38,7 +43,55 @@ public:
                                              const QMultiMap<QDateTime, QSharedPointer<Shipment>> &shipmentAndRefunds,
                                              std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing = nullptr);
 
+    // Same entry aggregated in one pass over a cursor (see OrderManager::openShipmentCursor, opened for this source),
+    // so that memory doesn't grow with the period. The cursor must stay alive until the task completes.
+    QCoro::Task<QSharedPointer<JournalEntry>> createEntry(ActivitySource *source,
+                                             ShipmentCursor &cursor,
+                                             std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing = nullptr);
+
+    // Same entry from the published period aggregates of this source (see OrderManager::getPeriodAggregates),
+    // without reading the activities. The entry is dated on the first day of the earliest month.
+    QCoro::Task<QSharedPointer<JournalEntry>> createEntry(ActivitySource *source,
+                                             const QList<PeriodAggregate> &aggregates,
+                                             std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing = nullptr);
+
+    // Regenerates the monthly sale entries of the periods invalidated since they were last generated
+    // (OrderManager::getDirtyPeriods), one per source and month whatever the store, from the period aggregates.
+    // callbackEntry stores an entry (null if nothing is left in the month) and returns true to mark its periods clean.
+    // Returns the number of entries regenerated
+    QCoro::Task<int> regenerateDirtyJournalEntries(OrderManager *orderManager,
+                                                   std::function<bool(const ActivitySource &source, const QDate &month, QSharedPointer<JournalEntry> entry)> callbackEntry,
+                                                   std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing = nullptr);
+
 private:
+    // Aggregation key of sale activities: TaxScheme, Country Routes, VAT rate and Currency
+    struct VatKey {
+        TaxScheme scheme;
+        QString countryFrom;
+        QString countryTo;
+        double vatRate;
+        QString currency;
+
+        bool operator<(const VatKey &other) const {
+            if (scheme != other.scheme) return scheme < other.scheme;
+            if (countryFrom != other.countryFrom) return countryFrom < other.countryFrom;
+            if (countryTo != other.countryTo) return countryTo < other.countryTo;
+            if (qAbs(vatRate - other.vatRate) > 0.001) return vatRate < other.vatRate;
+            return currency < other.currency;
+        }
+    };
+    struct SaleTotals {
+        QMap<VatKey, double> revenueByVat;
+        QMap<VatKey, double> vatByVat;
+        QMap<QString, double> totalByCurrency;
+        void add(const Shipment &shipmentOrRefund);
+        void add(const PeriodAggregate &aggregate);
+    };
+    QCoro::Task<QSharedPointer<JournalEntry>> _createSaleEntry(ActivitySource *source,
+                                                  QDate entryDate,
+                                                  SaleTotals totals,
+                                                  std::function<QCoro::Task<bool>(const QString &errorTitle, const QString &errorText)> callbackAddIfMissing);
+
     const CurrencyRateManager *m_currencyRateManager;
     const CompanyInfosTable *m_companyInfos;
     const SaleBookAccountsTable *m_saleBookAccounts;
@@ -1,6 +1,10 @@
 #include "AbstractImporterFile.h"
+#include "ContentHash.h"
+#include <QCoroFuture>
 #include <QFileInfo>
+#include <QDebug>
 #include <QDir>
+#include <QtConcurrent>
 #include <algorithm>
 
 // Helper to find min year from OrderInfos and update date range
@@ -44,68 +48,268 @@ QPair<QDateTime, QDateTime> AbstractImporterFile::datesFromTo() const
 
 QCoro::Task<AbstractImporter::ReturnOrderInfos> AbstractImporterFile::loadReport(const QString &filePath)
 {
-    QString uniqueId = getUniqueReportId(filePath);
+    _importedRowIndex().clearPending();
+    m_reportIdentity = ReportIdentity();
+    ReturnOrderInfos result = co_await _loadReport(filePath);
+    if (!result.errorReturned.isEmpty() || !result.orderInfos) {
+        _importedRowIndex().clearPending();
+        co_return result;
+    }
+
+    co_await _finishReportIdentity(filePath);
+    const QString duplicateError = _duplicateError();
+    if (!duplicateError.isEmpty()) {
+        _importedRowIndex().clearPending(); // Nothing for commitImportedRows()
+        co_return ReturnOrderInfos{nullptr, duplicateError};
+    }
+
+    // Update date range in OrderInfos
+    int year = getMinYear(*result.orderInfos);
+    if (year == 0) year = QDate::currentDate().year();
     
-    // Check if duplicate
-    auto s = _settings();
-    QStringList importedIds = s->value("Reports/ImportedIds").toStringList();
-    if (importedIds.contains(uniqueId)) {
-        co_return ReturnOrderInfos{nullptr, QString("Report already imported (ID: %1)").arg(uniqueId)};
+    bool hasOrders = !result.orderInfos->shipments.isEmpty() || !result.orderInfos->refunds.isEmpty();
+    const QString recordError = _recordImport(filePath, year, hasOrders, result.orderInfos->dateMin, result.orderInfos->dateMax);
+    if (!recordError.isEmpty()) {
+        _importedRowIndex().clearPending();
+        co_return ReturnOrderInfos{nullptr, recordError};
     }
     
+    co_return result;
+}
+
+QCoro::Task<AbstractImporter::ReturnOrderInfos> AbstractImporterFile::loadReportStreamed(
+        const QString &filePath, std::function<void(OrderInfos &&)> orderInfosCallback)
+{
+    // The activities are not kept, so the dates are collected from the batches as they go
+    _importedRowIndex().clearPending();
+    m_reportIdentity = ReportIdentity();
+    bool hasOrders = false;
+    QDate dateMin;
+    QDate dateMax;
+    QList<OrderInfos> heldBatches;
+    ReturnOrderInfos result = co_await _loadReportStreamed(
+                filePath, [&](OrderInfos &&orderInfos) {
+        if (!orderInfos.shipments.isEmpty() || !orderInfos.refunds.isEmpty()) {
+            hasOrders = true;
+            getMinYear(orderInfos);
+            if (orderInfos.dateMin.isValid() && (!dateMin.isValid() || orderInfos.dateMin < dateMin)) {
+                dateMin = orderInfos.dateMin;
+            }
+            if (orderInfos.dateMax.isValid() && (!dateMax.isValid() || orderInfos.dateMax > dateMax)) {
+                dateMax = orderInfos.dateMax;
+            }
+        }
+        // Recording the orders is a side effect: nothing is passed before the report is known to be new
+        if (m_reportIdentity.headImported) {
+            heldBatches << std::move(orderInfos);
+        } else {
+            orderInfosCallback(std::move(orderInfos));
+        }
+    });
+    if (!result.errorReturned.isEmpty() || !result.orderInfos) {
+        _importedRowIndex().clearPending();
+        co_return result;
+    }
+
+    co_await _finishReportIdentity(filePath);
+    const QString duplicateError = _duplicateError();
+    if (!duplicateError.isEmpty()) {
+        _importedRowIndex().clearPending(); // Nothing for commitImportedRows()
+        co_return ReturnOrderInfos{nullptr, duplicateError};
+    }
+
+    if (dateMin.isValid()) {
+        result.orderInfos->dateMin = dateMin;
+        result.orderInfos->dateMax = dateMax;
+    }
+    int year = dateMin.isValid() ? dateMin.year() : QDate::currentDate().year();
+    const QString recordError = _recordImport(filePath, year, hasOrders, result.orderInfos->dateMin, result.orderInfos->dateMax);
+    if (!recordError.isEmpty()) {
+        _importedRowIndex().clearPending();
+        co_return ReturnOrderInfos{nullptr, recordError};
+    }
+    for (auto &batch : heldBatches) {
+        orderInfosCallback(std::move(batch));
+    }
+
+    co_return result;
+}
+
+QCoro::Task<AbstractImporter::ReturnOrderInfos> AbstractImporterFile::_loadReportStreamed(
+        const QString &filePath, std::function<void(OrderInfos &&)> orderInfosCallback)
+{
     ReturnOrderInfos result = co_await _loadReport(filePath);
-    
     if (result.errorReturned.isEmpty() && result.orderInfos) {
-        // Update date range in OrderInfos
-        int year = getMinYear(*result.orderInfos);
-        if (year == 0) year = QDate::currentDate().year();
-        
-        QDir reportDir = m_workingDirectory;
-        if (!reportDir.exists("reports")) reportDir.mkdir("reports");
-        reportDir.cd("reports");
-        
-        QString labelSafe = getLabel().simplified().replace(" ", "_"); // Basic sanitization
-        if (!reportDir.exists(labelSafe)) reportDir.mkdir(labelSafe);
-        reportDir.cd(labelSafe);
-        
-        QString yearStr = QString::number(year);
-        if (!reportDir.exists(yearStr)) reportDir.mkdir(yearStr);
-        reportDir.cd(yearStr);
-        
-        QString targetPath = reportDir.absoluteFilePath(QFileInfo(filePath).fileName());
-        
-        // If file exists, maybe duplicate content but distinct ID? 
-        // Or same ID but file re-uploaded? 
-        // Logic says uniqueId is new, so we proceed. If name conflict, we might overwrite or rename.
-        // Requirement: "Save the file in working dir / reports / label / minyear"
-        // I will overwrite for now or ensure uniqueness if needed, but user didn't specify.
-        // Ideally checking if targetPath exists and appending counter would be safer, 
-        // but let's stick to simple copy request.
-        
-        QFile::copy(filePath, targetPath);
-        
-        // Update settings
-        importedIds.append(uniqueId);
-        s->setValue("Reports/ImportedIds", importedIds);
-        
-        // Update dates using the calculated dateMin/dateMax
-        bool hasOrders = !result.orderInfos->shipments.isEmpty() || !result.orderInfos->refunds.isEmpty();
-        
-        if (hasOrders && result.orderInfos->dateMin.isValid() && result.orderInfos->dateMax.isValid()) {
-             QDateTime minDate = result.orderInfos->dateMin.startOfDay();
-             QDateTime maxDate = result.orderInfos->dateMax.startOfDay();
-             
-             QDateTime currentFrom = s->value("Reports/ImportedFrom").toDateTime();
-             if (!currentFrom.isValid() || minDate < currentFrom) {
-                 s->setValue("Reports/ImportedFrom", minDate);
-             }
-             
-             QDateTime currentTo = s->value("Reports/ImportedTo").toDateTime();
-             if (!currentTo.isValid() || maxDate > currentTo) {
-                 s->setValue("Reports/ImportedTo", maxDate);
-             }
+        const QDate dateMin = result.orderInfos->dateMin;
+        const QDate dateMax = result.orderInfos->dateMax;
+        orderInfosCallback(std::move(*result.orderInfos));
+        result.orderInfos = QSharedPointer<OrderInfos>::create();
+        result.orderInfos->dateMin = dateMin;
+        result.orderInfos->dateMax = dateMax;
+    }
+    co_return result;
+}
+
+bool AbstractImporterFile::commitImportedRows()
+{
+    return _importedRowIndex().commitPending();
+}
+
+bool AbstractImporterFile::clearImportedRows()
+{
+    return _importedRowIndex().clear();
+}
+
+ImportedRowIndex &AbstractImporterFile::_importedRowIndex()
+{
+    if (!m_importedRowIndex) {
+        m_importedRowIndex = _createImportedRowIndex();
+    }
+    return *m_importedRowIndex;
+}
+
+QSharedPointer<ImportedRowIndex> AbstractImporterFile::_createImportedRowIndex() const
+{
+    return QSharedPointer<ImportedRowIndex>::create(m_workingDirectory, getActivitySource().toKey());
+}
+
+QCoro::Task<void> AbstractImporterFile::_checkReportHead(const QByteArray &headHash)
+{
+    _importedReports(); // The ids of the older versions are migrated on this thread first
+    m_reportIdentity.headHash = headHash;
+    const QDir workingDirectory = m_workingDirectory;
+    const QString sourceKey = getActivitySource().toKey();
+    // Its own connection, on a thread of the pool
+    m_reportIdentity.headImported = co_await QtConcurrent::run([workingDirectory, sourceKey, headHash]() {
+        return ImportedReports(workingDirectory, sourceKey).isHeadImported(headHash);
+    });
+}
+
+void AbstractImporterFile::_setReportHash(const QByteArray &hash)
+{
+    m_reportIdentity.hash = hash;
+}
+
+QString AbstractImporterFile::_labelDirName() const
+{
+    return getLabel().simplified().replace(" ", "_"); // Basic sanitization
+}
+
+const ImportedReports &AbstractImporterFile::_importedReports()
+{
+    if (!m_importedReports) {
+        m_importedReports = QSharedPointer<ImportedReports>::create(m_workingDirectory, getActivitySource().toKey());
+        _migrateImportedIds();
+    }
+    return *m_importedReports;
+}
+
+void AbstractImporterFile::_migrateImportedIds()
+{
+    auto s = _settings();
+    QStringList importedIds = s->value("Reports/ImportedIds").toStringList();
+    if (importedIds.isEmpty()) {
+        return;
+    }
+    // The ids were the file names: the copies kept in reports/label/year give their content
+    QDir labelDir = m_workingDirectory;
+    if (labelDir.cd("reports") && labelDir.cd(_labelDirName())) {
+        const QStringList yearDirs = labelDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &yearDir : yearDirs) {
+            const QDir reportDir(labelDir.absoluteFilePath(yearDir));
+            for (const QString &fileName : reportDir.entryList(QDir::Files)) {
+                if (importedIds.removeOne(fileName)) {
+                    const ContentHash contentHash = ContentHash::hashFile(reportDir.absoluteFilePath(fileName));
+                    m_importedReports->add(contentHash.result(), contentHash.headHash(), fileName);
+                }
+            }
+        }
+    }
+    if (!importedIds.isEmpty()) {
+        qWarning() << "Imported reports without a copy in" << labelDir.absolutePath()
+                   << ", they will not be recognized:" << importedIds;
+    }
+    s->remove("Reports/ImportedIds");
+}
+
+QCoro::Task<void> AbstractImporterFile::_finishReportIdentity(const QString &filePath)
+{
+    _importedReports();
+    const QDir workingDirectory = m_workingDirectory;
+    const QString sourceKey = getActivitySource().toKey();
+    ReportIdentity identity = m_reportIdentity;
+    m_reportIdentity = co_await QtConcurrent::run([filePath, workingDirectory, sourceKey, identity]() mutable {
+        if (identity.hash.isEmpty() || identity.headHash.isEmpty()) {
+            // Not hashed while read: a few seconds for a report of several GB
+            const ContentHash contentHash = ContentHash::hashFile(filePath);
+            identity.hash = contentHash.result();
+            identity.headHash = contentHash.headHash();
+            identity.headImported = true;
         }
+        if (identity.headImported) {
+            identity.importedFileName = ImportedReports(workingDirectory, sourceKey).importedFileName(identity.hash);
+        }
+        return identity;
+    });
+}
+
+QString AbstractImporterFile::_duplicateError() const
+{
+    if (m_reportIdentity.importedFileName.isEmpty()) {
+        return QString();
     }
+    return QString("Report already imported (%1)").arg(m_reportIdentity.importedFileName);
+}
+
+QString AbstractImporterFile::_recordImport(const QString &filePath, int year, bool hasOrders,
+                                            const QDate &dateMin, const QDate &dateMax)
+{
+    auto s = _settings();
+
+    QDir reportDir = m_workingDirectory;
+    if (!reportDir.exists("reports")) reportDir.mkdir("reports");
+    reportDir.cd("reports");
     
-    co_return result;
+    QString labelSafe = _labelDirName();
+    if (!reportDir.exists(labelSafe)) reportDir.mkdir(labelSafe);
+    reportDir.cd(labelSafe);
+    
+    QString yearStr = QString::number(year);
+    if (!reportDir.exists(yearStr)) reportDir.mkdir(yearStr);
+    reportDir.cd(yearStr);
+    
+    // The content is new: a report imported before under the same name is kept, the copy getting a number
+    const QFileInfo fileInfo(filePath);
+    QString targetPath = reportDir.absoluteFilePath(fileInfo.fileName());
+    for (int i = 2; QFileInfo::exists(targetPath); ++i) {
+        QString fileName = QString("%1 (%2)").arg(fileInfo.completeBaseName()).arg(i);
+        if (!fileInfo.suffix().isEmpty()) {
+            fileName += "." + fileInfo.suffix();
+        }
+        targetPath = reportDir.absoluteFilePath(fileName);
+    }
+    if (!QFile::copy(filePath, targetPath)) {
+        qWarning() << "Failed to copy" << filePath << "to" << targetPath;
+        return QString("Failed to copy the report to %1").arg(targetPath);
+    }
+
+    _importedReports();
+    m_importedReports->add(m_reportIdentity.hash, m_reportIdentity.headHash, fileInfo.fileName());
+
+    // Update dates using the calculated dateMin/dateMax
+    if (hasOrders && dateMin.isValid() && dateMax.isValid()) {
+         QDateTime minDate = dateMin.startOfDay();
+         QDateTime maxDate = dateMax.startOfDay();
+         
+         QDateTime currentFrom = s->value("Reports/ImportedFrom").toDateTime();
+         if (!currentFrom.isValid() || minDate < currentFrom) {
+             s->setValue("Reports/ImportedFrom", minDate);
+         }
+         
+         QDateTime currentTo = s->value("Reports/ImportedTo").toDateTime();
+         if (!currentTo.isValid() || maxDate > currentTo) {
+             s->setValue("Reports/ImportedTo", maxDate);
+         }
+    }
+    return QString();
 }
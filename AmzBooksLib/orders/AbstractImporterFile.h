@@ -2,7 +2,10 @@
 #define ABSTRACTIMPORTERFILE_H
 
 #include "AbstractImporter.h"
+#include "ImportedReports.h"
+#include "ImportedRowIndex.h"
 #include <QCoroTask>
+#include <functional>
 
 class AbstractImporterFile : public AbstractImporter
 {
@@ -11,12 +14,62 @@ public:
 
     QPair<QDateTime, QDateTime> datesFromTo() const; 
     
+    // A report is identified by the hash of its content (ContentHash), computed by the importer as it reads it:
+    // a report already imported is rejected, even renamed
     QCoro::Task<ReturnOrderInfos> loadReport(const QString &filePath);
-
-    virtual QString getUniqueReportId(const QString &filePath) const = 0;
+    // Same as loadReport, the orders being passed to orderInfosCallback by batches as they are read, so that a
+    // report of several GB is imported with bounded memory. The OrderInfos returned only holds the date range.
+    // The batches of a report whose head matches a report imported before are held until its whole hash tells
+    // whether it is the same report: nothing is passed for a duplicate. They only hold the rows not imported before
+    QCoro::Task<ReturnOrderInfos> loadReportStreamed(
+            const QString &filePath, std::function<void(OrderInfos &&)> orderInfosCallback);
+    // Records the rows read by the last load as imported, once the caller recorded its orders (recordOrderInfos
+    // returning true for each batch): the next reports skip them. Until then, they are decoded again
+    bool commitImportedRows();
+    // Forgets the rows imported, for the orders recorded from them being removed (OrderManager::addClearedCallback)
+    bool clearImportedRows();
 
 protected:
     virtual QCoro::Task<ReturnOrderInfos> _loadReport(const QString &filePath) = 0;
+    // Default implementation passes the whole report loaded by _loadReport as a single batch
+    virtual QCoro::Task<ReturnOrderInfos> _loadReportStreamed(
+            const QString &filePath, std::function<void(OrderInfos &&)> orderInfosCallback);
+
+    // Rows of the reports imported before from getActivitySource(). The new rows read by _loadReport are staged
+    // with addPending(), and recorded by commitImportedRows()
+    ImportedRowIndex &_importedRowIndex();
+    // Another connection to the same index, for a thread reading part of the report
+    QSharedPointer<ImportedRowIndex> _createImportedRowIndex() const;
+    // Hashes of the report given as it is read (CsvStreamReader::contentHash): _checkReportHead once its first
+    // block is read, before the first batch, and _setReportHash once it is read to the end. The head is looked up on
+    // a thread of the pool. A report not hashed while read is hashed again once loaded, its batches being all held
+    QCoro::Task<void> _checkReportHead(const QByteArray &headHash);
+    void _setReportHash(const QByteArray &hash);
+
+private:
+    QString _labelDirName() const;
+    // Reports imported from getActivitySource(), the ids of the older versions being migrated on first use
+    const ImportedReports &_importedReports();
+    void _migrateImportedIds();
+    // Hashes of the report being loaded, and the name it was imported under before (empty if it wasn't)
+    struct ReportIdentity {
+        QByteArray headHash;
+        bool headImported = true; // Until the head is known to match no report imported before
+        QByteArray hash;
+        QString importedFileName;
+    };
+    // Once the report is loaded: the report is hashed if the importer didn't, and looked up in ImportedReports
+    // unless its head is new, on a thread of the pool
+    QCoro::Task<void> _finishReportIdentity(const QString &filePath);
+    // Error if the report with this content was imported before, empty otherwise
+    QString _duplicateError() const;
+    // Copies the report to the reports directory and records it as imported. Returns an error if the copy failed,
+    // nothing being recorded then
+    QString _recordImport(const QString &filePath, int year, bool hasOrders, const QDate &dateMin, const QDate &dateMax);
+
+    QSharedPointer<ImportedRowIndex> m_importedRowIndex;
+    QSharedPointer<ImportedReports> m_importedReports;
+    ReportIdentity m_reportIdentity;
 };
 
 #endif // ABSTRACTIMPORTERFILE_H
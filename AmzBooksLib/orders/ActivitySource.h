@@ -2,6 +2,7 @@
 #define ACTIVITYSOURCE_H
 
 #include <QString>
+#include <QStringList>
 
 #include "ActivitySourceType.h"
 
@@ -17,6 +18,26 @@ struct ActivitySource {
                subchannel == other.subchannel &&
                reportOrMethode == other.reportOrMethode;
     }
+
+    // Key stored in the source_key column of Orders.db: type|channel|subchannel|report
+    QString toKey() const {
+        return QString("%1|%2|%3|%4")
+                .arg(QString::number(static_cast<int>(type)), channel, subchannel, reportOrMethode);
+    }
+
+    static ActivitySource fromKey(const QString &key) {
+        const QStringList parts = key.split('|');
+        ActivitySource source;
+        if (parts.size() >= 4) {
+            source.type = static_cast<ActivitySourceType>(parts[0].toInt());
+            source.channel = parts[1];
+            source.subchannel = parts[2];
+            source.reportOrMethode = parts[3];
+        } else {
+            source.type = ActivitySourceType::API; // Default
+        }
+        return source;
+    }
 };
 
 inline uint qHash(const ActivitySource &key, uint seed = 0) {
@@ -9,6 +9,18 @@ void ActivityUpdate::setItems(const QList<ActivityUpdateItem> &items)
 {
     beginResetModel();
     m_items = items;
+    m_pager.reset();
+    m_rowToItem = nullptr;
+    endResetModel();
+}
+
+void ActivityUpdate::setPager(QSharedPointer<KeysetPager> pager,
+                              std::function<ActivityUpdateItem(const QVariantList &row)> rowToItem)
+{
+    beginResetModel();
+    m_items.clear();
+    m_pager = pager;
+    m_rowToItem = rowToItem;
     endResetModel();
 }
 
@@ -58,3 +70,28 @@ QVariant ActivityUpdate::headerData(int section, Qt::Orientation orientation, in
     }
     return QVariant();
 }
+
+bool ActivityUpdate::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !m_pager) {
+        return false;
+    }
+    return !m_pager->atEnd();
+}
+
+void ActivityUpdate::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    const QList<QVariantList> rows = m_pager->fetchPage();
+    if (rows.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), m_items.size(), m_items.size() + rows.size() - 1);
+    m_items.reserve(m_items.size() + rows.size());
+    for (const auto &row : rows) {
+        m_items << m_rowToItem(row);
+    }
+    endInsertRows();
+}
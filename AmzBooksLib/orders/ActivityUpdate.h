@@ -4,6 +4,10 @@
 #include <QAbstractTableModel>
 #include <QList>
 #include <QDateTime>
+#include <QSharedPointer>
+#include <functional>
+
+#include "KeysetPager.h"
 
 struct ActivityUpdateItem {
     QDateTime date;
@@ -21,15 +25,22 @@ public:
     explicit ActivityUpdate(QObject *parent = nullptr);
 
     void setItems(const QList<ActivityUpdateItem> &items);
-    
+    // Rows are then read from pager one page at a time, as the view asks for more (canFetchMore / fetchMore)
+    void setPager(QSharedPointer<KeysetPager> pager,
+                  std::function<ActivityUpdateItem(const QVariantList &row)> rowToItem);
+
     // QAbstractTableModel interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
 private:
     QList<ActivityUpdateItem> m_items;
+    QSharedPointer<KeysetPager> m_pager;
+    std::function<ActivityUpdateItem(const QVariantList &row)> m_rowToItem;
 };
 
 #endif // ACTIVITYUPDATE_H
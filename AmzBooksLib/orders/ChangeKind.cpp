@@ -0,0 +1,29 @@
+#include "ChangeKind.h"
+
+static const QHash<ChangeKind, QString> CHANGEKIND_STRING = {
+    {ChangeKind::Recorded, "Recorded"},
+    {ChangeKind::Updated, "Updated"},
+    {ChangeKind::Revised, "Revised"},
+    {ChangeKind::Published, "Published"},
+    {ChangeKind::Removed, "Removed"},
+    {ChangeKind::Archived, "Archived"},
+    {ChangeKind::Reset, "Reset"}
+};
+
+static const QHash<QString, ChangeKind> STRING_CHANGEKIND = [] {
+    QHash<QString, ChangeKind> map;
+    for (auto it = CHANGEKIND_STRING.begin(); it != CHANGEKIND_STRING.end(); ++it) {
+        map.insert(it.value(), it.key());
+    }
+    return map;
+}();
+
+QString toString(ChangeKind kind)
+{
+    return CHANGEKIND_STRING.value(kind, "Updated");
+}
+
+ChangeKind toChangeKind(const QString &str)
+{
+    return STRING_CHANGEKIND.value(str, ChangeKind::Updated);
+}
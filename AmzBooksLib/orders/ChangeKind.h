@@ -0,0 +1,26 @@
+#ifndef CHANGEKIND_H
+#define CHANGEKIND_H
+
+#include <QHash>
+
+// Kind of a change_log entry of Orders.db: what happened to a shipment row at that sequence number
+enum class ChangeKind {
+    Recorded,  // New row from the source
+    Updated,   // Content replaced (logged before and after, as the event date can move)
+    Revised,   // Reversal or new version created for a published row
+    Published,
+    Removed,   // Draft cleared / pruned, or removed with removeInDatabase()
+    Archived,  // Moved into its yearly partition
+    Reset      // Whole database deleted, no shipment
+};
+
+inline uint qHash(ChangeKind key, uint seed = 0)
+{
+    return ::qHash(static_cast<int>(key), seed);
+}
+
+QString toString(ChangeKind kind);
+ChangeKind toChangeKind(const QString &str);
+
+
+#endif // CHANGEKIND_H
@@ -0,0 +1,125 @@
+#include "ClosedKeySet.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <array>
+
+namespace {
+    QAtomicInt nextInstanceId = 0;
+
+    const QString CREATE_TABLE_CLOSED_KEYS = "CREATE TABLE closed_keys (key TEXT PRIMARY KEY) WITHOUT ROWID";
+    const QString SELECT_CLOSED_KEY = "SELECT EXISTS (SELECT 1 FROM closed_keys WHERE key = ?)";
+    const QString INSERT_CLOSED_KEY = "INSERT OR IGNORE INTO closed_keys (key) VALUES (?)";
+
+    // Bits of a key in the filter, derived from two hashes of it
+    std::array<quint64, ClosedKeySet::BLOOM_HASH_COUNT> bloomBits(const QString &key)
+    {
+        const size_t hash1 = qHash(key);
+        const size_t hash2 = qHash(key, size_t(0x9E3779B9)) | 1;
+        std::array<quint64, ClosedKeySet::BLOOM_HASH_COUNT> bits;
+        for (int i = 0; i < ClosedKeySet::BLOOM_HASH_COUNT; ++i) {
+            bits[i] = quint64(hash1 + i * hash2) & (ClosedKeySet::BLOOM_BITS - 1);
+        }
+        return bits;
+    }
+}
+
+ClosedKeySet::ClosedKeySet()
+    : m_connectionName(QString("ClosedKeySet-%1").arg(nextInstanceId.fetchAndAddRelaxed(1)))
+    , m_bloomBits(BLOOM_BITS / 64, 0)
+{
+}
+
+ClosedKeySet::~ClosedKeySet()
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+bool ClosedKeySet::contains(const QString &key) const
+{
+    if (!_bloomContains(key)) {
+        return false;
+    }
+    if (!m_isOpen) {
+        return true; // No exact check without the database: rather a wrong match than a missed one
+    }
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare(SELECT_CLOSED_KEY);
+    query.addBindValue(key);
+    if (!query.exec() || !query.next()) {
+        qWarning() << "Failed to read closed keys:" << query.lastError().text();
+        return true;
+    }
+    return query.value(0).toBool();
+}
+
+bool ClosedKeySet::add(const QStringList &keys)
+{
+    if (keys.isEmpty()) {
+        return true;
+    }
+    for (const auto &key : keys) {
+        for (quint64 bit : bloomBits(key)) {
+            m_bloomBits[bit / 64] |= quint64(1) << (bit % 64);
+        }
+    }
+    if (!_open()) {
+        return false;
+    }
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+    if (!db.transaction()) {
+        qWarning() << "Failed to start transaction:" << db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare(INSERT_CLOSED_KEY);
+    for (const auto &key : keys) {
+        query.bindValue(0, key);
+        if (!query.exec()) {
+            qWarning() << "Failed to record closed key:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        qWarning() << "Failed to commit closed keys:" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ClosedKeySet::_open()
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        return m_isOpen;
+    }
+    // No file name: SQLite creates a temporary file, deleted when the connection is closed
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    if (!db.open()) {
+        qWarning() << "Failed to open database:" << db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    if (!query.exec(CREATE_TABLE_CLOSED_KEYS)) {
+        qWarning() << "Failed to create closed_keys:" << query.lastError().text();
+        return false;
+    }
+    m_isOpen = true;
+    return true;
+}
+
+bool ClosedKeySet::_bloomContains(const QString &key) const
+{
+    for (quint64 bit : bloomBits(key)) {
+        if (!(m_bloomBits[bit / 64] & (quint64(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef CLOSEDKEYSET_H
+#define CLOSEDKEYSET_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// ClosedKeySet = keys of the events a streamed import already passed downstream, with a fixed memory whatever their
+// number: a Bloom filter answers most lookups, the keys being written to a temporary SQLite database (on disk,
+// removed once closed) that is only read when the filter matches. Used from the thread that created it.
+class ClosedKeySet
+{
+public:
+    // 2 MB, under 1% of the lookups reading the database up to 1.5M keys
+    static constexpr qsizetype BLOOM_BITS = qsizetype(1) << 24;
+    static constexpr int BLOOM_HASH_COUNT = 4;
+
+    ClosedKeySet();
+    ~ClosedKeySet();
+    ClosedKeySet(const ClosedKeySet &) = delete;
+    ClosedKeySet &operator=(const ClosedKeySet &) = delete;
+
+    bool contains(const QString &key) const;
+    // In one transaction
+    bool add(const QStringList &keys);
+
+private:
+    bool _open();
+    bool _bloomContains(const QString &key) const;
+
+    QString m_connectionName;
+    QList<quint64> m_bloomBits;
+    bool m_isOpen = false;
+};
+
+#endif // CLOSEDKEYSET_H
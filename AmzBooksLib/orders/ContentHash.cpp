@@ -0,0 +1,123 @@
+#include "ContentHash.h"
+
+#include <QFile>
+
+ContentHash ContentHash::hashFile(const QString &filePath)
+{
+    ContentHash contentHash;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return contentHash;
+    }
+    QByteArray buffer(BLOCK_SIZE, Qt::Uninitialized);
+    while (true) {
+        const qint64 nRead = file.read(buffer.data(), buffer.size());
+        if (nRead < 0) {
+            return contentHash; // Not finished, no result
+        }
+        if (nRead == 0) {
+            break;
+        }
+        contentHash.addData(QByteArrayView(buffer.constData(), nRead));
+    }
+    contentHash.finish();
+    return contentHash;
+}
+
+ContentHash::ContentHash(qint64 from)
+    : m_from(from)
+    , m_blocksFrom((from + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE)
+    , m_end(from)
+{
+}
+
+void ContentHash::addData(QByteArrayView data)
+{
+    if (m_end < m_blocksFrom) {
+        const qsizetype n = qsizetype(qMin(qint64(data.size()), m_blocksFrom - m_end));
+        m_leadingBytes.append(data.first(n));
+        m_end += n;
+        data = data.sliced(n);
+    }
+    while (!data.isEmpty()) {
+        const qsizetype n = qMin(data.size(), BLOCK_SIZE - m_blockBytes.size());
+        if (m_blockBytes.isEmpty() && n == BLOCK_SIZE) {
+            m_blockHashes << QCryptographicHash::hash(data.first(n), ALGORITHM); // Not copied
+        } else {
+            m_blockBytes.append(data.first(n));
+            if (m_blockBytes.size() == BLOCK_SIZE) {
+                m_blockHashes << QCryptographicHash::hash(m_blockBytes, ALGORITHM);
+                m_blockBytes.clear();
+            }
+        }
+        m_end += n;
+        data = data.sliced(n);
+    }
+}
+
+void ContentHash::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    // The last block may be shorter, an empty file having a single empty block
+    if (!m_blockBytes.isEmpty() || (m_from == 0 && m_end == 0)) {
+        m_blockHashes << QCryptographicHash::hash(m_blockBytes, ALGORITHM);
+        m_blockBytes.clear();
+    }
+}
+
+bool ContentHash::append(const ContentHash &next)
+{
+    if (!m_valid || !next.m_valid || next.m_from > m_end) {
+        m_valid = false;
+        return false;
+    }
+    if (m_end < next.m_end) {
+        const qint64 leadingEnd = next.m_from + next.m_leadingBytes.size();
+        if (m_end < leadingEnd) {
+            addData(QByteArrayView(next.m_leadingBytes).sliced(m_end - next.m_from));
+        }
+        if (next.m_end > leadingEnd) {
+            // The blocks of next start at leadingEnd: the blocks of both are the same, those hashed by this one
+            // being skipped
+            if (m_end < m_blocksFrom || !m_blockBytes.isEmpty()) {
+                m_valid = false;
+                return false;
+            }
+            m_blockHashes << next.m_blockHashes.mid((m_end - leadingEnd) / BLOCK_SIZE);
+            m_blockBytes = next.m_blockBytes;
+            m_end = next.m_end;
+        }
+    }
+    if (next.m_finished) {
+        finish();
+    }
+    return true;
+}
+
+qint64 ContentHash::end() const noexcept
+{
+    return m_end;
+}
+
+QByteArray ContentHash::headHash() const
+{
+    if (m_from != 0 || !m_valid || m_blockHashes.isEmpty()) {
+        return QByteArray();
+    }
+    return m_blockHashes.first();
+}
+
+QByteArray ContentHash::result() const
+{
+    if (m_from != 0 || !m_valid || !m_finished) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(ALGORITHM);
+    for (const auto &blockHash : m_blockHashes) {
+        hash.addData(blockHash);
+    }
+    return hash.result();
+}
@@ -0,0 +1,51 @@
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QCryptographicHash>
+#include <QList>
+#include <QString>
+
+// ContentHash = hash of the content of a file, as the SHA-256 of the SHA-256 of its blocks of BLOCK_SIZE bytes,
+// so that it is computed by the readers of the file as they read it: each reader of a byte range hashes its own bytes,
+// and the hashes of the ranges are appended in file order without reading anything again. The hash of the first
+// block, the head, is known as soon as the first buffer is read. Only the bytes of a range before its first block
+// and of its last incomplete block are kept, less than 2 blocks.
+class ContentHash
+{
+public:
+    static constexpr QCryptographicHash::Algorithm ALGORITHM = QCryptographicHash::Sha256;
+    static constexpr qsizetype BLOCK_SIZE = 1 << 20;
+
+    // Reading the whole file, for a file not read otherwise
+    static ContentHash hashFile(const QString &filePath);
+
+    explicit ContentHash(qint64 from = 0); // Hashes the bytes from there
+
+    // Next bytes of the file, from end()
+    void addData(QByteArrayView data);
+    // Once the end of the file is reached
+    void finish();
+    // The hash of the range that follows, which may start before end() as long as its bytes before end() were
+    // not hashed in a block yet. Returns false otherwise, the hash being then incomplete
+    bool append(const ContentHash &next);
+
+    qint64 end() const noexcept;
+    // Empty unless the first block was read from 0 (or the whole file, if smaller)
+    QByteArray headHash() const;
+    // Empty unless the whole file was hashed
+    QByteArray result() const;
+
+private:
+    qint64 m_from;
+    qint64 m_blocksFrom; // Start of the first block from m_from
+    qint64 m_end;
+    bool m_finished = false;
+    bool m_valid = true; // False once a range could not be appended
+    QByteArray m_leadingBytes; // From m_from to m_blocksFrom, the end of a block hashed by the range before
+    QList<QByteArray> m_blockHashes;
+    QByteArray m_blockBytes; // Of the last block, until it is complete
+};
+
+#endif // CONTENTHASH_H
@@ -0,0 +1,282 @@
+#include "CsvStreamReader.h"
+
+#include <cstring>
+
+CsvStreamReader::CsvStreamReader(const QString &filePath, char separator, char quote)
+    : m_file(filePath)
+    , m_separator(separator)
+    , m_quote(quote)
+{
+}
+
+bool CsvStreamReader::open(qint64 from, qint64 to)
+{
+    m_errorString.clear();
+    if (!m_file.isOpen() && !m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    if (!m_file.seek(from)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_buffer.clear();
+    m_buffer.reserve(DEFAULT_BUFFER_SIZE);
+    m_bufferPos = 0;
+    m_scanPos = 0;
+    m_scanInQuotes = false;
+    m_bufferOffset = from;
+    m_rangeEnd = to;
+    m_eof = false;
+    m_contentHash = ContentHash(from);
+    _fill();
+    if (from == 0 && m_buffer.startsWith("\xEF\xBB\xBF")) {
+        m_bufferPos = 3;
+        m_scanPos = 3;
+    }
+    return m_errorString.isEmpty();
+}
+
+const QString &CsvStreamReader::errorString() const
+{
+    return m_errorString;
+}
+
+void CsvStreamReader::enableContentHash()
+{
+    m_hashContent = true;
+}
+
+const ContentHash &CsvStreamReader::contentHash() const noexcept
+{
+    return m_contentHash;
+}
+
+bool CsvStreamReader::readRecord()
+{
+    m_fields.clear();
+    m_unescapedFields.clear();
+    while (true) {
+        // Blank lines
+        while (m_bufferPos < m_buffer.size()
+               && (m_buffer[m_bufferPos] == '\n' || m_buffer[m_bufferPos] == '\r')) {
+            ++m_bufferPos;
+        }
+        if (m_scanPos < m_bufferPos) {
+            m_scanPos = m_bufferPos;
+        }
+        if (m_bufferPos >= m_buffer.size()) {
+            if (m_eof || !_fill()) {
+                return false;
+            }
+            continue;
+        }
+        if (m_rangeEnd >= 0 && m_bufferOffset + m_bufferPos >= m_rangeEnd) {
+            return false;
+        }
+        qsizetype end = _findRecordEnd(m_scanPos);
+        if (end < 0) {
+            if (!m_eof && _fill()) {
+                continue;
+            }
+            end = m_buffer.size(); // Last record without newline
+        }
+        m_recordOffset = m_bufferOffset + m_bufferPos;
+        _splitFields(m_bufferPos, end);
+        m_bufferPos = qMin(end + 1, m_buffer.size());
+        m_scanPos = m_bufferPos;
+        m_scanInQuotes = false;
+        return true;
+    }
+}
+
+const QList<QByteArrayView> &CsvStreamReader::fields() const noexcept
+{
+    return m_fields;
+}
+
+QByteArrayView CsvStreamReader::field(qsizetype index) const noexcept
+{
+    if (index < 0 || index >= m_fields.size()) {
+        return QByteArrayView();
+    }
+    return m_fields[index];
+}
+
+QString CsvStreamReader::fieldString(qsizetype index) const
+{
+    return QString::fromUtf8(field(index));
+}
+
+qint64 CsvStreamReader::recordOffset() const noexcept
+{
+    return m_recordOffset;
+}
+
+qint64 CsvStreamReader::pos() const noexcept
+{
+    return m_bufferOffset + m_bufferPos;
+}
+
+qint64 CsvStreamReader::fileSize() const
+{
+    return m_file.size();
+}
+
+QList<qint64> CsvStreamReader::splitRecords(const QString &filePath, qint64 from, int nChunks, char quote)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(from)) {
+        return {};
+    }
+    const qint64 size = file.size();
+    const qint64 chunkSize = (size - from) / qMax(1, nChunks);
+    QList<qint64> boundaries{from};
+    // Only quotes and newlines are looked at, much faster than reading the records
+    QByteArray buffer(DEFAULT_BUFFER_SIZE, Qt::Uninitialized);
+    qint64 offset = from;
+    qint64 nextBoundary = from + chunkSize;
+    bool inQuotes = false;
+    while (chunkSize > 0 && boundaries.size() < nChunks) {
+        const qint64 nRead = file.read(buffer.data(), buffer.size());
+        if (nRead <= 0) {
+            break;
+        }
+        const char *data = buffer.constData();
+        for (qint64 i = 0; i < nRead; ++i) {
+            if (data[i] == quote) {
+                inQuotes = !inQuotes;
+            } else if (data[i] == '\n' && !inQuotes && offset + i >= nextBoundary) {
+                const qint64 recordStart = offset + i + 1;
+                if (recordStart < size) {
+                    boundaries << recordStart;
+                }
+                nextBoundary = recordStart + chunkSize;
+                if (boundaries.size() == nChunks) {
+                    break;
+                }
+            }
+        }
+        offset += nRead;
+    }
+    if (boundaries.last() < size) {
+        boundaries << size;
+    }
+    return boundaries;
+}
+
+bool CsvStreamReader::_fill()
+{
+    // Drops the records already read, the start of the current one moving to the front
+    if (m_bufferPos > 0) {
+        m_buffer.remove(0, m_bufferPos);
+        m_bufferOffset += m_bufferPos;
+        m_scanPos -= m_bufferPos;
+        m_bufferPos = 0;
+    }
+    // The buffer only grows for a record longer than it
+    const qsizetype size = m_buffer.size();
+    qsizetype toRead = size < DEFAULT_BUFFER_SIZE ? DEFAULT_BUFFER_SIZE - size : DEFAULT_BUFFER_SIZE;
+    if (m_rangeEnd >= 0) {
+        // Not much past the range, that only needs the end of its last record (a single record read again...)
+        const qint64 rangeLeft = qMax(m_rangeEnd - (m_bufferOffset + size), qint64(0));
+        toRead = qsizetype(qMin(qint64(toRead), rangeLeft + MIN_READ_SIZE));
+    }
+    m_buffer.resize(size + toRead);
+    qint64 nRead = m_file.read(m_buffer.data() + size, toRead);
+    if (nRead < 0) {
+        m_errorString = m_file.errorString();
+        nRead = 0;
+    }
+    m_buffer.resize(size + nRead);
+    if (m_hashContent) {
+        // The bytes read past the range are hashed by the reader of the next one
+        qint64 nHashed = nRead;
+        if (m_rangeEnd >= 0) {
+            nHashed = qBound(qint64(0), m_rangeEnd - m_contentHash.end(), nRead);
+        }
+        m_contentHash.addData(QByteArrayView(m_buffer.constData() + size, nHashed));
+        if (m_contentHash.end() == m_file.size()) {
+            m_contentHash.finish();
+        }
+    }
+    if (nRead == 0) {
+        m_eof = true;
+    }
+    return nRead > 0;
+}
+
+qsizetype CsvStreamReader::_findRecordEnd(qsizetype from)
+{
+    const char *data = m_buffer.constData();
+    const qsizetype size = m_buffer.size();
+    bool inQuotes = m_scanInQuotes;
+    for (qsizetype i = from; i < size; ++i) {
+        const char c = data[i];
+        if (c == m_quote) {
+            inQuotes = !inQuotes; // A doubled quote toggles twice
+        } else if (c == '\n' && !inQuotes) {
+            return i;
+        }
+    }
+    // Goes on from there once more bytes are read
+    m_scanPos = size;
+    m_scanInQuotes = inQuotes;
+    return -1;
+}
+
+void CsvStreamReader::_splitFields(qsizetype begin, qsizetype end)
+{
+    const char *data = m_buffer.constData();
+    if (end > begin && data[end - 1] == '\r') {
+        --end;
+    }
+    qsizetype i = begin;
+    while (true) {
+        if (i < end && data[i] == m_quote) {
+            const qsizetype contentBegin = i + 1;
+            qsizetype contentEnd = end;
+            bool hasDoubledQuotes = false;
+            qsizetype j = contentBegin;
+            while (j < end) {
+                const char *quote = static_cast<const char *>(std::memchr(data + j, m_quote, end - j));
+                if (!quote) {
+                    j = end; // Unterminated, the field runs to the end of the record
+                    break;
+                }
+                const qsizetype q = quote - data;
+                if (q + 1 < end && data[q + 1] == m_quote) {
+                    hasDoubledQuotes = true;
+                    j = q + 2;
+                    continue;
+                }
+                contentEnd = q;
+                j = q + 1;
+                break;
+            }
+            QByteArrayView content(data + contentBegin, contentEnd - contentBegin);
+            if (hasDoubledQuotes) {
+                QByteArray unescaped = content.toByteArray();
+                unescaped.replace(QByteArray(2, m_quote), QByteArray(1, m_quote));
+                m_unescapedFields << unescaped;
+                content = QByteArrayView(m_unescapedFields.last());
+            }
+            m_fields << content;
+            // Anything between the closing quote and the separator is ignored
+            i = j;
+            while (i < end && data[i] != m_separator) {
+                ++i;
+            }
+        } else {
+            const char *separator = i < end ? static_cast<const char *>(std::memchr(data + i, m_separator, end - i))
+                                            : nullptr;
+            const qsizetype fieldEnd = separator ? separator - data : end;
+            m_fields << QByteArrayView(data + i, fieldEnd - i);
+            i = fieldEnd;
+        }
+        if (i >= end) {
+            break;
+        }
+        ++i; // Separator, a trailing one ending with an empty field
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef CSVSTREAMREADER_H
+#define CSVSTREAMREADER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include "ContentHash.h"
+
+// CsvStreamReader = forward-only reading of the records of a CSV file through a fixed-size buffer, so that
+// reports of several GB are read with constant memory. Quoted fields may hold separators, doubled quotes and
+// newlines. Fields are views of the buffer (UTF-8), valid until the next call to readRecord(); blank lines are skipped.
+// The records can be limited to a byte range of the file, for reading a file by chunks.
+class CsvStreamReader
+{
+public:
+    static constexpr qsizetype DEFAULT_BUFFER_SIZE = 1 << 20;
+    static constexpr qint64 MIN_READ_SIZE = 16 << 10; // Past the end of a byte range
+
+    explicit CsvStreamReader(const QString &filePath, char separator = ',', char quote = '"');
+    CsvStreamReader(const CsvStreamReader &) = delete;
+    CsvStreamReader &operator=(const CsvStreamReader &) = delete;
+
+    // Reads the records starting in [from, to), from being the start of a record (to = -1 for the end of the file).
+    // The UTF-8 BOM at the start of the file is skipped
+    bool open(qint64 from = 0, qint64 to = -1);
+    const QString &errorString() const;
+
+    // Hashes the bytes of the range as they are read, from the next open(): the hash of the report is then
+    // known without reading it again, and the ones of the ranges read on several threads are appended in order
+    void enableContentHash();
+    const ContentHash &contentHash() const noexcept;
+
+    // Moves to the next record, returns false when all records were read
+    bool readRecord();
+
+    // Fields of the current record (valid after readRecord() returned true)
+    const QList<QByteArrayView> &fields() const noexcept;
+    QByteArrayView field(qsizetype index) const noexcept; // Empty if index is -1 or out of range
+    QString fieldString(qsizetype index) const;
+
+    qint64 recordOffset() const noexcept; // Position in the file of the current record
+    qint64 pos() const noexcept; // Position in the file after the current record
+    qint64 fileSize() const;
+
+    // Splits the records starting from the record at "from" into about nChunks byte ranges of similar size,
+    // returning their boundaries [from, ..., file size]. Quotes are counted the same way as readRecord(), so a
+    // newline inside a quoted field is never a boundary. Empty if the file can't be read
+    static QList<qint64> splitRecords(const QString &filePath, qint64 from, int nChunks, char quote = '"');
+
+private:
+    bool _fill();
+    qsizetype _findRecordEnd(qsizetype from);
+    void _splitFields(qsizetype begin, qsizetype end);
+
+    QFile m_file;
+    char m_separator;
+    char m_quote;
+    QString m_errorString;
+    QByteArray m_buffer;
+    qsizetype m_bufferPos = 0; // Start of the unread records in m_buffer
+    qsizetype m_scanPos = 0; // Where the search of the end of the record goes on after a refill
+    bool m_scanInQuotes = false;
+    qint64 m_bufferOffset = 0; // Position in the file of m_buffer[0]
+    qint64 m_rangeEnd = -1;
+    qint64 m_recordOffset = 0;
+    bool m_eof = true;
+    QList<QByteArrayView> m_fields;
+    QList<QByteArray> m_unescapedFields; // Quoted fields with doubled quotes, the views pointing to them
+    bool m_hashContent = false;
+    ContentHash m_contentHash;
+};
+
+#endif // CSVSTREAMREADER_H
@@ -0,0 +1,141 @@
+#include "FieldDecoder.h"
+
+#include <charconv>
+
+namespace {
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Value of the digits of field[from, from + count), -1 if one is not a digit
+    int toNumber(const char *data, int from, int count)
+    {
+        int number = 0;
+        for (int i = from; i < from + count; ++i) {
+            const int digit = data[i] - '0';
+            if (digit < 0 || digit > 9) {
+                return -1;
+            }
+            number = number * 10 + digit;
+        }
+        return number;
+    }
+}
+
+double FieldDecoder::toDouble(QByteArrayView field, bool *ok)
+{
+    qsizetype begin = 0;
+    qsizetype end = field.size();
+    while (begin < end && isSpace(field[begin])) {
+        ++begin;
+    }
+    while (end > begin && isSpace(field[end - 1])) {
+        --end;
+    }
+    if (begin < end && field[begin] == '+' && (end - begin == 1 || field[begin + 1] != '-')) {
+        ++begin; // Not accepted by from_chars
+    }
+    double value = 0.;
+    const char *first = field.data() + begin;
+    const char *last = field.data() + end;
+    const auto [ptr, ec] = std::from_chars(first, last, value);
+    if (begin < end && ec == std::errc() && ptr == last) {
+        if (ok) {
+            *ok = true;
+        }
+        return value;
+    }
+    // Out of range, hexadecimal, infinity spelling...: as Qt does
+    return QString::fromUtf8(field).toDouble(ok);
+}
+
+QDate FieldDecoder::toDate(QByteArrayView field)
+{
+    if (field.isEmpty()) {
+        return QDate();
+    }
+    if (m_dateFormat != DateFormat::Unknown) {
+        const QDate date = _toDate(field, m_dateFormat);
+        if (date.isValid()) {
+            return date;
+        }
+    }
+    // The formats have their separators at different places, so a date matches one of them only
+    for (auto format : {DateFormat::DayMonthYearDash, DateFormat::DayMonthYearSlash, DateFormat::YearMonthDay}) {
+        if (format == m_dateFormat) {
+            continue;
+        }
+        const QDate date = _toDate(field, format);
+        if (date.isValid()) {
+            if (m_dateFormat == DateFormat::Unknown) {
+                m_dateFormat = format;
+            }
+            return date;
+        }
+    }
+    // Dates not written with 2 digit days / months
+    const QString dateStr = QString::fromUtf8(field);
+    QDate date = QDate::fromString(dateStr, "dd-MM-yyyy");
+    if (!date.isValid()) date = QDate::fromString(dateStr, "dd/MM/yyyy");
+    if (!date.isValid()) date = QDate::fromString(dateStr, "yyyy-MM-dd");
+    return date;
+}
+
+FieldDecoder::DateFormat FieldDecoder::dateFormat() const
+{
+    return m_dateFormat;
+}
+
+QString FieldDecoder::toSharedString(QByteArrayView field)
+{
+    for (qsizetype i = 0; i < m_sharedUtf8.size(); ++i) {
+        if (QByteArrayView(m_sharedUtf8[i]) == field) {
+            return m_sharedStrings[i];
+        }
+    }
+    QString string = QString::fromUtf8(field);
+    if (m_sharedUtf8.size() < MAX_SHARED_STRINGS) {
+        m_sharedUtf8 << field.toByteArray();
+        m_sharedStrings << string;
+    }
+    return string;
+}
+
+QDate FieldDecoder::_toDate(QByteArrayView field, DateFormat format)
+{
+    if (field.size() != 10) {
+        return QDate();
+    }
+    const char *data = field.data();
+    int year = -1;
+    int month = -1;
+    int day = -1;
+    switch (format) {
+    case DateFormat::DayMonthYearDash:
+    case DateFormat::DayMonthYearSlash: {
+        const char separator = format == DateFormat::DayMonthYearDash ? '-' : '/';
+        if (data[2] != separator || data[5] != separator) {
+            return QDate();
+        }
+        day = toNumber(data, 0, 2);
+        month = toNumber(data, 3, 2);
+        year = toNumber(data, 6, 4);
+        break;
+    }
+    case DateFormat::YearMonthDay:
+        if (data[4] != '-' || data[7] != '-') {
+            return QDate();
+        }
+        year = toNumber(data, 0, 4);
+        month = toNumber(data, 5, 2);
+        day = toNumber(data, 8, 2);
+        break;
+    case DateFormat::Unknown:
+        return QDate();
+    }
+    if (year < 0 || month < 0 || day < 0) {
+        return QDate();
+    }
+    return QDate(year, month, day); // Invalid for a day or month out of range
+}
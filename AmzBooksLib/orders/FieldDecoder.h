@@ -0,0 +1,45 @@
+#ifndef FIELDDECODER_H
+#define FIELDDECODER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QDate>
+#include <QList>
+#include <QString>
+
+// FieldDecoder = decoding of the UTF-8 fields of a report (CsvStreamReader::field) without going through QString,
+// for the values read on every row. Gives the same values as the Qt functions replaced (QString::toDouble,
+// QDate::fromString), falling back to them for the text the fast paths don't handle.
+// Keeps per file state (date format, repeated strings): one instance per file and thread.
+class FieldDecoder
+{
+public:
+    enum class DateFormat {
+        Unknown,
+        DayMonthYearDash, // dd-MM-yyyy
+        DayMonthYearSlash, // dd/MM/yyyy
+        YearMonthDay // yyyy-MM-dd
+    };
+
+    static constexpr qsizetype MAX_SHARED_STRINGS = 64;
+
+    // Same as QString::toDouble: '.' as decimal point, surrounding spaces ignored, 0 if not a number
+    static double toDouble(QByteArrayView field, bool *ok = nullptr);
+
+    // A date in one of the formats of DateFormat, invalid if none. The format of the first date is tried first
+    QDate toDate(QByteArrayView field);
+    DateFormat dateFormat() const;
+
+    // QString of a field with few different values (country, currency...), shared by the rows with the same
+    // value instead of allocated for each. Values past MAX_SHARED_STRINGS different ones are allocated
+    QString toSharedString(QByteArrayView field);
+
+private:
+    static QDate _toDate(QByteArrayView field, DateFormat format);
+
+    DateFormat m_dateFormat = DateFormat::Unknown;
+    QList<QByteArray> m_sharedUtf8;
+    QList<QString> m_sharedStrings;
+};
+
+#endif // FIELDDECODER_H
@@ -0,0 +1,112 @@
+#include "ImportedReports.h"
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace {
+    QAtomicInt nextInstanceId = 0;
+
+    const QString CREATE_TABLE_IMPORTED_REPORTS = R"(
+        CREATE TABLE IF NOT EXISTS imported_reports (
+            source_key TEXT NOT NULL,
+            content_hash BLOB NOT NULL,
+            head_hash BLOB NOT NULL,
+            file_name TEXT NOT NULL,
+            imported_at TEXT NOT NULL,
+            PRIMARY KEY (source_key, content_hash)
+        ) WITHOUT ROWID
+    )";
+    const QString CREATE_INDEX_IMPORTED_REPORTS_HEAD = "CREATE INDEX IF NOT EXISTS imported_reports_head ON imported_reports (source_key, head_hash)";
+    const QString SELECT_IMPORTED_REPORT = "SELECT file_name FROM imported_reports WHERE source_key = ? AND content_hash = ?";
+    const QString SELECT_IMPORTED_HEAD = "SELECT EXISTS (SELECT 1 FROM imported_reports WHERE source_key = ? AND head_hash = ?)";
+    const QString INSERT_IMPORTED_REPORT = "INSERT OR IGNORE INTO imported_reports (source_key, content_hash, head_hash, file_name, imported_at) VALUES (?, ?, ?, ?, ?)";
+}
+
+ImportedReports::ImportedReports(const QDir &workingDirectory, const QString &sourceKey)
+    : m_filePathDb(workingDirectory.absoluteFilePath("importer.db"))
+    , m_sourceKey(sourceKey)
+    , m_connectionName(QString("ImportedReports-%1").arg(nextInstanceId.fetchAndAddRelaxed(1)))
+{
+}
+
+ImportedReports::~ImportedReports()
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+QString ImportedReports::importedFileName(const QByteArray &contentHash) const
+{
+    if (contentHash.isEmpty() || !_open()) {
+        return QString();
+    }
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare(SELECT_IMPORTED_REPORT);
+    query.addBindValue(m_sourceKey);
+    query.addBindValue(contentHash);
+    if (!query.exec()) {
+        qWarning() << "Failed to read imported reports:" << query.lastError().text();
+        return QString();
+    }
+    return query.next() ? query.value(0).toString() : QString();
+}
+
+bool ImportedReports::isHeadImported(const QByteArray &headHash) const
+{
+    if (headHash.isEmpty() || !_open()) {
+        return true; // Unknown: the whole hash tells
+    }
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare(SELECT_IMPORTED_HEAD);
+    query.addBindValue(m_sourceKey);
+    query.addBindValue(headHash);
+    if (!query.exec() || !query.next()) {
+        qWarning() << "Failed to read imported reports:" << query.lastError().text();
+        return true;
+    }
+    return query.value(0).toBool();
+}
+
+bool ImportedReports::add(const QByteArray &contentHash, const QByteArray &headHash, const QString &fileName)
+{
+    if (contentHash.isEmpty() || headHash.isEmpty() || !_open()) {
+        return false;
+    }
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare(INSERT_IMPORTED_REPORT);
+    query.addBindValue(m_sourceKey);
+    query.addBindValue(contentHash);
+    query.addBindValue(headHash);
+    query.addBindValue(fileName);
+    query.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    if (!query.exec()) {
+        qWarning() << "Failed to record imported report:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ImportedReports::_open() const
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        return QSqlDatabase::database(m_connectionName, false).isOpen();
+    }
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_filePathDb);
+    if (!db.open()) {
+        qWarning() << "Failed to open database:" << db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA journal_mode = WAL") || !query.exec(CREATE_TABLE_IMPORTED_REPORTS)
+            || !query.exec(CREATE_INDEX_IMPORTED_REPORTS_HEAD)) {
+        qWarning() << "Failed to create imported_reports:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef IMPORTEDREPORTS_H
+#define IMPORTEDREPORTS_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QString>
+
+// ImportedReports = reports imported from an activity source, identified by the hash of their content (ContentHash)
+// so that a renamed copy is still recognized. Stored in importer.db of the importer working directory (see
+// ImportedRowIndex), the primary key making the duplicate check a single index lookup however many reports were
+// imported. The hash of their head is indexed as well, for telling a new report before it is read to the end.
+class ImportedReports
+{
+public:
+    ImportedReports(const QDir &workingDirectory, const QString &sourceKey);
+    ~ImportedReports();
+    ImportedReports(const ImportedReports &) = delete;
+    ImportedReports &operator=(const ImportedReports &) = delete;
+
+    // Name of the file the report was imported from, empty if it wasn't
+    QString importedFileName(const QByteArray &contentHash) const;
+    // True if a report imported has this head: a report whose head matches none is new
+    bool isHeadImported(const QByteArray &headHash) const;
+    bool add(const QByteArray &contentHash, const QByteArray &headHash, const QString &fileName);
+
+private:
+    bool _open() const;
+
+    QString m_filePathDb;
+    QString m_sourceKey;
+    QString m_connectionName;
+};
+
+#endif // IMPORTEDREPORTS_H
@@ -0,0 +1,191 @@
+#include "ImportedRowIndex.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace {
+    QAtomicInt nextInstanceId = 0;
+
+    // WITHOUT ROWID: the primary key is the table, a lookup reading a single b-tree
+    const QString CREATE_TABLE_IMPORTED_ROWS = R"(
+        CREATE TABLE IF NOT EXISTS imported_rows (
+            source_key TEXT NOT NULL,
+            fingerprint INTEGER NOT NULL,
+            PRIMARY KEY (source_key, fingerprint)
+        ) WITHOUT ROWID
+    )";
+    // Per connection, in the temporary database: the rows of the report being read are not seen by the lookups
+    const QString CREATE_TABLE_PENDING_ROWS = "CREATE TEMP TABLE IF NOT EXISTS pending_rows (fingerprint INTEGER PRIMARY KEY)";
+    const QString SELECT_IMPORTED_ROWS = "SELECT fingerprint FROM imported_rows WHERE source_key = ? AND fingerprint IN (%1)";
+    const QString INSERT_PENDING_ROW = "INSERT OR IGNORE INTO pending_rows (fingerprint) VALUES (?)";
+    const QString INSERT_IMPORTED_ROWS = "INSERT OR IGNORE INTO imported_rows (source_key, fingerprint) SELECT ?, fingerprint FROM pending_rows";
+    const QString DELETE_PENDING_ROWS = "DELETE FROM pending_rows";
+    const QString DELETE_IMPORTED_ROWS = "DELETE FROM imported_rows WHERE source_key = ?";
+}
+
+qint64 ImportedRowIndex::fingerprint(const QList<QByteArrayView> &fields)
+{
+    quint64 hash = 14695981039346656037ULL;
+    auto addByte = [&hash](uchar byte) {
+        hash ^= byte;
+        hash *= 1099511628211ULL;
+    };
+    for (const auto &field : fields) {
+        for (char c : field) {
+            addByte(uchar(c));
+        }
+        addByte(0x1F); // Unit separator, so that "a,bc" and "ab,c" differ
+    }
+    return qint64(hash);
+}
+
+ImportedRowIndex::ImportedRowIndex(const QDir &workingDirectory, const QString &sourceKey)
+    : m_filePathDb(workingDirectory.absoluteFilePath("importer.db"))
+    , m_sourceKey(sourceKey)
+    , m_connectionName(QString("ImportedRowIndex-%1").arg(nextInstanceId.fetchAndAddRelaxed(1)))
+{
+}
+
+ImportedRowIndex::~ImportedRowIndex()
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+QSet<qint64> ImportedRowIndex::imported(const QList<qint64> &fingerprints)
+{
+    QSet<qint64> importedFingerprints;
+    if (fingerprints.isEmpty() || !_open()) {
+        return importedFingerprints;
+    }
+    // Point lookups in the primary key, a full batch query being prepared once
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.setForwardOnly(true);
+    qsizetype preparedSize = 0;
+    for (qsizetype from = 0; from < fingerprints.size(); from += LOOKUP_BATCH_SIZE) {
+        const qsizetype size = qMin(LOOKUP_BATCH_SIZE, fingerprints.size() - from);
+        if (size != preparedSize) {
+            QStringList placeholders(size, "?");
+            query.prepare(SELECT_IMPORTED_ROWS.arg(placeholders.join(", ")));
+            preparedSize = size;
+        }
+        query.bindValue(0, m_sourceKey);
+        for (qsizetype i = 0; i < size; ++i) {
+            query.bindValue(int(i + 1), fingerprints[from + i]);
+        }
+        if (!query.exec()) {
+            qWarning() << "Failed to read imported rows:" << query.lastError().text();
+            return QSet<qint64>();
+        }
+        while (query.next()) {
+            importedFingerprints.insert(query.value(0).toLongLong());
+        }
+    }
+    return importedFingerprints;
+}
+
+bool ImportedRowIndex::addPending(const QList<qint64> &fingerprints)
+{
+    if (fingerprints.isEmpty()) {
+        return true;
+    }
+    if (!_open()) {
+        return false;
+    }
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+    if (!db.transaction()) {
+        qWarning() << "Failed to start transaction:" << db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare(INSERT_PENDING_ROW);
+    for (qint64 fingerprint : fingerprints) {
+        query.bindValue(0, fingerprint);
+        if (!query.exec()) {
+            qWarning() << "Failed to stage imported row:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        qWarning() << "Failed to commit staged rows:" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ImportedRowIndex::commitPending()
+{
+    if (!_open()) {
+        return false;
+    }
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+    if (!db.transaction()) {
+        qWarning() << "Failed to start transaction:" << db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare(INSERT_IMPORTED_ROWS);
+    query.addBindValue(m_sourceKey);
+    if (!query.exec() || !query.exec(DELETE_PENDING_ROWS)) {
+        qWarning() << "Failed to record imported rows:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qWarning() << "Failed to commit imported rows:" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void ImportedRowIndex::clearPending()
+{
+    if (_open()) {
+        _exec(DELETE_PENDING_ROWS);
+    }
+}
+
+bool ImportedRowIndex::clear()
+{
+    if (!_open() || !_exec(DELETE_PENDING_ROWS)) {
+        return false;
+    }
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare(DELETE_IMPORTED_ROWS);
+    query.addBindValue(m_sourceKey);
+    if (!query.exec()) {
+        qWarning() << "Failed to clear imported rows:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ImportedRowIndex::_open()
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        return QSqlDatabase::database(m_connectionName, false).isOpen();
+    }
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_filePathDb);
+    if (!db.open()) {
+        qWarning() << "Failed to open database:" << db.lastError().text();
+        return false;
+    }
+    return _exec("PRAGMA journal_mode = WAL") && _exec("PRAGMA temp_store = FILE")
+            && _exec(CREATE_TABLE_IMPORTED_ROWS) && _exec(CREATE_TABLE_PENDING_ROWS);
+}
+
+bool ImportedRowIndex::_exec(const QString &sql)
+{
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    if (!query.exec(sql)) {
+        qWarning() << "Failed to execute" << sql << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
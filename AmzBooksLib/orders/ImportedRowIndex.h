@@ -0,0 +1,47 @@
+#ifndef IMPORTEDROWINDEX_H
+#define IMPORTEDROWINDEX_H
+
+#include <QByteArrayView>
+#include <QDir>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+// ImportedRowIndex = fingerprints of the report rows already imported from an activity source, so that a report
+// overlapping the previous ones (renamed file, updated month) is imported by decoding its new rows only.
+// Stored in importer.db of the importer working directory, next to importer.ini: 8 bytes per row.
+// Nothing is loaded: the rows read are looked up by batches in the primary key, and the new ones are staged in a
+// temporary table (on disk) until the report is recorded as imported. An instance is used from a single thread,
+// each having its own connection.
+class ImportedRowIndex
+{
+public:
+    static constexpr qsizetype LOOKUP_BATCH_SIZE = 500; // Fingerprints bound per lookup query
+
+    // 64-bit FNV-1a of the fields: stable between runs and Qt versions, as it is stored
+    static qint64 fingerprint(const QList<QByteArrayView> &fields);
+
+    ImportedRowIndex(const QDir &workingDirectory, const QString &sourceKey);
+    ~ImportedRowIndex();
+    ImportedRowIndex(const ImportedRowIndex &) = delete;
+    ImportedRowIndex &operator=(const ImportedRowIndex &) = delete;
+
+    // The fingerprints among these of rows imported before, none if importer.db can't be read
+    QSet<qint64> imported(const QList<qint64> &fingerprints);
+    // Rows of the report being read, recorded as imported by commitPending() in one transaction
+    bool addPending(const QList<qint64> &fingerprints);
+    bool commitPending();
+    void clearPending();
+    // Forgets the rows imported from the source, for the orders recorded from them being removed
+    bool clear();
+
+private:
+    bool _open();
+    bool _exec(const QString &sql);
+
+    QString m_filePathDb;
+    QString m_sourceKey;
+    QString m_connectionName;
+};
+
+#endif // IMPORTEDROWINDEX_H
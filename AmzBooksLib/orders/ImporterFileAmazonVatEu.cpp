@@ -1,45 +1,35 @@
 #include "ImporterFileAmazonVatEu.h"
-#include "utils/CsvReader.h"
-#include <QFileInfo>
+#include "ClosedKeySet.h"
+#include "CsvStreamReader.h"
+#include "FieldDecoder.h"
+#include "ImportedRowIndex.h"
 #include <QDebug>
+#include <QThread>
+#include <QtConcurrent>
+#include <QCoroFuture>
 
-QString ImporterFileAmazonVatEu::getLabel() const
-{
-    return "Amazon EU VAT Report";
-}
-
-ActivitySource ImporterFileAmazonVatEu::getActivitySource() const
-{
-    return {ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
-}
-
-QMap<QString, AbstractImporter::ParamInfo> ImporterFileAmazonVatEu::getRequiredParams() const
-{
-    return {};
-}
-
-QString ImporterFileAmazonVatEu::getUniqueReportId(const QString &filePath) const
-{
-    // Amazon VAT reports don't have a unique ID inside clearly, so we use filename
-    // or we could hash content, but filename is usually unique enough per month
-    return QFileInfo(filePath).fileName();
-}
-
-QCoro::Task<AbstractImporter::ReturnOrderInfos> ImporterFileAmazonVatEu::_loadReport(const QString &filePath)
-{
-    AbstractImporter::ReturnOrderInfos result;
-    result.orderInfos = QSharedPointer<AbstractImporter::OrderInfos>::create();
-
-    CsvReader reader(filePath, ",", "\"", true, "\n", 0, "UTF-8");
-    if (!reader.readAll()) {
-        result.errorReturned = "Failed to read CSV file: " + filePath;
-        co_return result;
-    }
-
-    const auto *dataRode = reader.dataRode();
+namespace {
+    // Indexes of the columns of a report, -1 when missing
+    struct Columns {
+        int transType = -1;
+        int date = -1;
+        int taxCalcDate = -1;
+        int taxCountry = -1;
+        int currency = -1;
+        int marketplace = -1;
+        int eventId = -1;
+        int totalVat = -1;
+        int totalExcl = -1;
+        int invNumber = -1;
+        int invUrl = -1;
+        int depart = -1;
+        int arrival = -1;
+        int taxScheme = -1;
+        int taxCollectionResp = -1;
+        int activityId = -1;
+    };
 
-    // Required columns
-    QStringList requiredColumns = {
+    const QStringList REQUIRED_COLUMNS = {
         "TRANSACTION_TYPE",
         "PRICE_OF_ITEMS_VAT_RATE_PERCENT",
         "TRANSACTION_COMPLETE_DATE",
@@ -52,155 +42,214 @@ QCoro::Task<AbstractImporter::ReturnOrderInfos> ImporterFileAmazonVatEu::_loadRe
         "MARKETPLACE"
     };
 
-    for (const QString &col : requiredColumns) {
-         if (!dataRode->header.contains(col)) {
-             result.errorReturned = "Missing column: " + col;
-             co_return result;
-         }
-    }
+    // A SALE or REFUND row. activity is not set if the row can't be used (invalid date or activity)
+    struct ReportRow {
+        QString transType;
+        QString eventId;
+        QString marketplace;
+        QString invoiceNumber;
+        QString invoiceUrl;
+        QDate date;
+        std::optional<Activity> activity;
+    };
 
-    int indTransType = dataRode->header.pos("TRANSACTION_TYPE");
-    // int indVatRate = dataRode->header.pos("PRICE_OF_ITEMS_VAT_RATE_PERCENT"); // Unused variable
-    int indDate = dataRode->header.pos("TRANSACTION_COMPLETE_DATE");
-    int indTaxCalcDate = dataRode->header.pos("TAX_CALCULATION_DATE"); 
-    int indTaxCountry = dataRode->header.pos("VAT_CALCULATION_IMPUTATION_COUNTRY");
-    int indPtCode = dataRode->header.pos("PRODUCT_TAX_CODE");
-    int indCurrency = dataRode->header.pos("TRANSACTION_CURRENCY_CODE");
-    int indMarketplace = dataRode->header.pos("MARKETPLACE");
-    
-    int indEventId = -1;
-    if (dataRode->header.contains("TRANSACTION_EVENT_ID")) indEventId = dataRode->header.pos("TRANSACTION_EVENT_ID");
-    else if (dataRode->header.contains("ORDER_ID")) indEventId = dataRode->header.pos("ORDER_ID");
-
-    // Amounts
-    int indPriceExcl = dataRode->header.pos("PRICE_OF_ITEMS_AMT_VAT_EXCL");
-    int indTotalVat = dataRode->header.pos("TOTAL_ACTIVITY_VALUE_VAT_AMT"); // Total VAT for the line? NO, standard says TOTAL_ACTIVITY_VALUE_VAT_AMT is total VAT amount.
-    // Wait, let's double check columns. 
-    // PRICE_OF_ITEMS_AMT_VAT_EXCL + SHIP_CHARGE... + GIFT...
-    // To simplify we might just take TOTAL_ACTIVITY_VALUE_AMT_VAT_INCL and TOTAL_ACTIVITY_VALUE_AMT_VAT_EXCL if available
-    // int indTotalIncl = dataRode->header.pos("TOTAL_ACTIVITY_VALUE_AMT_VAT_INCL"); // Unused if we calculate from Excl + Vat
-    int indTotalExcl = dataRode->header.pos("TOTAL_ACTIVITY_VALUE_AMT_VAT_EXCL");
-    
-    int indInvNumber = dataRode->header.pos("VAT_INV_NUMBER");
-    int indInvUrl = dataRode->header.pos("INVOICE_URL");
-
-    int indDepart = -1;
-    if (dataRode->header.contains("SALE_DEPART_COUNTRY")) indDepart = dataRode->header.pos("SALE_DEPART_COUNTRY");
-    else if (dataRode->header.contains("DEPARTURE_COUNTRY")) indDepart = dataRode->header.pos("DEPARTURE_COUNTRY");
-
-    int indArrival = -1;
-    if (dataRode->header.contains("SALE_ARRIVAL_COUNTRY")) indArrival = dataRode->header.pos("SALE_ARRIVAL_COUNTRY");
-    else if (dataRode->header.contains("ARRIVAL_COUNTRY")) indArrival = dataRode->header.pos("ARRIVAL_COUNTRY");
-
-    // int indBuyerTax = -1; // Unused
-    // if (dataRode->header.contains("BUYER_VAT_NUMBER")) indBuyerTax = dataRode->header.pos("BUYER_VAT_NUMBER");
-    
-    int indTaxScheme = dataRode->header.pos("TAX_REPORTING_SCHEME");
-    int indTaxCollectionResp = dataRode->header.pos("TAX_COLLECTION_RESPONSIBILITY");
-
-    // int indSellerSku = dataRode->header.pos("SELLER_SKU"); // Unused
-    // int indAsin = dataRode->header.pos("ASIN"); // Unused
-    int indActivityId = dataRode->header.pos("ACTIVITY_TRANSACTION_ID"); // Unique ID per line
-
-    // Temporary map to aggregate items by Shipment ID
+    // Activities of a shipment or refund being read, the rows of an event id and transaction type
     struct TempShipment {
         QString type; // SALE or REFUND
         QList<Activity> activities;
         QString invoiceNumber;
         QString invoiceUrl;
         QDate date;
+        qint64 lastRowNumber = 0;
+        QList<qint64> rowOffsets; // Of the rows of activities
+        // Rows imported before, only decoded if the event has new rows (type is empty while it has none)
+        QList<qint64> knownRowOffsets;
     };
-    QMap<QString, TempShipment> shipmentMap;
 
-    for (const auto &line : dataRode->lines) {
-        QString transType = line.value(indTransType);
-        if (transType != "SALE" && transType != "REFUND") continue;
+    // Reads the header, returning the missing required column (empty if none)
+    QString readHeader(CsvStreamReader &reader, Columns &columns)
+    {
+        QStringList header;
+        if (reader.readRecord()) {
+            for (qsizetype i = 0; i < reader.fields().size(); ++i) {
+                header << reader.fieldString(i);
+            }
+        }
+        for (const QString &col : REQUIRED_COLUMNS) {
+            if (!header.contains(col)) {
+                return col;
+            }
+        }
+        auto firstOf = [&header](const QStringList &names) {
+            for (const auto &name : names) {
+                const int index = header.indexOf(name);
+                if (index != -1) {
+                    return index;
+                }
+            }
+            return -1;
+        };
+        columns.transType = header.indexOf("TRANSACTION_TYPE");
+        columns.date = header.indexOf("TRANSACTION_COMPLETE_DATE");
+        columns.taxCalcDate = header.indexOf("TAX_CALCULATION_DATE");
+        columns.taxCountry = header.indexOf("VAT_CALCULATION_IMPUTATION_COUNTRY");
+        columns.currency = header.indexOf("TRANSACTION_CURRENCY_CODE");
+        columns.marketplace = header.indexOf("MARKETPLACE");
+        columns.eventId = firstOf({"TRANSACTION_EVENT_ID", "ORDER_ID"});
+        // TOTAL_ACTIVITY_VALUE_VAT_AMT is the total VAT of the line, the taxed amount is computed from the untaxed one
+        columns.totalVat = header.indexOf("TOTAL_ACTIVITY_VALUE_VAT_AMT");
+        columns.totalExcl = header.indexOf("TOTAL_ACTIVITY_VALUE_AMT_VAT_EXCL");
+        columns.invNumber = header.indexOf("VAT_INV_NUMBER");
+        columns.invUrl = header.indexOf("INVOICE_URL");
+        columns.depart = firstOf({"SALE_DEPART_COUNTRY", "DEPARTURE_COUNTRY"});
+        columns.arrival = firstOf({"SALE_ARRIVAL_COUNTRY", "ARRIVAL_COUNTRY"});
+        columns.taxScheme = header.indexOf("TAX_REPORTING_SCHEME");
+        columns.taxCollectionResp = header.indexOf("TAX_COLLECTION_RESPONSIBILITY");
+        columns.activityId = header.indexOf("ACTIVITY_TRANSACTION_ID"); // Unique ID per line
+        return QString();
+    }
+
+    const QString SALE = QStringLiteral("SALE");
+    const QString REFUND = QStringLiteral("REFUND");
+
+    // SALE and REFUND rows read ahead, so that their fingerprints are looked up in one query. The fields are
+    // copied, the ones of the reader being only valid until its next record
+    class RowWindow
+    {
+    public:
+        static constexpr qsizetype SIZE = ImportedRowIndex::LOOKUP_BATCH_SIZE;
+
+        // A row of the window, read as the current record of a CsvStreamReader
+        struct Row {
+            const RowWindow &window;
+            qsizetype index;
+
+            QByteArrayView field(qsizetype i) const
+            {
+                const qsizetype first = window.m_firstFields[index];
+                if (i < 0 || first + i >= window.m_firstFields[index + 1]) {
+                    return QByteArrayView();
+                }
+                const auto &bounds = window.m_fields[first + i];
+                return QByteArrayView(window.m_data.constData() + bounds.first, bounds.second);
+            }
+            QString fieldString(qsizetype i) const
+            {
+                return QString::fromUtf8(field(i));
+            }
+        };
 
-        QString eventId = (indEventId != -1) ? line.value(indEventId) : "";
-        if (eventId.isEmpty()) continue; // Should not happen for SALE/REFUND
+        void append(const CsvStreamReader &reader, const QString &mapKey, qint64 rowNumber)
+        {
+            for (const auto &field : reader.fields()) {
+                m_fields << qMakePair(m_data.size(), field.size());
+                m_data.append(field);
+            }
+            m_firstFields << m_fields.size();
+            offsets << reader.recordOffset();
+            fingerprints << ImportedRowIndex::fingerprint(reader.fields());
+            rowNumbers << rowNumber;
+            mapKeys << mapKey;
+        }
+        Row row(qsizetype index) const
+        {
+            return Row{*this, index};
+        }
+        qsizetype size() const
+        {
+            return offsets.size();
+        }
+        void clear()
+        {
+            m_data.clear();
+            m_fields.clear();
+            m_firstFields = {0};
+            offsets.clear();
+            fingerprints.clear();
+            rowNumbers.clear();
+            mapKeys.clear();
+        }
+
+        QList<qint64> offsets;
+        QList<qint64> fingerprints;
+        QList<qint64> rowNumbers;
+        QStringList mapKeys;
 
-        // Validation of eventId ? No, keep strict reading.
-        
-        QString marketplace = line.value(indMarketplace);
-        if (!marketplace.isEmpty()) {
-             result.orderInfos->orderId_store[eventId] = marketplace;
+    private:
+        QByteArray m_data;
+        QList<QPair<qsizetype, qsizetype>> m_fields; // Position in m_data and size
+        QList<qsizetype> m_firstFields{0}; // Index in m_fields of the first field of each row, then m_fields.size()
+    };
+
+    // Decodes the current record of a CsvStreamReader or a RowWindow::Row, returning false for the rows other
+    // than SALE and REFUND. Rows are read from the UTF-8 bytes, QString being only built for the values kept
+    template<typename Record>
+    bool readRow(const Record &reader, const Columns &columns, FieldDecoder &decoder, ReportRow &row)
+    {
+        const QByteArrayView transType = reader.field(columns.transType);
+        if (transType == QByteArrayView("SALE")) {
+            row.transType = SALE;
+        } else if (transType == QByteArrayView("REFUND")) {
+            row.transType = REFUND;
+        } else {
+            return false;
         }
+        const QByteArrayView eventId = reader.field(columns.eventId);
+        if (eventId.isEmpty()) {
+            return false; // Should not happen for SALE/REFUND
+        }
+        row.eventId = QString::fromUtf8(eventId);
+        row.marketplace = decoder.toSharedString(reader.field(columns.marketplace));
+        row.invoiceNumber = reader.fieldString(columns.invNumber);
+        row.invoiceUrl = reader.fieldString(columns.invUrl);
+        row.activity.reset();
 
         // Date priority: TAX_CALCULATION_DATE > TRANSACTION_COMPLETE_DATE
-        QString dateStr;
-        if (indTaxCalcDate != -1 && !line.value(indTaxCalcDate).isEmpty()) {
-            dateStr = line.value(indTaxCalcDate);
-        } else {
-            dateStr = line.value(indDate);
-        }
-        QDate date = QDate::fromString(dateStr, "dd-MM-yyyy");
-        if (!date.isValid()) date = QDate::fromString(dateStr, "dd/MM/yyyy");
-        if (!date.isValid()) date = QDate::fromString(dateStr, "yyyy-MM-dd"); // From test_vat_rate
-        if (!date.isValid()) {
-             // Fallback or skip?
-             continue; 
-        }
-
-        // Update range
-        if (result.orderInfos->dateMin.isNull() || date < result.orderInfos->dateMin) result.orderInfos->dateMin = date;
-        if (result.orderInfos->dateMax.isNull() || date > result.orderInfos->dateMax) result.orderInfos->dateMax = date;
-
-        // Amounts
-        // double amountIncl = line.value(indTotalIncl).toDouble(); // Unused
-        double amountExcl = line.value(indTotalExcl).toDouble();
-        double amountVat = line.value(indTotalVat).toDouble();
-
-        // If refund, amounts might be negative or positive depending on report style.
-        // In checked reports (test_vat_rate), Refund amounts are negative. 
-        // We probably want absolute values for Amount object, or strictly following Activity convention.
-        // Activity Amount checks: untaxed + taxes = taxed. 
-        // Let's keep signs as is for now, Activity should handle signed amounts.
-        
-        QString currency = line.value(indCurrency);
-        QString depart = (indDepart != -1) ? line.value(indDepart) : "";
-        QString arrival = (indArrival != -1) ? line.value(indArrival) : "";
-        QString vatPaidTo = line.value(indTaxCountry);
+        QByteArrayView dateField = reader.field(columns.taxCalcDate);
+        if (dateField.isEmpty()) {
+            dateField = reader.field(columns.date);
+        }
+        row.date = decoder.toDate(dateField); // dd-MM-yyyy, dd/MM/yyyy or yyyy-MM-dd (test_vat_rate)
+        if (!row.date.isValid()) {
+            return true;
+        }
+
+        // Signs are kept as is: refund amounts are negative in the reports
+        double amountExcl = FieldDecoder::toDouble(reader.field(columns.totalExcl));
+        double amountVat = FieldDecoder::toDouble(reader.field(columns.totalVat));
+
+        QString currency = decoder.toSharedString(reader.field(columns.currency));
+        QString depart = decoder.toSharedString(reader.field(columns.depart));
+        QString arrival = decoder.toSharedString(reader.field(columns.arrival));
+        QString vatPaidTo = decoder.toSharedString(reader.field(columns.taxCountry));
         if (arrival.isEmpty()) arrival = vatPaidTo; // Fallback
-        
-        // Tax Scheme mapping
-        // Logic similar to test_vat_rate could be useful but here we rely on columns if possible
-        // Or we infer. 
-        // For now, let's map what we have.
+
+        // Tax Scheme mapping from the columns when possible, inferred from the countries otherwise
         TaxScheme scheme = TaxScheme::Unknown;
-        QString taxResp = line.value(indTaxCollectionResp); // MARKETPLACE or SELLER
-        QString schemeStr = line.value(indTaxScheme); // UNION-OSS, REGULAR, etc.
+        const QByteArrayView taxResp = reader.field(columns.taxCollectionResp); // MARKETPLACE or SELLER
+        const QByteArrayView schemeStr = reader.field(columns.taxScheme); // UNION-OSS, REGULAR, etc.
 
-        if (taxResp == "MARKETPLACE") scheme = TaxScheme::MarketplaceDeemedSupplier;
-        else if (schemeStr == "UNION-OSS") scheme = TaxScheme::EuOssUnion;
+        if (taxResp == QByteArrayView("MARKETPLACE")) scheme = TaxScheme::MarketplaceDeemedSupplier;
+        else if (schemeStr == QByteArrayView("UNION-OSS")) scheme = TaxScheme::EuOssUnion;
         else {
-             // Fallback logic could be complex (Export, Domestic, etc.)
-             // For now defaults to Unknown or infer from country
              if (depart == arrival) scheme = TaxScheme::DomesticVat;
              else if (!depart.isEmpty() && !arrival.isEmpty() && depart != arrival) scheme = TaxScheme::EuOssUnion; // Simplification?
         }
 
-        TaxSource taxSource = TaxSource::MarketplaceProvided;
-        QString ptCode = line.value(indPtCode);
-        (void)ptCode; // Unused for now
-
-        // Activity ID
-        QString actId = line.value(indActivityId);
-        
-        // Create Activity
+        // Amount takes (Taxed, Tax): taxed is built from the untaxed column to stay consistent with it
         Amount amt(amountExcl + amountVat, amountVat);
-        // Note: Amount constructor takes (Taxed, Tax). We construct Taxed from Excl+Vat to ensure consistency with Excl column. 
-        
+
         auto actRes = Activity::create(
-            eventId,
-            actId,
+            row.eventId,
+            reader.fieldString(columns.activityId),
             "", // subId
-            date.startOfDay(),
+            row.date.startOfDay(),
             currency,
             depart,
             arrival,
             vatPaidTo,
             amt,
-            taxSource,
+            TaxSource::MarketplaceProvided,
             vatPaidTo, // Declaring country usually same as vatPaidTo in these reports
             scheme,
             TaxJurisdictionLevel::Country,
@@ -208,64 +257,436 @@ QCoro::Task<AbstractImporter::ReturnOrderInfos> ImporterFileAmazonVatEu::_loadRe
         );
 
         if (!actRes.ok()) {
-             qCritical() << "Failed to create activity:" << (actRes.errors.isEmpty() ? "Unknown error" : actRes.errors.first().message) << " EventID:" << eventId << " Type:" << transType;
-             continue;
-        }
-        
-        // Use composite key to separate Sales and Refunds if they share the same EventID
-        QString mapKey = eventId + "_" + transType;
-        TempShipment &ts = shipmentMap[mapKey];
-        ts.type = transType;
-        ts.date = date;
-        ts.activities.append(actRes.value.value());
-        ts.invoiceNumber = line.value(indInvNumber);
-        if (indInvUrl != -1) ts.invoiceUrl = line.value(indInvUrl);
+             qCritical() << "Failed to create activity:" << (actRes.errors.isEmpty() ? "Unknown error" : actRes.errors.first().message) << " EventID:" << row.eventId << " Type:" << row.transType;
+             return true;
+        }
+        row.activity = std::move(actRes.value);
+        return true;
+    }
+
+    // Event id and transaction type of a SALE or REFUND row, empty for the other rows
+    QString shipmentKey(const CsvStreamReader &reader, const Columns &columns)
+    {
+        const QByteArrayView transType = reader.field(columns.transType);
+        const QByteArrayView eventId = reader.field(columns.eventId);
+        if ((transType != QByteArrayView("SALE") && transType != QByteArrayView("REFUND")) || eventId.isEmpty()) {
+            return QString();
+        }
+        return QString::fromUtf8(eventId) + "_" + QString::fromUtf8(transType);
+    }
+
+    void updateDateRange(AbstractImporter::OrderInfos &orderInfos, const QDate &date)
+    {
+        if (orderInfos.dateMin.isNull() || date < orderInfos.dateMin) orderInfos.dateMin = date;
+        if (orderInfos.dateMax.isNull() || date > orderInfos.dateMax) orderInfos.dateMax = date;
+    }
+
+    void addToShipment(TempShipment &ts, ReportRow &row, qint64 rowNumber, qint64 rowOffset)
+    {
+        ts.rowOffsets << rowOffset;
+        ts.type = row.transType;
+        ts.date = row.date;
+        ts.activities.append(std::move(*row.activity));
+        ts.invoiceNumber = row.invoiceNumber;
+        ts.invoiceUrl = row.invoiceUrl;
+        ts.lastRowNumber = rowNumber;
+    }
+
+    // An event with new rows is read again with the rows imported before, so that it is the same as in a whole
+    // import (an event with part of its activities would be seen as a revision of the shipment)
+    void addKnownRows(CsvStreamReader &reader, const Columns &columns, TempShipment &ts)
+    {
+        QList<qint64> offsets = ts.rowOffsets + ts.knownRowOffsets;
+        std::sort(offsets.begin(), offsets.end());
+        TempShipment rebuilt;
+        rebuilt.lastRowNumber = ts.lastRowNumber;
+        FieldDecoder decoder;
+        ReportRow row;
+        for (qint64 offset : std::as_const(offsets)) {
+            if (reader.open(offset, offset + 1) && reader.readRecord()
+                    && readRow(reader, columns, decoder, row) && row.activity) {
+                addToShipment(rebuilt, row, ts.lastRowNumber, offset);
+            }
+        }
+        ts = std::move(rebuilt);
+    }
+
+    // Shipments of the rows of a byte range of the report, grouped by event id and transaction type.
+    // The composite key separates Sales and Refunds sharing the same EventID
+    struct ChunkShipments {
+        QMap<QString, TempShipment> shipmentMap;
+        QHash<QString, QString> orderId_store;
+        QDate dateMin;
+        QDate dateMax;
+        QList<qint64> newRowFingerprints; // Only for a chunk read on another thread
+        ContentHash contentHash; // Of the byte range, only for a chunk read on another thread
+        QString errorReturned;
+    };
+
+    // The new rows are staged in importedRows as they are read, or kept in chunk.newRowFingerprints when
+    // stageNewRows is false (importedRows being then another connection than the one of the import)
+    void readChunk(CsvStreamReader &reader, const Columns &columns, ImportedRowIndex &importedRows,
+                   ChunkShipments &chunk, bool stageNewRows)
+    {
+        FieldDecoder decoder;
+        ReportRow row;
+        RowWindow window;
+        auto readWindow = [&]() {
+            const QSet<qint64> imported = importedRows.imported(window.fingerprints);
+            QList<qint64> newRowFingerprints;
+            for (qsizetype i = 0; i < window.size(); ++i) {
+                if (imported.contains(window.fingerprints[i])) {
+                    chunk.shipmentMap[window.mapKeys[i]].knownRowOffsets << window.offsets[i];
+                    continue;
+                }
+                newRowFingerprints << window.fingerprints[i];
+                readRow(window.row(i), columns, decoder, row);
+                if (!row.marketplace.isEmpty()) {
+                    chunk.orderId_store[row.eventId] = row.marketplace;
+                }
+                if (!row.date.isValid()) {
+                    continue;
+                }
+                if (chunk.dateMin.isNull() || row.date < chunk.dateMin) chunk.dateMin = row.date;
+                if (chunk.dateMax.isNull() || row.date > chunk.dateMax) chunk.dateMax = row.date;
+                if (!row.activity) {
+                    continue;
+                }
+                addToShipment(chunk.shipmentMap[window.mapKeys[i]], row, 0, window.offsets[i]);
+            }
+            if (stageNewRows) {
+                importedRows.addPending(newRowFingerprints);
+            } else {
+                chunk.newRowFingerprints << newRowFingerprints;
+            }
+            window.clear();
+        };
+        while (reader.readRecord()) {
+            const QString mapKey = shipmentKey(reader, columns);
+            if (mapKey.isEmpty()) {
+                continue;
+            }
+            window.append(reader, mapKey, 0);
+            if (window.size() == RowWindow::SIZE) {
+                readWindow();
+            }
+        }
+        readWindow();
+        if (!reader.errorString().isEmpty()) {
+            chunk.errorReturned = "Failed to read CSV file: " + reader.errorString();
+        }
+    }
+
+    // Appends the rows of the following chunk, as if they had been read after the ones of chunk
+    void mergeChunk(ChunkShipments &chunk, ChunkShipments &&nextChunk)
+    {
+        for (auto it = nextChunk.shipmentMap.begin(); it != nextChunk.shipmentMap.end(); ++it) {
+            auto existing = chunk.shipmentMap.find(it.key());
+            if (existing == chunk.shipmentMap.end()) {
+                chunk.shipmentMap.insert(it.key(), std::move(it.value()));
+                continue;
+            }
+            TempShipment &ts = existing.value();
+            ts.knownRowOffsets << it.value().knownRowOffsets;
+            if (it.value().activities.isEmpty()) {
+                continue;
+            }
+            // Last row wins, as in a single read
+            ts.activities << std::move(it.value().activities);
+            ts.rowOffsets << it.value().rowOffsets;
+            ts.type = it.value().type;
+            ts.date = it.value().date;
+            ts.invoiceNumber = it.value().invoiceNumber;
+            ts.invoiceUrl = it.value().invoiceUrl;
+        }
+        chunk.orderId_store.insert(nextChunk.orderId_store);
+        if (nextChunk.dateMin.isValid() && (chunk.dateMin.isNull() || nextChunk.dateMin < chunk.dateMin)) {
+            chunk.dateMin = nextChunk.dateMin;
+        }
+        if (nextChunk.dateMax.isValid() && (chunk.dateMax.isNull() || nextChunk.dateMax > chunk.dateMax)) {
+            chunk.dateMax = nextChunk.dateMax;
+        }
     }
-    
-    // Convert TempShipment to Shipment/Refund
-    for (auto it = shipmentMap.begin(); it != shipmentMap.end(); ++it) {
-        QString eventId = it.key();
-        TempShipment &ts = it.value();
-        
-        // Aggregate items for InvoicingInfo
-        // We need to create LineItems. But ImporterFileAmazonVatEu requirements were just "Activity".
-        // However, InvoicingInfo needs LineItems.
-        // Wait, AbstractImporter::OrderInfos has shipments and refunds.
-        // Shipment takes List<Activity>.
-        // InvoicingInfo takes Shipment + LineItems.
-        
-        // We didn't parse Line Item details (Title, etc) in the loop above fully (only Sku/Asin available but not mapped to Activity directly).
-        // Activity doesn't hold SKU/Title.
-        // So we need to create LineItems separately if we want InvoicingInfo.
-        // But AbstractImporterFile::loadReport returns ReturnOrderInfos which contains OrderInfos.
-        // OrderInfos contains shipments, refunds, invoicingInfos.
-        
-        // We didn't explicitly demand full LineItem details (Title), but generally good for Invoice.
-        
-        // To do this properly, we should have stored Line Item data in TempShipment.
-        // Let's assume for now we just populate Shipments/Refunds with Activities. 
-        // If InvoicingInfo is required (likely yes for "Importer"), we populate it with basic info.
-        
+
+    // Converts the activities of an event id and transaction type (mapKey) to a Shipment or Refund.
+    // Line item details (title...) are not in the report, so InvoicingInfo only holds the activities
+    void appendShipment(AbstractImporter::OrderInfos &orderInfos, const QString &mapKey, const TempShipment &ts)
+    {
         if (ts.type == "SALE") {
-            Shipment shipment(ts.activities);
-            result.orderInfos->shipments.append(shipment);
-            
-            // Basic InvoicingInfo
-            InvoicingInfo info(&result.orderInfos->shipments.last());
-            // We can set Invoice Number
-            // We don't have detailed line items (description) easily unless we map them.
-            // Let's create dummy LineItems from activities if needed or just skip detailed items if acceptable.
-            
-            result.orderInfos->invoicingInfos.append({eventId, info});
+            orderInfos.shipments.append(Shipment(ts.activities));
+            InvoicingInfo info(&orderInfos.shipments.last());
+            orderInfos.invoicingInfos.append({mapKey, info});
         } else if (ts.type == "REFUND") {
-            Refund refund(ts.activities);
-            result.orderInfos->refunds.append(refund);
-            
-             // Refunds also have InvoicingInfo? yes.
-            InvoicingInfo info(&result.orderInfos->refunds.last());
-            result.orderInfos->invoicingInfos.append({eventId, info});
+            orderInfos.refunds.append(Refund(ts.activities));
+            InvoicingInfo info(&orderInfos.refunds.last());
+            orderInfos.invoicingInfos.append({mapKey, info});
         }
     }
+}
+
+QString ImporterFileAmazonVatEu::getLabel() const
+{
+    return "Amazon EU VAT Report";
+}
+
+ActivitySource ImporterFileAmazonVatEu::getActivitySource() const
+{
+    return {ActivitySourceType::Report, "Amazon", "Amazon EU", "VAT Report"};
+}
+
+QMap<QString, AbstractImporter::ParamInfo> ImporterFileAmazonVatEu::getRequiredParams() const
+{
+    return {};
+}
+
+void ImporterFileAmazonVatEu::setParsingThreadCount(int threadCount)
+{
+    m_parsingThreadCount = qMax(0, threadCount);
+}
+
+QCoro::Task<AbstractImporter::ReturnOrderInfos> ImporterFileAmazonVatEu::_loadReport(const QString &filePath)
+{
+    AbstractImporter::ReturnOrderInfos result;
+    result.orderInfos = QSharedPointer<AbstractImporter::OrderInfos>::create();
+
+    CsvStreamReader reader(filePath);
+    reader.enableContentHash();
+    if (!reader.open()) {
+        result.errorReturned = "Failed to read CSV file: " + filePath;
+        co_return result;
+    }
+    Columns columns;
+    const QString missingColumn = readHeader(reader, columns);
+    if (!missingColumn.isEmpty()) {
+        result.errorReturned = "Missing column: " + missingColumn;
+        co_return result;
+    }
+    co_await _checkReportHead(reader.contentHash().headHash());
+
+    int threadCount = m_parsingThreadCount;
+    if (threadCount == 0) {
+        threadCount = reader.fileSize() < PARALLEL_MIN_FILE_SIZE ? 1 : QThread::idealThreadCount();
+    }
+    // Rows of the previous imports are only read again for the events with new rows
+    ImportedRowIndex &importedRows = _importedRowIndex();
+    ChunkShipments shipments;
+    if (threadCount <= 1) {
+        readChunk(reader, columns, importedRows, shipments, true);
+        _setReportHash(reader.contentHash().result());
+    } else {
+        // Rows are independent until grouped: byte ranges are read on all cores, then merged in file order.
+        // Each range is hashed by its reader, the hashes being appended to the one of the header buffer
+        ContentHash contentHash = reader.contentHash();
+        const QList<qint64> boundaries = CsvStreamReader::splitRecords(filePath, reader.pos(), threadCount);
+        if (boundaries.isEmpty()) {
+            result.errorReturned = "Failed to read CSV file: " + filePath;
+            co_return result;
+        }
+        QList<QPair<qint64, qint64>> ranges;
+        for (qsizetype i = 1; i < boundaries.size(); ++i) {
+            ranges << qMakePair(boundaries[i - 1], boundaries[i]);
+        }
+        QFuture<ChunkShipments> future = QtConcurrent::mapped(
+                    ranges, [this, filePath, columns](const QPair<qint64, qint64> &range) {
+            ChunkShipments chunk;
+            CsvStreamReader chunkReader(filePath);
+            chunkReader.enableContentHash();
+            if (!chunkReader.open(range.first, range.second)) {
+                chunk.errorReturned = "Failed to read CSV file: " + chunkReader.errorString();
+                return chunk;
+            }
+            // A connection per thread, the new rows being staged by the import connection
+            const QSharedPointer<ImportedRowIndex> chunkImportedRows = _createImportedRowIndex();
+            readChunk(chunkReader, columns, *chunkImportedRows, chunk, false);
+            chunk.contentHash = chunkReader.contentHash();
+            return chunk;
+        });
+        co_await qCoro(future).waitForFinished();
+        QList<ChunkShipments> chunks = future.results(); // In the order of the ranges
+        for (auto &chunk : chunks) {
+            if (!chunk.errorReturned.isEmpty()) {
+                shipments.errorReturned = chunk.errorReturned;
+                break;
+            }
+            importedRows.addPending(chunk.newRowFingerprints);
+            chunk.newRowFingerprints.clear();
+            contentHash.append(chunk.contentHash);
+            mergeChunk(shipments, std::move(chunk));
+        }
+        _setReportHash(contentHash.result());
+    }
+    if (!shipments.errorReturned.isEmpty()) {
+        result.errorReturned = shipments.errorReturned;
+        co_return result;
+    }
+
+    for (auto it = shipments.shipmentMap.begin(); it != shipments.shipmentMap.end(); ++it) {
+        if (!it.value().knownRowOffsets.isEmpty() && !it.value().activities.isEmpty()) {
+            addKnownRows(reader, columns, it.value());
+        }
+    }
+
+    result.orderInfos->orderId_store = std::move(shipments.orderId_store);
+    result.orderInfos->dateMin = shipments.dateMin;
+    result.orderInfos->dateMax = shipments.dateMax;
+    for (auto it = shipments.shipmentMap.cbegin(); it != shipments.shipmentMap.cend(); ++it) {
+        appendShipment(*result.orderInfos, it.key(), it.value());
+    }
+
+    co_return result;
+}
+
+QCoro::Task<AbstractImporter::ReturnOrderInfos> ImporterFileAmazonVatEu::_loadReportStreamed(
+        const QString &filePath, std::function<void(OrderInfos &&)> orderInfosCallback)
+{
+    AbstractImporter::ReturnOrderInfos result;
+    result.orderInfos = QSharedPointer<AbstractImporter::OrderInfos>::create();
+
+    CsvStreamReader reader(filePath);
+    reader.enableContentHash();
+    if (!reader.open()) {
+        result.errorReturned = "Failed to read CSV file: " + filePath;
+        co_return result;
+    }
+    Columns columns;
+    const QString missingColumn = readHeader(reader, columns);
+    if (!missingColumn.isEmpty()) {
+        result.errorReturned = "Missing column: " + missingColumn;
+        co_return result;
+    }
+    co_await _checkReportHead(reader.contentHash().headHash());
+
+    // Amazon writes the rows of an event one after the other: a group no row was added to during the last
+    // STREAM_CLOSE_DISTANCE rows is complete and passed downstream. The keys of the groups passed are kept in a
+    // ClosedKeySet, of fixed memory, to detect an event whose rows are further apart
+    QHash<QString, TempShipment> openShipments;
+    ClosedKeySet closedKeys;
+    auto openShipment = [&openShipments, &closedKeys](const QString &mapKey) -> TempShipment * {
+        auto it = openShipments.find(mapKey);
+        if (it == openShipments.end()) {
+            if (closedKeys.contains(mapKey)) {
+                return nullptr;
+            }
+            it = openShipments.insert(mapKey, TempShipment());
+        }
+        return &it.value();
+    };
+    ImportedRowIndex &importedRows = _importedRowIndex();
+    CsvStreamReader knownRowsReader(filePath);
+    AbstractImporter::OrderInfos batch;
+    auto flushBatch = [&batch, &orderInfosCallback]() {
+        if (!batch.shipments.isEmpty() || !batch.refunds.isEmpty() || !batch.orderId_store.isEmpty()) {
+            orderInfosCallback(std::move(batch));
+            batch = AbstractImporter::OrderInfos();
+        }
+    };
+    auto closeShipments = [&](qint64 untilRowNumber) {
+        QStringList keysToClose;
+        for (auto it = openShipments.cbegin(); it != openShipments.cend(); ++it) {
+            if (it.value().lastRowNumber <= untilRowNumber) {
+                keysToClose << it.key();
+            }
+        }
+        keysToClose.sort(); // Same order as the whole report import
+        for (const auto &key : std::as_const(keysToClose)) {
+            TempShipment ts = openShipments.take(key);
+            if (!ts.knownRowOffsets.isEmpty() && !ts.activities.isEmpty()) {
+                addKnownRows(knownRowsReader, columns, ts);
+            }
+            appendShipment(batch, key, ts);
+        }
+        closedKeys.add(keysToClose);
+        if (batch.shipments.size() + batch.refunds.size() >= STREAM_BATCH_SIZE) {
+            flushBatch();
+        }
+    };
+
+    auto rowsApartError = [](const QString &mapKey) {
+        return QString("Rows of event %1 are more than %2 rows apart, import the report without streaming")
+                .arg(mapKey, QString::number(STREAM_CLOSE_DISTANCE));
+    };
+
+    // The rows are processed by windows, in file order: a group is closed at the first row read after the
+    // STREAM_CLOSE_DISTANCE rows following its last one, the rows in between not being SALE or REFUND rows
+    qint64 nextCloseRowNumber = STREAM_CLOSE_DISTANCE;
+    auto closeShipmentsBefore = [&](qint64 rowNumber) {
+        while (rowNumber >= nextCloseRowNumber) {
+            closeShipments(nextCloseRowNumber - STREAM_CLOSE_DISTANCE);
+            nextCloseRowNumber += STREAM_CLOSE_DISTANCE;
+        }
+    };
+    FieldDecoder decoder;
+    ReportRow row;
+    RowWindow window;
+    // Error message, empty if none
+    auto readWindow = [&]() -> QString {
+        const QSet<qint64> imported = importedRows.imported(window.fingerprints);
+        QList<qint64> newRowFingerprints;
+        for (qsizetype i = 0; i < window.size(); ++i) {
+            const qint64 rowNumber = window.rowNumbers[i];
+            closeShipmentsBefore(rowNumber);
+            const QString &mapKey = window.mapKeys[i];
+            if (imported.contains(window.fingerprints[i])) {
+                TempShipment *ts = openShipment(mapKey);
+                if (!ts) {
+                    return rowsApartError(mapKey);
+                }
+                ts->knownRowOffsets << window.offsets[i];
+                ts->lastRowNumber = rowNumber;
+                continue;
+            }
+            newRowFingerprints << window.fingerprints[i];
+            readRow(window.row(i), columns, decoder, row);
+            if (!row.marketplace.isEmpty()) {
+                batch.orderId_store[row.eventId] = row.marketplace;
+            }
+            if (!row.date.isValid()) {
+                continue;
+            }
+            updateDateRange(*result.orderInfos, row.date);
+            if (!row.activity) {
+                continue;
+            }
+            TempShipment *ts = openShipment(mapKey);
+            if (!ts) {
+                return rowsApartError(mapKey);
+            }
+            addToShipment(*ts, row, rowNumber, window.offsets[i]);
+        }
+        importedRows.addPending(newRowFingerprints);
+        window.clear();
+        return QString();
+    };
+
+    qint64 rowNumber = 0;
+    while (reader.readRecord()) {
+        ++rowNumber;
+        const QString mapKey = shipmentKey(reader, columns);
+        if (mapKey.isEmpty()) {
+            continue;
+        }
+        window.append(reader, mapKey, rowNumber);
+        if (window.size() == RowWindow::SIZE) {
+            const QString error = readWindow();
+            if (!error.isEmpty()) {
+                result.errorReturned = error;
+                co_return result;
+            }
+        }
+    }
+    const QString error = readWindow();
+    if (!error.isEmpty()) {
+        result.errorReturned = error;
+        co_return result;
+    }
+    if (!reader.errorString().isEmpty()) {
+        result.errorReturned = "Failed to read CSV file: " + reader.errorString();
+        co_return result;
+    }
+    _setReportHash(reader.contentHash().result());
+    closeShipmentsBefore(rowNumber);
+    closeShipments(rowNumber);
+    flushBatch();
 
     co_return result;
 }
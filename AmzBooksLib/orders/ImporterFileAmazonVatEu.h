@@ -6,16 +6,30 @@
 class ImporterFileAmazonVatEu : public AbstractImporterFile
 {
 public:
+    // Streamed import: rows after which an event with no new row is complete, and shipments per batch
+    static constexpr qint64 STREAM_CLOSE_DISTANCE = 10000;
+    static constexpr qsizetype STREAM_BATCH_SIZE = 1000;
+    // Smaller reports are read on the calling thread, splitting them costing more than it saves
+    static constexpr qint64 PARALLEL_MIN_FILE_SIZE = 16 << 20;
+
     using AbstractImporterFile::AbstractImporterFile;
 
     QString getLabel() const override;
     ActivitySource getActivitySource() const override;
     QMap<QString, ParamInfo> getRequiredParams() const override;
-    
-    QString getUniqueReportId(const QString &filePath) const override;
+
+    // Threads reading the report in loadReport, by byte ranges merged in file order so that the result is the
+    // same as a single read. 0 (default) uses all cores for reports of PARALLEL_MIN_FILE_SIZE or more.
+    // loadReportStreamed always reads on one thread, in file order
+    void setParsingThreadCount(int threadCount);
 
 protected:
     QCoro::Task<ReturnOrderInfos> _loadReport(const QString &filePath) override;
+    QCoro::Task<ReturnOrderInfos> _loadReportStreamed(
+            const QString &filePath, std::function<void(OrderInfos &&)> orderInfosCallback) override;
+
+private:
+    int m_parsingThreadCount = 0;
 };
 
 #endif // IMPORTERFILEAMAZONVATEU_H
@@ -2,6 +2,9 @@
 #include "Shipment.h"
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QCborArray>
+#include <QCborValue>
+#include <QDebug>
 
 InvoicingInfo::InvoicingInfo(
         const Shipment *shipmentOrRefund
@@ -126,3 +129,42 @@ InvoicingInfo InvoicingInfo::fromJson(const QJsonObject &json)
     // Create with null shipment, we just hold data
     return InvoicingInfo(nullptr, items, number, link);
 }
+
+QByteArray InvoicingInfo::toCbor() const
+{
+    QCborArray items;
+    for (const auto &item : m_items) {
+        items.append(item.toCbor());
+    }
+    return QCborValue(QCborArray{
+        CBOR_VERSION,
+        m_invoiceNumber ? QCborValue(*m_invoiceNumber) : QCborValue(QCborValue::Null),
+        m_invoiceLink ? QCborValue(*m_invoiceLink) : QCborValue(QCborValue::Null),
+        items
+    }).toCbor(QCborValue::UseFloat | QCborValue::UseFloat16);
+}
+
+InvoicingInfo InvoicingInfo::fromCbor(const QByteArray &data)
+{
+    const QCborArray cbor = QCborValue::fromCbor(data).toArray();
+    if (cbor.at(0).toInteger() != CBOR_VERSION) {
+        qWarning() << "Unsupported invoicing info encoding version:" << cbor.at(0).toInteger();
+        return InvoicingInfo(nullptr);
+    }
+
+    std::optional<QString> number;
+    if (cbor.at(1).isString()) number = cbor.at(1).toString();
+
+    std::optional<QString> link;
+    if (cbor.at(2).isString()) link = cbor.at(2).toString();
+
+    QList<LineItem> items;
+    const QCborArray itemsArr = cbor.at(3).toArray();
+    items.reserve(itemsArr.size());
+    for (const auto &val : itemsArr) {
+        items.append(LineItem::fromCbor(val.toArray()));
+    }
+
+    // Create with null shipment, we just hold data
+    return InvoicingInfo(nullptr, items, number, link);
+}
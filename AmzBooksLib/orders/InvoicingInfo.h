@@ -24,6 +24,12 @@ public:
     QJsonObject toJson() const;
     static InvoicingInfo fromJson(const QJsonObject &json);
 
+    // Compact binary encoding stored in Orders.db: [CBOR_VERSION, invoiceNumber, invoiceLink, [items]],
+    // a missing number / link being null
+    static constexpr int CBOR_VERSION = 1;
+    QByteArray toCbor() const;
+    static InvoicingInfo fromCbor(const QByteArray &data);
+
 private:
     void adjustItemTaxes(const QList<Activity> &activities);
     QList<LineItem> m_items;
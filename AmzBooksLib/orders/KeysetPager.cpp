@@ -0,0 +1,94 @@
+#include "KeysetPager.h"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlRecord>
+
+KeysetPager::KeysetPager(const QSqlDatabase &db,
+                         const QString &sql,
+                         const QStringList &keyColumns,
+                         const QVariantList &bindValues,
+                         Order order)
+    : m_queryFirst(db)
+    , m_queryNext(db)
+    , m_bindValues(bindValues)
+    , m_nKeys(keyColumns.size())
+{
+    QStringList placeholders;
+    for (int i = 0; i < m_nKeys; ++i) {
+        placeholders << "?";
+    }
+    const QString keyCondition = QString(" AND (%1) %2 (%3)").arg(
+                keyColumns.join(", "),
+                QString(order == Order::Ascending ? ">" : "<"),
+                placeholders.join(", "));
+
+    m_queryFirst.setForwardOnly(true);
+    m_queryNext.setForwardOnly(true);
+    if (!m_queryFirst.prepare(sql.arg(QString()))
+            || !m_queryNext.prepare(sql.arg(keyCondition))) {
+        qWarning() << "Failed to prepare keyset pager:" << m_queryFirst.lastError().text()
+                   << m_queryNext.lastError().text();
+        m_atEnd = true;
+    }
+}
+
+QList<QVariantList> KeysetPager::fetchPage()
+{
+    QList<QVariantList> rows;
+    if (m_atEnd) {
+        return rows;
+    }
+
+    QSqlQuery &query = m_lastKey.isEmpty() ? m_queryFirst : m_queryNext;
+    int position = 0;
+    for (const auto &value : std::as_const(m_bindValues)) {
+        query.bindValue(position++, value);
+    }
+    for (const auto &value : std::as_const(m_lastKey)) {
+        query.bindValue(position++, value);
+    }
+    query.bindValue(position, m_pageSize);
+    if (!query.exec()) {
+        qWarning() << "Failed to fetch keyset page:" << query.lastError().text();
+        m_atEnd = true;
+        return rows;
+    }
+
+    const int nColumns = query.record().count() - m_nKeys;
+    rows.reserve(m_pageSize);
+    while (query.next()) {
+        QVariantList row;
+        row.reserve(nColumns);
+        for (int i = 0; i < nColumns; ++i) {
+            row << query.value(i);
+        }
+        rows << row;
+        if (rows.size() == m_pageSize) {
+            m_lastKey.clear();
+            for (int i = nColumns; i < nColumns + m_nKeys; ++i) {
+                m_lastKey << query.value(i);
+            }
+        }
+    }
+    // Releases the read snapshot between pages
+    query.finish();
+    // A short page is the last one
+    m_atEnd = rows.size() < m_pageSize;
+    return rows;
+}
+
+bool KeysetPager::atEnd() const noexcept
+{
+    return m_atEnd;
+}
+
+int KeysetPager::getPageSize() const noexcept
+{
+    return m_pageSize;
+}
+
+void KeysetPager::setPageSize(int pageSize)
+{
+    m_pageSize = qMax(1, pageSize);
+}
@@ -0,0 +1,54 @@
+#ifndef KEYSETPAGER_H
+#define KEYSETPAGER_H
+
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+// KeysetPager = page by page reading of an ordered SELECT, for models that fetch rows as the view scrolls
+// (QAbstractItemModel::canFetchMore / fetchMore). Each page starts after the sort key of the last row read,
+// "(k1, k2) > (?, ?)" being an index range, where an OFFSET would read and skip every previous row again.
+// The sort key must be unique (end it with rowid or the primary key).
+// Each page is a short read transaction: the rows written between two pages are seen if they sort after the last key.
+// Uses the connection of the thread that created it, so must be used from that thread and not outlive the OrderManager.
+class KeysetPager
+{
+public:
+    enum class Order {
+        Ascending,
+        Descending
+    };
+
+    static constexpr int DEFAULT_PAGE_SIZE = 256;
+
+    // sql selects the columns of a row followed by keyColumns. Its remaining place marker (%1) goes right after
+    // the WHERE conditions and receives the key condition ("AND (keys) > (?, ...)", "<" if descending), and it ends
+    // with ORDER BY keyColumns (each DESC if descending) LIMIT ?. bindValues are the values of the ? before the marker
+    KeysetPager(const QSqlDatabase &db,
+                const QString &sql,
+                const QStringList &keyColumns,
+                const QVariantList &bindValues,
+                Order order = Order::Ascending);
+    KeysetPager(const KeysetPager &) = delete;
+    KeysetPager &operator=(const KeysetPager &) = delete;
+
+    // Rows of the next page (without the key columns), empty once all rows were read
+    QList<QVariantList> fetchPage();
+    bool atEnd() const noexcept;
+    int getPageSize() const noexcept;
+    void setPageSize(int pageSize);
+
+private:
+    QSqlQuery m_queryFirst;
+    QSqlQuery m_queryNext;
+    QVariantList m_bindValues;
+    QVariantList m_lastKey;
+    int m_nKeys;
+    int m_pageSize = DEFAULT_PAGE_SIZE;
+    bool m_atEnd = false;
+};
+
+#endif // KEYSETPAGER_H
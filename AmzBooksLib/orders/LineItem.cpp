@@ -114,3 +114,24 @@ LineItem LineItem::fromJson(const QJsonObject &json)
         Amount(json["amountTaxed"].toDouble(), json["amountTaxes"].toDouble())
     );
 }
+
+QCborArray LineItem::toCbor() const
+{
+    return QCborArray{
+        m_sku,
+        m_name,
+        m_quantity,
+        m_amount.getAmountTaxed(),
+        m_amount.getTaxes()
+    };
+}
+
+LineItem LineItem::fromCbor(const QCborArray &cbor)
+{
+    return LineItem(
+        cbor[0].toString(),
+        cbor[1].toString(),
+        int(cbor[2].toInteger()),
+        Amount(cbor[3].toDouble(), cbor[4].toDouble())
+    );
+}
@@ -8,6 +8,7 @@
 #include "Amount.h"
 #include "Result.h"
 #include <QJsonObject>
+#include <QCborArray>
 
 // LineItem = one priced component of a shipment/order (product, shipping, fee, or discount)
 // with quantity and VAT rate, able to compute totals and accept a small VAT adjustment for reconciliation.
@@ -33,6 +34,9 @@ public:
 
     static LineItem fromJson(const QJsonObject &json);
     QJsonObject toJson() const;
+    // Positional encoding of toJson() fields, used by InvoicingInfo::toCbor()
+    static LineItem fromCbor(const QCborArray &cbor);
+    QCborArray toCbor() const;
 
 protected:
     LineItem(QString sku,
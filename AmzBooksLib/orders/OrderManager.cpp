@@ -2,6 +2,9 @@
 #include "OrderManager_sql_schema.h"
 
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QJsonDocument>
@@ -10,66 +13,234 @@
 #include <QVariant>
 #include <QDebug>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QThreadStorage>
+#include <QMutexLocker>
 
 #include "ActivitySource.h"
 #include "Shipment.h"
 #include "InvoicingInfo.h"
 #include "Address.h"
 #include "ActivityUpdate.h"
+#include "ShipmentCursor.h"
+#include "ShipmentQuery.h"
+#include "RevisionKind.h"
 
 namespace {
+    // Rows recorded per transaction by the bulk entry point
+    const int BULK_CHUNK_SIZE = 2000;
+
+    // Drafts published per set-based statement, between two progress reports
+    const int PUBLISH_CHUNK_SIZE = 5000;
+
+    // '' rather than NULL without source, so that source_key compares in keyset pages
     QString getSourceKey(const ActivitySource *source) {
-        if (!source) return QString();
-        return QString("%1|%2|%3|%4")
-                .arg(static_cast<int>(source->type))
-                .arg(source->channel)
-                .arg(source->subchannel)
-                .arg(source->reportOrMethode);
+        if (!source) return QStringLiteral("");
+        return source->toKey();
+    }
+
+    // Binds the event_date range of a period query, an invalid date leaving that side open
+    void bindPeriod(QSqlQuery &query, const QDate &dateFrom, const QDate &dateTo) {
+        query.addBindValue(dateFrom.isValid() ? dateFrom.toString(Qt::ISODate) : OrderManagerSql::EVENT_DATE_MIN);
+        query.addBindValue(dateTo.isValid() ? dateTo.toString(Qt::ISODate) : OrderManagerSql::EVENT_DATE_MAX);
+    }
+
+    // Content hash of a row, Shipment::toCbor() being deterministic
+    QByteArray getContentHash(const QByteArray &data) {
+        return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    }
+
+    // Per-thread connections of the OrderManager instances used by a worker thread,
+    // removed by the thread itself when it finishes (as a connection can't be used from another thread)
+    struct ThreadConnections {
+        QStringList connectionNames;
+        ~ThreadConnections() {
+            for (const QString &connectionName : std::as_const(connectionNames)) {
+                if (QSqlDatabase::contains(connectionName)) {
+                    QSqlDatabase::removeDatabase(connectionName);
+                }
+            }
+        }
+    };
+    QThreadStorage<ThreadConnections> threadConnections;
+
+    // Unique connection name prefix of each OrderManager, so that instances on different databases don't share one
+    QAtomicInt nextInstanceId;
+
+    // Yearly partitions next to Orders.db, attached as PARTITION_SCHEMA to be read and ARCHIVE_SCHEMA to be written
+    const QString PARTITION_FILE_NAME = "Orders-%1.db";
+    const QString PARTITION_SCHEMA = "y%1";
+    const QString ARCHIVE_SCHEMA = "archive";
+
+    // Years of the partitions of a directory, in order
+    QList<int> getPartitionYears(const QDir &dir) {
+        QList<int> years;
+        const QStringList fileNames = dir.entryList({PARTITION_FILE_NAME.arg("*")}, QDir::Files, QDir::Name);
+        for (const QString &fileName : fileNames) {
+            bool ok = false;
+            // "Orders-" and ".db"
+            const int year = fileName.mid(7, fileName.size() - 10).toInt(&ok);
+            if (ok) {
+                years << year;
+            }
+        }
+        return years;
+    }
+
+    // Partitions are only written by archiving and migrations
+    void setWritable(const QString &filePath, bool writable) {
+        if (!QFile::exists(filePath)) {
+            return;
+        }
+        QFile::Permissions permissions = QFile::permissions(filePath);
+        if (writable) {
+            permissions |= QFile::WriteOwner | QFile::WriteUser;
+        } else {
+            permissions &= ~(QFile::WriteOwner | QFile::WriteUser | QFile::WriteGroup | QFile::WriteOther);
+        }
+        QFile::setPermissions(filePath, permissions);
+    }
+
+    // Schemas of the databases attached to a connection, main first
+    QStringList getAttachedSchemas(const QSqlDatabase &db) {
+        QStringList schemas;
+        QSqlQuery query(db);
+        if (query.exec("PRAGMA database_list")) {
+            while (query.next()) {
+                schemas << query.value(1).toString();
+            }
+        }
+        return schemas;
+    }
+
+    // Importers use the order ID as activity event ID
+    QString getOrderId(const Shipment &shipmentOrRefund) {
+        if (shipmentOrRefund.getActivities().isEmpty()) return QString();
+        return shipmentOrRefund.getActivities().first().getEventId();
     }
 }
 
+class OrderManager::PreparedQueries
+{
+public:
+    explicit PreparedQueries(const QSqlDatabase &db)
+        : m_db(db)
+    {
+    }
+
+    // Returns the query prepared for this SQL on first use, so callers only bind values and execute
+    QSqlQuery &get(const QString &sql)
+    {
+        QSharedPointer<QSqlQuery> &query = m_queries[sql];
+        if (!query) {
+            query = QSharedPointer<QSqlQuery>::create(m_db);
+            if (!query->prepare(sql)) {
+                qWarning() << "Failed to prepare query:" << sql << query->lastError().text();
+            }
+        }
+        return *query;
+    }
+
+private:
+    QSqlDatabase m_db;
+    QHash<QString, QSharedPointer<QSqlQuery>> m_queries;
+};
+
 OrderManager::OrderManager(const QDir &workingDirectory)
 {
+    m_workingDirectory = workingDirectory;
     m_filePathDb = workingDirectory.absoluteFilePath("Orders.db");
+    m_connectionName = QString("OrderManager-%1").arg(nextInstanceId.fetchAndAddRelaxed(1));
+    m_thread = QThread::currentThread();
     initDb();
 }
 
 OrderManager::~OrderManager()
 {
+    // Worker threads must be done with this OrderManager
+    QStringList threadConnectionNames;
+    {
+        QMutexLocker locker(&m_connectionsMutex);
+        threadConnectionNames = m_threadConnectionNames;
+    }
+    for (const QString &connectionName : std::as_const(threadConnectionNames)) {
+        if (QSqlDatabase::contains(connectionName)) {
+            QSqlDatabase::removeDatabase(connectionName);
+        }
+    }
     if (m_db.isOpen()) {
         m_db.close();
     }
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connectionName);
 }
 
-void OrderManager::initDb()
+QSqlDatabase OrderManager::_openConnection(const QString &connectionName) const
 {
-    m_db = QSqlDatabase::addDatabase("QSQLITE");
-    m_db.setDatabaseName(m_filePathDb);
-    
-    if (!m_db.open()) {
-        qWarning() << "Failed to open database:" << m_db.lastError().text();
-        return;
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(m_filePathDb);
+    // For the read-only ATTACH of the yearly partitions
+    db.setConnectOptions("QSQLITE_OPEN_URI");
+    if (!db.open()) {
+        qWarning() << "Failed to open database:" << db.lastError().text();
+        return db;
     }
+    QSqlQuery query(db);
+    for (const QString &pragma : OrderManagerSql::CONNECTION_PRAGMAS) {
+        if (!query.exec(pragma)) {
+            qWarning() << "Failed to set" << pragma << ":" << query.lastError().text();
+        }
+    }
+    return db;
+}
 
-    QSqlQuery query;
-    query.exec("PRAGMA foreign_keys = ON;");
-
-    if (!query.exec(OrderManagerSql::CREATE_TABLE_ORDERS)) {
-         qWarning() << "Failed to create orders table:" << query.lastError().text();
+QSqlDatabase OrderManager::_db() const
+{
+    if (QThread::currentThread() == m_thread) {
+        return m_db;
+    }
+    const QString connectionName = QString("%1-%2").arg(
+                m_connectionName, QString::number(quintptr(QThread::currentThreadId())));
+    if (QSqlDatabase::contains(connectionName)) {
+        return QSqlDatabase::database(connectionName, false);
+    }
+    {
+        QMutexLocker locker(&m_connectionsMutex);
+        m_threadConnectionNames << connectionName;
     }
-    if (!query.exec(OrderManagerSql::CREATE_TABLE_SHIPMENTS)) {
-         qWarning() << "Failed to create shipments table:" << query.lastError().text();
+    threadConnections.localData().connectionNames << connectionName;
+    return _openConnection(connectionName);
+}
+
+void OrderManager::initDb()
+{
+    m_db = _openConnection(m_connectionName);
+    if (!m_db.isOpen()) {
+        return;
     }
-    if (!query.exec(OrderManagerSql::CREATE_TABLE_FINANCIAL_EVENTS)) {
-         qWarning() << "Failed to create financial_events table:" << query.lastError().text();
+    _initSchema(m_db);
+    _migratePartitions();
+}
+
+bool OrderManager::_initSchema(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    if (!query.exec(OrderManagerSql::SELECT_HAS_SHIPMENTS_TABLE) || !query.next()) {
+        qWarning() << "Failed to read the tables of" << db.databaseName() << ":" << query.lastError().text();
+        return false;
     }
-    if (!query.exec(OrderManagerSql::CREATE_TABLE_INVOICING_INFOS)) {
-         qWarning() << "Failed to create invoicing_infos table:" << query.lastError().text();
+    const bool isNew = !query.value(0).toBool();
+    query.finish();
+    if (isNew) {
+        return _createSchema(db);
     }
 
     // Migration: Add store column if missing
     {
-        QSqlQuery qMig("PRAGMA table_info(orders)");
+        QSqlQuery qMig(db);
+        qMig.exec("PRAGMA table_info(orders)");
         bool hasStore = false;
         while (qMig.next()) {
             if (qMig.value("name").toString() == "store") {
@@ -78,18 +249,225 @@ void OrderManager::initDb()
             }
         }
         if (!hasStore) {
-            QSqlQuery qAlter;
+            QSqlQuery qAlter(db);
             if (!qAlter.exec("ALTER TABLE orders ADD COLUMN store TEXT")) {
                 qWarning() << "Failed to add store column to orders:" << qAlter.lastError().text();
             }
         }
     }
+
+    return migrateDb(db);
+}
+
+bool OrderManager::_createSchema(QSqlDatabase db)
+{
+    const QString fileName = QFileInfo(db.databaseName()).fileName();
+    QSqlQuery query(db);
+    db.transaction();
+    for (const QString &sql : OrderManagerSql::CREATE_SCHEMA) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to create the tables of" << fileName << ":" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    // PRAGMA doesn't support bound values
+    if (!query.exec(QString("PRAGMA user_version = %1").arg(OrderManagerSql::SCHEMA_VERSION))) {
+        qWarning() << "Failed to set" << fileName << "version" << OrderManagerSql::SCHEMA_VERSION << ":" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+bool OrderManager::migrateDb(QSqlDatabase db)
+{
+    const QString fileName = QFileInfo(db.databaseName()).fileName();
+    QSqlQuery query(db);
+    int version = 0;
+    if (query.exec("PRAGMA user_version") && query.next()) {
+        version = query.value(0).toInt();
+    }
+    query.finish();
+
+    for (int i = version; i < OrderManagerSql::SCHEMA_VERSION; ++i) {
+        db.transaction();
+        bool ok = true;
+        for (const QString &sql : OrderManagerSql::MIGRATIONS[i]) {
+            if (!query.exec(sql)) {
+                qWarning() << "Failed to migrate" << fileName << "to version" << i + 1 << ":" << query.lastError().text();
+                ok = false;
+                break;
+            }
+        }
+        if (ok) {
+            ok = _migrateData(db, i + 1);
+        }
+        // PRAGMA doesn't support bound values
+        if (ok && !query.exec(QString("PRAGMA user_version = %1").arg(i + 1))) {
+            qWarning() << "Failed to set" << fileName << "version" << i + 1 << ":" << query.lastError().text();
+            ok = false;
+        }
+        if (!ok) {
+            db.rollback();
+            return false;
+        }
+        db.commit();
+    }
+    return true;
+}
+
+bool OrderManager::_migrateData(QSqlDatabase db, int version)
+{
+    if (version == 2) {
+        // Backfill the activities table from the JSON of existing rows
+        PreparedQueries queries(db);
+        QSqlQuery query(db);
+        if (!query.exec(OrderManagerSql::SELECT_ALL_SHIPMENT_JSONS)) {
+            qWarning() << "Failed to read shipments for migration" << version << ":" << query.lastError().text();
+            return false;
+        }
+        while (query.next()) {
+            const QString id = query.value(0).toString();
+            // Before migration 3, reversal rows stored the content they reverse
+            const bool isReversal = !query.value(1).toString().isEmpty() && id.contains("-rev-");
+            const Shipment shipment = Shipment::fromJson(
+                        QJsonDocument::fromJson(query.value(2).toString().toUtf8()).object());
+            _writeActivities(id, isReversal ? shipment.negated() : shipment, queries);
+        }
+    } else if (version == 3) {
+        // Reversal rows now store negated content (their activities rows already are)
+        auto negateJson = [](const QVariant &json) -> QVariant {
+            if (json.isNull()) {
+                return json;
+            }
+            const Shipment shipment = Shipment::fromJson(QJsonDocument::fromJson(json.toString().toUtf8()).object());
+            return QString(QJsonDocument(shipment.negated().toJson()).toJson(QJsonDocument::Compact));
+        };
+        QSqlQuery query(db);
+        if (!query.exec(OrderManagerSql::SELECT_REVERSAL_JSONS)) {
+            qWarning() << "Failed to read reversals for migration" << version << ":" << query.lastError().text();
+            return false;
+        }
+        QSqlQuery qUpd(db);
+        qUpd.prepare(OrderManagerSql::UPDATE_SHIPMENT_JSONS);
+        while (query.next()) {
+            qUpd.addBindValue(negateJson(query.value(1)));
+            qUpd.addBindValue(negateJson(query.value(2)));
+            qUpd.addBindValue(negateJson(query.value(3)));
+            qUpd.addBindValue(query.value(0));
+            if (!qUpd.exec()) {
+                qWarning() << "Failed to negate reversal" << query.value(0).toString() << ":" << qUpd.lastError().text();
+                return false;
+            }
+        }
+    } else if (version == 5) {
+        QSqlQuery query(db);
+        if (!query.exec(OrderManagerSql::SELECT_ALL_SHIPMENT_JSONS)) {
+            qWarning() << "Failed to read shipments for migration" << version << ":" << query.lastError().text();
+            return false;
+        }
+        QSqlQuery qUpd(db);
+        qUpd.prepare(OrderManagerSql::UPDATE_SHIPMENT_HASHES);
+        while (query.next()) {
+            const QString jsonStr = query.value(2).toString();
+            const Shipment shipment = Shipment::fromJson(QJsonDocument::fromJson(jsonStr.toUtf8()).object());
+            qUpd.addBindValue(getContentHash(jsonStr.toUtf8()));
+            qUpd.addBindValue(shipment.taxHash());
+            qUpd.addBindValue(query.value(0));
+            if (!qUpd.exec()) {
+                qWarning() << "Failed to hash shipment" << query.value(0).toString() << ":" << qUpd.lastError().text();
+                return false;
+            }
+        }
+    } else if (version == 6) {
+        // Binary content from the JSON columns, dropped by migration 7
+        auto toData = [](const QVariant &json) -> QVariant {
+            if (json.isNull()) {
+                return QVariant();
+            }
+            return Shipment::fromJson(QJsonDocument::fromJson(json.toString().toUtf8()).object()).toCbor();
+        };
+        QSqlQuery query(db);
+        if (!query.exec(OrderManagerSql::SELECT_ALL_JSONS)) {
+            qWarning() << "Failed to read shipments for migration" << version << ":" << query.lastError().text();
+            return false;
+        }
+        QSqlQuery qUpd(db);
+        qUpd.prepare(OrderManagerSql::UPDATE_SHIPMENT_DATA);
+        while (query.next()) {
+            const QVariant currentData = toData(query.value(2));
+            qUpd.addBindValue(toData(query.value(1)));
+            qUpd.addBindValue(currentData);
+            qUpd.addBindValue(toData(query.value(3)));
+            qUpd.addBindValue(getContentHash(currentData.toByteArray()));
+            qUpd.addBindValue(query.value(0));
+            if (!qUpd.exec()) {
+                qWarning() << "Failed to encode shipment" << query.value(0).toString() << ":" << qUpd.lastError().text();
+                return false;
+            }
+        }
+        query.finish();
+
+        if (!query.exec(OrderManagerSql::SELECT_INVOICING_INFO_JSONS)) {
+            qWarning() << "Failed to read invoicing infos for migration" << version << ":" << query.lastError().text();
+            return false;
+        }
+        qUpd.prepare(OrderManagerSql::UPDATE_INVOICING_INFO_DATA);
+        while (query.next()) {
+            const InvoicingInfo invoicingInfo = InvoicingInfo::fromJson(
+                        QJsonDocument::fromJson(query.value(1).toString().toUtf8()).object());
+            qUpd.addBindValue(invoicingInfo.toCbor());
+            qUpd.addBindValue(query.value(0));
+            if (!qUpd.exec()) {
+                qWarning() << "Failed to encode invoicing info" << query.value(0).toString() << ":" << qUpd.lastError().text();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool OrderManager::_initPartition(const QString &filePath)
+{
+    setWritable(filePath, true);
+    const QString connectionName = QString("%1-partition-%2").arg(
+                m_connectionName, QString::number(quintptr(QThread::currentThreadId())));
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(filePath);
+        if (db.open()) {
+            QSqlQuery query(db);
+            if (!query.exec(OrderManagerSql::PARTITION_JOURNAL_MODE)) {
+                qWarning() << "Failed to set the journal mode of" << filePath << ":" << query.lastError().text();
+            }
+            query.finish();
+            ok = _initSchema(db);
+            db.close();
+        } else {
+            qWarning() << "Failed to open partition" << filePath << ":" << db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return ok;
+}
+
+void OrderManager::_migratePartitions()
+{
+    // Keeps the partitions queryable with the statements of SCHEMA_VERSION
+    const QList<int> years = getPartitionYears(m_workingDirectory);
+    for (int year : years) {
+        const QString filePath = m_workingDirectory.absoluteFilePath(PARTITION_FILE_NAME.arg(year));
+        _initPartition(filePath);
+        setWritable(filePath, false);
+    }
 }
 
 QDateTime OrderManager::getLastDateTime(ActivitySource *activitySource) const
 {
-    QSqlQuery query;
-    query.prepare("SELECT MAX(event_date) FROM shipments WHERE source_key = ?");
+    QSqlQuery query(_db());
+    query.prepare(OrderManagerSql::SELECT_LAST_EVENT_DATE);
     query.addBindValue(getSourceKey(activitySource));
     if (query.exec() && query.next()) {
         QString dateStr = query.value(0).toString();
@@ -102,8 +480,8 @@ QDateTime OrderManager::getLastDateTime(ActivitySource *activitySource) const
 
 QDateTime OrderManager::getBeginDateTime(ActivitySource *activitySource) const
 {
-    QSqlQuery query;
-    query.prepare("SELECT MIN(event_date) FROM shipments WHERE source_key = ?");
+    QSqlQuery query(_db());
+    query.prepare(OrderManagerSql::SELECT_FIRST_EVENT_DATE);
     query.addBindValue(getSourceKey(activitySource));
     if (query.exec() && query.next()) {
         QString dateStr = query.value(0).toString();
@@ -118,154 +496,330 @@ void OrderManager::recordShipmentFromSource(const QString &orderId,
                                             const ActivitySource *activitySource,
                                             const Shipment *shipmentOrRefund,
                                             const QDate &newDateIfConflict)
+{
+    PreparedQueries queries(_db());
+    _recordShipment(orderId, getSourceKey(activitySource), shipmentOrRefund, newDateIfConflict, queries);
+}
+
+void OrderManager::_recordShipment(const QString &orderId,
+                                   const QString &sourceKey,
+                                   const Shipment *shipmentOrRefund,
+                                   const QDate &newDateIfConflict,
+                                   PreparedQueries &queries)
 {
     if (!shipmentOrRefund) return;
     
     {
-        QSqlQuery qCheck;
-        qCheck.prepare("INSERT OR IGNORE INTO orders (id) VALUES (?)");
+        QSqlQuery &qCheck = queries.get(OrderManagerSql::INSERT_ORDER_ID);
         qCheck.addBindValue(orderId);
         if (!qCheck.exec()) qWarning() << "Failed to insert order:" << qCheck.lastError();
     }
 
     QString id = shipmentOrRefund->getId();
-    QJsonObject content = shipmentOrRefund->toJson();
-    QString jsonStr = QJsonDocument(content).toJson(QJsonDocument::Compact);
+    const QByteArray data = shipmentOrRefund->toCbor();
     // Use the first activity date as the event date
     if (shipmentOrRefund->getActivities().isEmpty()) return;
     QString eventDate = shipmentOrRefund->getActivities().first().getDateTime().toString(Qt::ISODate);
-    QString sourceKey = getSourceKey(activitySource);
+    const QByteArray contentHash = getContentHash(data);
+    const QByteArray taxHash = shipmentOrRefund->taxHash();
 
-    QSqlQuery qSel;
-    qSel.prepare("SELECT status, original_json, current_json FROM shipments WHERE id = ?");
+    QSqlQuery &qSel = queries.get(OrderManagerSql::SELECT_SHIPMENT_STATUS);
     qSel.addBindValue(id);
     
     if (qSel.exec() && qSel.next()) {
-        QString status = qSel.value("status").toString();
-        QString currentJson = qSel.value("current_json").toString();
+        QString status = qSel.value(0).toString();
+        QByteArray currentHash = qSel.value(1).toByteArray();
+        QString currentSourceKey = qSel.value(2).toString();
+        // Latest published row, from the head pointer (the root if no revision was published)
+        QString latestId = qSel.value(3).toString();
+        QByteArray latestData = qSel.value(4).toByteArray();
+        QByteArray latestHash = qSel.value(5).toByteArray();
+        QByteArray latestTaxHash = qSel.value(6).toByteArray();
+        qSel.finish();
         
         if (status == "Draft") {
-            QSqlQuery qUpd;
-            qUpd.prepare("UPDATE shipments SET original_json = ?, current_json = ?, event_date = ?, source_key = ? WHERE id = ?");
-            qUpd.addBindValue(jsonStr);
-            qUpd.addBindValue(jsonStr); 
+            if (currentHash == contentHash && currentSourceKey == sourceKey) {
+                return; // Same draft recorded again
+            }
+            _logChange(id, ChangeKind::Updated, queries);
+            QSqlQuery &qUpd = queries.get(OrderManagerSql::UPDATE_SHIPMENT_DRAFT);
+            qUpd.addBindValue(data);
+            qUpd.addBindValue(data);
+            qUpd.addBindValue(contentHash);
+            qUpd.addBindValue(taxHash);
             qUpd.addBindValue(eventDate);
             qUpd.addBindValue(sourceKey);
             qUpd.addBindValue(id);
             qUpd.exec();
+            _writeActivities(id, *shipmentOrRefund, queries);
+            _logChange(id, ChangeKind::Updated, queries);
 
         } else if (status == "Published") {
-            // Check if conflict / diff
-            bool isConflict = false;
-            bool contentDiffers = false;
-            QString latestJson = currentJson;
-            QString latestId = id; // Default to root if no revisions
-
-            // Check if this content matches the LATEST PUBLISHED revision (if any)
-            QSqlQuery qLatest;
-            qLatest.prepare("SELECT id, current_json FROM shipments WHERE root_id = ? AND status = 'Published' ORDER BY event_date DESC, id DESC LIMIT 1");
-            qLatest.addBindValue(id); // Search by root_id
-            
-            // If revisions exist, use the top one.
-            if (qLatest.exec() && qLatest.next()) {
-                latestId = qLatest.value(0).toString();
-                latestJson = qLatest.value(1).toString();
-            }
-
-            if (latestJson != jsonStr) {
-                contentDiffers = true;
-                Shipment latestShip = Shipment::fromJson(QJsonDocument::fromJson(latestJson.toUtf8()).object());
-                Shipment incomingShip = Shipment::fromJson(QJsonDocument::fromJson(jsonStr.toUtf8()).object());
-                
-                ConflictStatus status = checkConflict(latestShip, incomingShip);
-                if (status == ConflictStatus::Conflict) {
-                    isConflict = true;
-                }
-            }
+            // Check if conflict / diff with hashes, the JSON is decoded only to create a reversal
+            const bool contentDiffers = latestHash != contentHash;
+            const bool isConflict = contentDiffers && latestTaxHash != taxHash;
 
             if (isConflict) {
                 QString timestamp = QString::number(QDateTime::currentMSecsSinceEpoch());
                 // We use timestamps to ensure uniqueness for revisions
-                QString reversalId = QString("%1-rev-%2").arg(id).arg(timestamp);
-                QString newVersionId = QString("%1-v-%2").arg(id).arg(timestamp);
+                QString reversalId = QString("%1-rev-%2").arg(id, timestamp);
+                QString newVersionId = QString("%1-v-%2").arg(id, timestamp);
                 
-                QSqlQuery qCheckDrafts;
-                qCheckDrafts.prepare("SELECT id FROM shipments WHERE root_id = ? AND status = 'Draft'");
+                QSqlQuery &qCheckDrafts = queries.get(OrderManagerSql::SELECT_DRAFT_REVISIONS);
                 qCheckDrafts.addBindValue(id);
                 
                 bool draftsFound = false;
+                QStringList newVersionDraftIds;
                 if (qCheckDrafts.exec()) {
                     while (qCheckDrafts.next()) {
                         draftsFound = true;
-                         QString draftId = qCheckDrafts.value(0).toString();
-                         if (draftId.contains("-v-")) {
-                             QSqlQuery qUpd;
-                             qUpd.prepare("UPDATE shipments SET original_json = ?, current_json = ?, event_date = ?, source_key = ? WHERE id = ?");
-                             qUpd.addBindValue(jsonStr);
-                             qUpd.addBindValue(jsonStr);
-                             qUpd.addBindValue(newDateIfConflict.isValid() ? newDateIfConflict.toString(Qt::ISODate) : eventDate);
-                             qUpd.addBindValue(sourceKey);
-                             qUpd.addBindValue(draftId);
-                             qUpd.exec();
-                         }
+                        if (toRevisionKind(qCheckDrafts.value(1).toString()) == RevisionKind::NewVersion) {
+                            newVersionDraftIds << qCheckDrafts.value(0).toString();
+                        }
                     }
                 }
+                qCheckDrafts.finish();
+                for (const QString &draftId : std::as_const(newVersionDraftIds)) {
+                    _logChange(draftId, ChangeKind::Updated, queries);
+                    QSqlQuery &qUpd = queries.get(OrderManagerSql::UPDATE_SHIPMENT_DRAFT);
+                    qUpd.addBindValue(data);
+                    qUpd.addBindValue(data);
+                    qUpd.addBindValue(contentHash);
+                    qUpd.addBindValue(taxHash);
+                    qUpd.addBindValue(newDateIfConflict.isValid() ? newDateIfConflict.toString(Qt::ISODate) : eventDate);
+                    qUpd.addBindValue(sourceKey);
+                    qUpd.addBindValue(draftId);
+                    qUpd.exec();
+                    _writeActivities(draftId, *shipmentOrRefund, queries);
+                    _logChange(draftId, ChangeKind::Updated, queries);
+                }
                 
                 if (!draftsFound) {
                     // Create Double Entry
-                    // Reversal of the LATEST VALID State (latestJson)
+                    // Reversal of the LATEST VALID State (latestData), stored negated
                     {
-                        QSqlQuery qInsRev;
-                        qInsRev.prepare("INSERT INTO shipments (id, order_id, status, original_json, current_json, event_date, source_key, root_id) VALUES (?, ?, 'Draft', ?, ?, ?, ?, ?)");
+                        const Shipment reversalShip = Shipment::fromCbor(latestData).negated();
+                        const QByteArray reversalData = reversalShip.toCbor();
+                        QSqlQuery &qInsRev = queries.get(OrderManagerSql::INSERT_SHIPMENT_REVISION);
                         qInsRev.addBindValue(reversalId);
                         qInsRev.addBindValue(orderId);
-                        qInsRev.addBindValue(latestJson);  // Reverse what was last active
-                        qInsRev.addBindValue(latestJson);
+                        qInsRev.addBindValue(reversalData);  // Reverse what was last active
+                        qInsRev.addBindValue(reversalData);
+                        qInsRev.addBindValue(getContentHash(reversalData));
+                        qInsRev.addBindValue(reversalShip.taxHash());
                         qInsRev.addBindValue(newDateIfConflict.isValid() ? newDateIfConflict.toString(Qt::ISODate) : eventDate);
                         qInsRev.addBindValue(sourceKey);
                         qInsRev.addBindValue(id);
+                        qInsRev.addBindValue(toString(RevisionKind::Reversal));
                         qInsRev.exec();
+                        _writeActivities(reversalId, reversalShip, queries);
+                        _logChange(reversalId, ChangeKind::Revised, queries);
                     }
                     
                     // New Version
                     {
-                        QSqlQuery qInsNew;
-                        qInsNew.prepare("INSERT INTO shipments (id, order_id, status, original_json, current_json, event_date, source_key, root_id) VALUES (?, ?, 'Draft', ?, ?, ?, ?, ?)");
+                        QSqlQuery &qInsNew = queries.get(OrderManagerSql::INSERT_SHIPMENT_REVISION);
                         qInsNew.addBindValue(newVersionId);
                         qInsNew.addBindValue(orderId);
-                        qInsNew.addBindValue(jsonStr);
-                        qInsNew.addBindValue(jsonStr);
+                        qInsNew.addBindValue(data);
+                        qInsNew.addBindValue(data);
+                        qInsNew.addBindValue(contentHash);
+                        qInsNew.addBindValue(taxHash);
                         qInsNew.addBindValue(newDateIfConflict.isValid() ? newDateIfConflict.toString(Qt::ISODate) : eventDate);
                         qInsNew.addBindValue(sourceKey);
                         qInsNew.addBindValue(id);
+                        qInsNew.addBindValue(toString(RevisionKind::NewVersion));
                         qInsNew.exec();
+                        _writeActivities(newVersionId, *shipmentOrRefund, queries);
+                        _updateHead(id, newVersionId, queries);
+                        _logChange(newVersionId, ChangeKind::Revised, queries);
                     }
                 }
                 } else if (contentDiffers) {
                 // No financial conflict, but content differs (e.g. date change in same month, or address)
-                // Update the LATEST revision in place
-                QSqlQuery qUpd;
-                qUpd.prepare("UPDATE shipments SET current_json = ?, event_date = ?, source_key = ? WHERE id = ?");
-                qUpd.addBindValue(jsonStr);
+                // Update the LATEST revision in place, moving its amounts in the period aggregates
+                _updatePeriodAggregates(latestId, -1, queries);
+                _logChange(latestId, ChangeKind::Updated, queries);
+                QSqlQuery &qUpd = queries.get(OrderManagerSql::UPDATE_SHIPMENT_CURRENT);
+                qUpd.addBindValue(data);
+                qUpd.addBindValue(contentHash);
+                qUpd.addBindValue(taxHash);
                 qUpd.addBindValue(newDateIfConflict.isValid() ? newDateIfConflict.toString(Qt::ISODate) : eventDate);
                 qUpd.addBindValue(sourceKey);
                 qUpd.addBindValue(latestId);
                 qUpd.exec();
+                _writeActivities(latestId, *shipmentOrRefund, queries);
+                _updatePeriodAggregates(latestId, 1, queries);
+                _logChange(latestId, ChangeKind::Updated, queries);
             }
         }
     } else {
-        QSqlQuery qIns;
-        qIns.prepare("INSERT INTO shipments (id, order_id, status, original_json, current_json, event_date, source_key) VALUES (?, ?, 'Draft', ?, ?, ?, ?)");
+        qSel.finish();
+        QSqlQuery &qIns = queries.get(OrderManagerSql::INSERT_SHIPMENT);
         qIns.addBindValue(id);
         qIns.addBindValue(orderId);
-        qIns.addBindValue(jsonStr);
-        qIns.addBindValue(jsonStr);
+        qIns.addBindValue(data);
+        qIns.addBindValue(data);
+        qIns.addBindValue(contentHash);
+        qIns.addBindValue(taxHash);
         qIns.addBindValue(eventDate);
         qIns.addBindValue(sourceKey);
         qIns.exec();
+        _writeActivities(id, *shipmentOrRefund, queries);
+        _updateHead(id, id, queries);
+        _logChange(id, ChangeKind::Recorded, queries);
+    }
+}
+
+void OrderManager::_updateHead(const QString &rootId, const QString &headId, PreparedQueries &queries)
+{
+    QSqlQuery &qHead = queries.get(OrderManagerSql::UPSERT_HEAD);
+    qHead.addBindValue(rootId);
+    qHead.addBindValue(headId);
+    if (!qHead.exec()) {
+        qWarning() << "Failed to update head of" << rootId << ":" << qHead.lastError();
+    }
+}
+
+void OrderManager::_logChange(const QString &shipmentId, ChangeKind kind, PreparedQueries &queries)
+{
+    QSqlQuery &qChange = queries.get(OrderManagerSql::INSERT_CHANGE);
+    qChange.addBindValue(toString(kind));
+    qChange.addBindValue(shipmentId);
+    if (!qChange.exec()) {
+        qWarning() << "Failed to log change of" << shipmentId << ":" << qChange.lastError();
+    }
+}
+
+void OrderManager::_updatePeriodAggregates(const QString &shipmentId, int sign, PreparedQueries &queries)
+{
+    QSqlQuery &qAggregates = queries.get(OrderManagerSql::UPSERT_PERIOD_AGGREGATES_OF_SHIPMENT);
+    qAggregates.addBindValue(sign);
+    qAggregates.addBindValue(sign);
+    qAggregates.addBindValue(sign);
+    qAggregates.addBindValue(shipmentId);
+    if (!qAggregates.exec()) {
+        qWarning() << "Failed to update period aggregates of" << shipmentId << ":" << qAggregates.lastError();
+    }
+    QSqlQuery &qDirty = queries.get(OrderManagerSql::UPSERT_DIRTY_PERIOD_OF_SHIPMENT);
+    qDirty.addBindValue(shipmentId);
+    if (!qDirty.exec()) {
+        qWarning() << "Failed to mark the period of" << shipmentId << "dirty:" << qDirty.lastError();
     }
 }
 
+void OrderManager::_writeActivities(const QString &shipmentId,
+                                    const Shipment &shipmentOrRefund,
+                                    PreparedQueries &queries)
+{
+    QSqlQuery &qDel = queries.get(OrderManagerSql::DELETE_ACTIVITIES);
+    qDel.addBindValue(shipmentId);
+    if (!qDel.exec()) {
+        qWarning() << "Failed to delete activities:" << qDel.lastError();
+    }
+
+    const auto &activities = shipmentOrRefund.getActivities();
+    for (int i = 0; i < activities.size(); ++i) {
+        const Activity &act = activities[i];
+        QSqlQuery &qIns = queries.get(OrderManagerSql::INSERT_ACTIVITY);
+        qIns.addBindValue(shipmentId);
+        qIns.addBindValue(i);
+        qIns.addBindValue(act.getEventId());
+        qIns.addBindValue(act.getActivityId());
+        qIns.addBindValue(act.getSubActivityId());
+        qIns.addBindValue(act.getDateTime().toString(Qt::ISODate));
+        qIns.addBindValue(act.getCurrency());
+        qIns.addBindValue(act.getCountryCodeFrom());
+        qIns.addBindValue(act.getCountryCodeTo());
+        qIns.addBindValue(act.getCountryCodeVatPaidTo());
+        qIns.addBindValue(act.getAmountTaxed());
+        qIns.addBindValue(act.getAmountTaxes());
+        qIns.addBindValue(act.getVatRate());
+        qIns.addBindValue(static_cast<int>(act.getTaxSource()));
+        qIns.addBindValue(act.getTaxDeclaringCountryCode());
+        qIns.addBindValue(static_cast<int>(act.getTaxScheme()));
+        qIns.addBindValue(static_cast<int>(act.getTaxJurisdictionLevel()));
+        qIns.addBindValue(static_cast<int>(act.getSaleType()));
+        qIns.addBindValue(act.getVatTerritoryFrom());
+        qIns.addBindValue(act.getVatTerritoryTo());
+        if (!qIns.exec()) {
+            qWarning() << "Failed to insert activity:" << qIns.lastError();
+        }
+    }
+}
+
+bool OrderManager::recordOrderInfos(const AbstractImporter::OrderInfos &orderInfos,
+                                    const ActivitySource &activitySource,
+                                    const QDate &newDateIfConflict)
+{
+    QSqlDatabase db = _db();
+    const QString sourceKey = getSourceKey(&activitySource);
+    PreparedQueries queries(db);
+
+    // One transaction per chunk instead of one implicit (fsync'd) transaction per statement
+    int rowsInChunk = 0;
+    if (!db.transaction()) {
+        qWarning() << "Failed to start bulk chunk:" << db.lastError().text();
+        return false;
+    }
+    auto commitChunk = [&db]() {
+        if (!db.commit()) {
+            qWarning() << "Failed to commit bulk chunk:" << db.lastError().text();
+            db.rollback();
+            return false;
+        }
+        return true;
+    };
+    auto commitIfChunkFull = [&db, &rowsInChunk, &commitChunk]() {
+        if (++rowsInChunk < BULK_CHUNK_SIZE) {
+            return true;
+        }
+        rowsInChunk = 0;
+        if (!commitChunk()) {
+            return false;
+        }
+        if (!db.transaction()) {
+            qWarning() << "Failed to start bulk chunk:" << db.lastError().text();
+            return false;
+        }
+        return true;
+    };
+
+    for (const auto &shipment : orderInfos.shipments) {
+        _recordShipment(getOrderId(shipment), sourceKey, &shipment, newDateIfConflict, queries);
+        if (!commitIfChunkFull()) {
+            return false;
+        }
+    }
+    for (const auto &refund : orderInfos.refunds) {
+        _recordShipment(getOrderId(refund), sourceKey, &refund, newDateIfConflict, queries);
+        if (!commitIfChunkFull()) {
+            return false;
+        }
+    }
+    for (auto it = orderInfos.orderId_store.constBegin(); it != orderInfos.orderId_store.constEnd(); ++it) {
+        _recordOrder(it.key(), it.value(), queries);
+        if (!commitIfChunkFull()) {
+            return false;
+        }
+    }
+    for (const auto &addressWithId : orderInfos.orderAddresses) {
+        _recordAddressTo(addressWithId.orderId, addressWithId.address, queries);
+        if (!commitIfChunkFull()) {
+            return false;
+        }
+    }
+    // Last, so that the root ID of the shipments recorded above is resolved
+    for (const auto &invoicingInfoWithId : orderInfos.invoicingInfos) {
+        _recordInvoicingInfo(invoicingInfoWithId.shipmentOrRefundId, &invoicingInfoWithId.invoicingInfo, queries);
+        if (!commitIfChunkFull()) {
+            return false;
+        }
+    }
+
+    return commitChunk();
+}
+
 void OrderManager::recordShipmentUpdated(const QString &orderId,
                                          const ActivitySource *activitySource,
                                          const Shipment *shipmentOrRefund,
@@ -273,27 +827,40 @@ void OrderManager::recordShipmentUpdated(const QString &orderId,
 {
     if (!shipmentOrRefund) return;
     QString id = shipmentOrRefund->getId();
-    QString jsonStr = QJsonDocument(shipmentOrRefund->toJson()).toJson(QJsonDocument::Compact);
+    const QByteArray data = shipmentOrRefund->toCbor();
 
-    QSqlQuery qUpd;
-    qUpd.prepare("UPDATE shipments SET current_json = ? WHERE id = ?");
-    qUpd.addBindValue(jsonStr);
+    PreparedQueries queries(_db());
+    _updatePeriodAggregates(id, -1, queries); // No-op unless the row is published
+    _logChange(id, ChangeKind::Updated, queries);
+    QSqlQuery &qUpd = queries.get(OrderManagerSql::UPDATE_SHIPMENT_CURRENT_DATA);
+    qUpd.addBindValue(data);
+    qUpd.addBindValue(getContentHash(data));
+    qUpd.addBindValue(shipmentOrRefund->taxHash());
     qUpd.addBindValue(id);
     qUpd.exec();
+    if (qUpd.numRowsAffected() > 0) {
+        _writeActivities(id, *shipmentOrRefund, queries);
+        _logChange(id, ChangeKind::Updated, queries);
+    }
+    _updatePeriodAggregates(id, 1, queries);
 }
 
 void OrderManager::recordAddressTo(const QString &orderId, const Address &addressTo)
+{
+    PreparedQueries queries(_db());
+    _recordAddressTo(orderId, addressTo, queries);
+}
+
+void OrderManager::_recordAddressTo(const QString &orderId, const Address &addressTo, PreparedQueries &queries)
 {
     {
-        QSqlQuery qCheck;
-        qCheck.prepare("INSERT OR IGNORE INTO orders (id) VALUES (?)");
+        QSqlQuery &qCheck = queries.get(OrderManagerSql::INSERT_ORDER_ID);
         qCheck.addBindValue(orderId);
         qCheck.exec();
     }
     
     QString jsonStr = QJsonDocument(addressTo.toJson()).toJson(QJsonDocument::Compact);
-    QSqlQuery qUpd;
-    qUpd.prepare("UPDATE orders SET address_json = ? WHERE id = ?");
+    QSqlQuery &qUpd = queries.get(OrderManagerSql::UPDATE_ORDER_ADDRESS);
     qUpd.addBindValue(jsonStr);
     qUpd.addBindValue(orderId);
     if (!qUpd.exec()) qWarning() << "Failed to update address:" << qUpd.lastError();
@@ -301,9 +868,13 @@ void OrderManager::recordAddressTo(const QString &orderId, const Address &addres
 
 void OrderManager::recordOrder(const QString &orderId, const QString &store)
 {
-    QSqlQuery q;
-    q.prepare("INSERT INTO orders (id, store) VALUES (?, ?) "
-              "ON CONFLICT(id) DO UPDATE SET store=excluded.store");
+    PreparedQueries queries(_db());
+    _recordOrder(orderId, store, queries);
+}
+
+void OrderManager::_recordOrder(const QString &orderId, const QString &store, PreparedQueries &queries)
+{
+    QSqlQuery &q = queries.get(OrderManagerSql::UPSERT_ORDER_STORE);
     q.addBindValue(orderId);
     q.addBindValue(store);
     if (!q.exec()) {
@@ -313,6 +884,14 @@ void OrderManager::recordOrder(const QString &orderId, const QString &store)
 
 void OrderManager::recordInvoicingInfo(const QString &shipmentOrRefundId,
                                        const InvoicingInfo *invoicingInfo)
+{
+    PreparedQueries queries(_db());
+    _recordInvoicingInfo(shipmentOrRefundId, invoicingInfo, queries);
+}
+
+void OrderManager::_recordInvoicingInfo(const QString &shipmentOrRefundId,
+                                        const InvoicingInfo *invoicingInfo,
+                                        PreparedQueries &queries)
 {
     if (!invoicingInfo) return;
     
@@ -322,20 +901,19 @@ void OrderManager::recordInvoicingInfo(const QString &shipmentOrRefundId,
     // If 'shipmentOrRefundId' is a revision, we fetch its root. If it's already a root, we use it directly.
     QString rootId = shipmentOrRefundId;
     {
-        QSqlQuery q;
-        q.prepare("SELECT COALESCE(root_id, id) FROM shipments WHERE id = ?");
+        QSqlQuery &q = queries.get(OrderManagerSql::SELECT_ROOT_ID);
         q.addBindValue(shipmentOrRefundId);
         if (q.exec() && q.next()) {
             rootId = q.value(0).toString();
         }
+        q.finish();
     }
     
     // 2. Persist the Info
     // We use INSERT OR REPLACE to update existing info or create new one.
-    QSqlQuery q;
-    q.prepare("INSERT OR REPLACE INTO invoicing_infos (shipment_root_id, json) VALUES (?, ?)");
+    QSqlQuery &q = queries.get(OrderManagerSql::UPSERT_INVOICING_INFO);
     q.addBindValue(rootId);
-    q.addBindValue(QString::fromUtf8(QJsonDocument(invoicingInfo->toJson()).toJson(QJsonDocument::Compact)));
+    q.addBindValue(invoicingInfo->toCbor());
     if (!q.exec()) {
         qWarning() << "Failed to record invoicing info:" << q.lastError();
     }
@@ -343,13 +921,14 @@ void OrderManager::recordInvoicingInfo(const QString &shipmentOrRefundId,
 
 QSharedPointer<InvoicingInfo> OrderManager::getInvoicingInfo(const QString &shipmentId) const
 {
+    QSqlDatabase db = _db();
     // 1. Resolve to Root ID
     // The incoming shipmentId might be a specific version/revision. 
     // We need to look up the info using the stable root ID.
     QString rootId = shipmentId;
     {
-        QSqlQuery q;
-        q.prepare("SELECT COALESCE(root_id, id) FROM shipments WHERE id = ?");
+        QSqlQuery q(db);
+        q.prepare(OrderManagerSql::SELECT_ROOT_ID);
         q.addBindValue(shipmentId);
         if (q.exec() && q.next()) {
             rootId = q.value(0).toString();
@@ -357,202 +936,837 @@ QSharedPointer<InvoicingInfo> OrderManager::getInvoicingInfo(const QString &ship
     }
     
     // 2. Retrieve Data
-    QSqlQuery q;
-    q.prepare("SELECT json FROM invoicing_infos WHERE shipment_root_id = ?");
+    QSqlQuery q(db);
+    q.prepare(OrderManagerSql::SELECT_INVOICING_INFO);
     q.addBindValue(rootId);
     if (q.exec() && q.next()) {
-        QJsonObject json = QJsonDocument::fromJson(q.value(0).toString().toUtf8()).object();
-        return QSharedPointer<InvoicingInfo>::create(InvoicingInfo::fromJson(json));
+        return QSharedPointer<InvoicingInfo>::create(InvoicingInfo::fromCbor(q.value(0).toByteArray()));
     }
     
     // Return empty pointer if not found
     return nullptr;
 }
 
-void OrderManager::publish(QDate &dateUntil)
+bool OrderManager::publish(QDate &dateUntil, std::function<bool(int, int)> progressCallback)
 {
-    m_db.transaction();
-    
-    QString dateParam = dateUntil.toString(Qt::ISODate);
-    
-    // Process Drafts (Including Revisions)
-    QSqlQuery qDrafts;
-    qDrafts.prepare("SELECT id, current_json, root_id FROM shipments WHERE status = 'Draft' AND (event_date IS NULL OR event_date <= ?)");
-    qDrafts.addBindValue(dateParam);
-    if (qDrafts.exec()) {
-        while (qDrafts.next()) {
-            QString id = qDrafts.value("id").toString();
-            QString jsonStr = qDrafts.value("current_json").toString();
-            QString rootId = qDrafts.value("root_id").toString();
-            
-            QJsonObject obj = QJsonDocument::fromJson(jsonStr.toUtf8()).object();
-            
-            // Parse Shipment to access activities
-            Shipment s = Shipment::fromJson(obj);
-            const auto &activities = s.getActivities();
-            
-            for (const auto &act : activities) {
-                double amount = act.getAmountTaxed() + act.getAmountTaxes();
-                QString currency = act.getCurrency();
-                QString date = act.getDateTime().toString(Qt::ISODate);
-                
-                // Determine Type
-                QString type = "Invoice";
-                if (!rootId.isEmpty() && id.contains("-rev-")) {
-                    type = "CreditNote";
-                }
-                
-                // If ID is same for all, we need unique PK for financial_events if multiple activities
-                // Assume 1 activity per shipment usually?
-                // Or append subActivityId / index?
-                // User said "Update also the json conversion and storage".
-                // Creating unique ID: shipmentId + activity index or subID??
-                QString subId = act.getSubActivityId();
-                QString uniqueRef = id;
-                if (!subId.isEmpty()) uniqueRef += "-" + subId;
-                else if (activities.size() > 1) {
-                    // Fallback to avoid PK collision if subId undefined but multiple acts
-                    // This is slightly risky but needed if no subId.
-                    // Assuming different hash or increment? can't easily increment.
-                    // Rely heavily on valid data model.
-                }
+    QSqlDatabase db = _db();
+    db.transaction();
+    QSqlQuery query(db);
+    auto fail = [&db](const QString &step, const QSqlQuery &failedQuery) {
+        qWarning() << "Failed to publish," << step << ":" << failedQuery.lastError().text();
+        db.rollback();
+        return false;
+    };
 
-                QString invoiceId = (type == "CreditNote") ? QString("CN-%1").arg(uniqueRef) : QString("INV-%1").arg(uniqueRef);
-                
-                // Serialize just this activity or the whole shipment?
-                // "content_json" usually whole shipment. But if broken down...
-                // The table has `shipment_id` FK.
-                // Keeping whole shipment JSON in each row is redundant but maybe safer for context?
-                // Or user meant "Activity" to be stored?
-                // I will store the whole shipment JSON as before, but create rows for each activity.
-
-                QSqlQuery qIns;
-                qIns.prepare("INSERT INTO financial_events (id, shipment_id, type, event_date, amount, currency, content_json) VALUES (?, ?, ?, ?, ?, ?, ?)");
-                qIns.addBindValue(invoiceId);
-                qIns.addBindValue(id);
-                qIns.addBindValue(type);
-                qIns.addBindValue(date);
-                qIns.addBindValue(amount);
-                qIns.addBindValue(currency);
-                qIns.addBindValue(jsonStr); 
-                if (!qIns.exec()) {
-                    // Ignore duplicate PK if single line? Or log warning?
-                    // If simple update, maybe delete old?
-                }
+    // 1. Drafts to publish (revisions included), in event date order
+    for (const QString &sql : OrderManagerSql::CREATE_PUBLISH_BATCH) {
+        if (!query.exec(sql)) {
+            return fail("publish_batch creation", query);
+        }
+    }
+    if (!query.exec(OrderManagerSql::CLEAR_PUBLISH_BATCH)) {
+        return fail("publish_batch clearing", query);
+    }
+    query.prepare(OrderManagerSql::INSERT_PUBLISH_BATCH_UNTIL);
+    query.addBindValue(dateUntil.toString(Qt::ISODate));
+    if (!query.exec()) {
+        return fail("drafts selection", query);
+    }
+    if (!query.exec(OrderManagerSql::SELECT_PUBLISH_BATCH_RANGE) || !query.next()) {
+        return fail("drafts count", query);
+    }
+    const qint64 firstRowId = query.value(0).toLongLong();
+    const qint64 lastRowId = query.value(1).toLongLong();
+    const int total = query.value(0).isNull() ? 0 : int(lastRowId - firstRowId + 1);
+    query.finish();
+
+    // 2. Events, status and published heads of a whole chunk per statement
+    PreparedQueries queries(db);
+    const QString publicationDate = QDateTime::currentDateTime().toString(Qt::ISODate);
+    for (qint64 chunkFirst = firstRowId; chunkFirst <= lastRowId && total > 0; chunkFirst += PUBLISH_CHUNK_SIZE) {
+        const qint64 chunkLast = qMin(chunkFirst + PUBLISH_CHUNK_SIZE - 1, lastRowId);
+
+        QSqlQuery &qEvents = queries.get(OrderManagerSql::INSERT_FINANCIAL_EVENTS_OF_BATCH);
+        qEvents.addBindValue(chunkFirst);
+        qEvents.addBindValue(chunkLast);
+        if (!qEvents.exec()) {
+            return fail("financial events insertion", qEvents);
+        }
+
+        QSqlQuery &qStatus = queries.get(OrderManagerSql::UPDATE_SHIPMENTS_PUBLISHED_OF_BATCH);
+        qStatus.addBindValue(publicationDate);
+        qStatus.addBindValue(chunkFirst);
+        qStatus.addBindValue(chunkLast);
+        if (!qStatus.exec()) {
+            return fail("status update", qStatus);
+        }
+
+        QSqlQuery &qHeads = queries.get(OrderManagerSql::UPDATE_PUBLISHED_HEADS_OF_BATCH);
+        qHeads.addBindValue(chunkFirst);
+        qHeads.addBindValue(chunkLast);
+        qHeads.addBindValue(chunkFirst);
+        qHeads.addBindValue(chunkLast);
+        if (!qHeads.exec()) {
+            return fail("published heads update", qHeads);
+        }
+
+        QSqlQuery &qAggregates = queries.get(OrderManagerSql::UPSERT_PERIOD_AGGREGATES_OF_BATCH);
+        qAggregates.addBindValue(chunkFirst);
+        qAggregates.addBindValue(chunkLast);
+        if (!qAggregates.exec()) {
+            return fail("period aggregates update", qAggregates);
+        }
+
+        QSqlQuery &qDirty = queries.get(OrderManagerSql::UPSERT_DIRTY_PERIODS_OF_BATCH);
+        qDirty.addBindValue(chunkFirst);
+        qDirty.addBindValue(chunkLast);
+        if (!qDirty.exec()) {
+            return fail("dirty periods update", qDirty);
+        }
+
+        QSqlQuery &qChanges = queries.get(OrderManagerSql::INSERT_CHANGES_OF_PUBLISH_BATCH);
+        qChanges.addBindValue(chunkFirst);
+        qChanges.addBindValue(chunkLast);
+        if (!qChanges.exec()) {
+            return fail("change log", qChanges);
+        }
+
+        if (progressCallback && !progressCallback(int(chunkLast - firstRowId + 1), total)) {
+            db.rollback();
+            return false;
+        }
+    }
+
+    query.exec(OrderManagerSql::CLEAR_PUBLISH_BATCH);
+    if (!db.commit()) {
+        qWarning() << "Failed to commit publish:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+void OrderManager::clearUnpublished()
+{
+    QSqlDatabase db = _db();
+    db.transaction();
+    QSqlQuery query(db);
+    for (const QString &sql : OrderManagerSql::CLEAR_UNPUBLISHED) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to clear unpublished:" << query.lastError().text();
+            db.rollback();
+            return;
+        }
+    }
+    if (!db.commit()) {
+        qWarning() << "Failed to commit clearing unpublished:" << db.lastError().text();
+        db.rollback();
+        return;
+    }
+    for (const auto &callback : std::as_const(m_clearedCallbacks)) {
+        callback();
+    }
+}
+
+void OrderManager::deleteDatabase()
+{
+    QSqlDatabase db = _db();
+    db.transaction();
+    QSqlQuery query(db);
+    for (const QString &sql : OrderManagerSql::DELETE_ALL) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to delete database:" << query.lastError().text();
+            db.rollback();
+            return;
+        }
+    }
+    if (!db.commit()) {
+        qWarning() << "Failed to commit deleting database:" << db.lastError().text();
+        db.rollback();
+        return;
+    }
+
+    const QStringList attachedSchemas = getAttachedSchemas(db);
+    for (const QString &schema : attachedSchemas) {
+        if (schema.startsWith('y')) {
+            query.exec(OrderManagerSql::DETACH_DATABASE.arg(schema));
+        }
+    }
+    const QList<int> years = getPartitionYears(m_workingDirectory);
+    for (int year : years) {
+        const QString filePath = m_workingDirectory.absoluteFilePath(PARTITION_FILE_NAME.arg(year));
+        setWritable(filePath, true);
+        if (!QFile::remove(filePath)) {
+            qWarning() << "Failed to remove partition" << filePath;
+        }
+    }
+    for (const auto &callback : std::as_const(m_clearedCallbacks)) {
+        callback();
+    }
+}
+
+void OrderManager::addClearedCallback(std::function<void()> callback)
+{
+    m_clearedCallbacks << std::move(callback);
+}
+
+OrderManager::CompactionReport OrderManager::compact()
+{
+    QElapsedTimer timer;
+    timer.start();
+    CompactionReport report;
+    QSqlDatabase db = _db();
+    QSqlQuery query(db);
+    auto databaseSize = [&query]() -> qint64 {
+        qint64 size = 0;
+        if (query.exec(OrderManagerSql::SELECT_DATABASE_SIZE) && query.next()) {
+            size = query.value(0).toLongLong();
+        }
+        query.finish();
+        return size;
+    };
+    report.bytesBefore = databaseSize();
+
+    // 1. Draft revisions left behind and dead invoicing infos, in one transaction
+    auto prune = [&query, &report]() {
+        for (const QString &sql : OrderManagerSql::CREATE_COMPACTION_BATCH) {
+            if (!query.exec(sql)) {
+                return false;
             }
-            
-            QSqlQuery qUpd;
-            qUpd.prepare("UPDATE shipments SET status = 'Published', published_json = current_json, publication_date = ? WHERE id = ?");
-            qUpd.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
-            qUpd.addBindValue(id);
-            qUpd.exec();
         }
+        if (!query.exec(OrderManagerSql::CLEAR_COMPACTION_BATCH)
+                || !query.exec(OrderManagerSql::INSERT_COMPACTION_ORPHAN_DRAFTS)
+                || !query.exec(OrderManagerSql::INSERT_COMPACTION_ORPHAN_REVERSALS)
+                || !query.exec(OrderManagerSql::SELECT_COMPACTION_BATCH_COUNT)
+                || !query.next()) {
+            return false;
+        }
+        report.draftsPruned = query.value(0).toInt();
+        query.finish();
+        for (const QString &sql : OrderManagerSql::DELETE_COMPACTION_BATCH) {
+            if (!query.exec(sql)) {
+                return false;
+            }
+        }
+        if (!query.exec(OrderManagerSql::DELETE_DEAD_INVOICING_INFOS)) {
+            return false;
+        }
+        report.invoicingInfosPruned = query.numRowsAffected();
+        return query.exec(OrderManagerSql::CLEAR_COMPACTION_BATCH);
+    };
+    db.transaction();
+    if (!prune()) {
+        qWarning() << "Failed to prune Orders.db:" << query.lastError().text();
+        db.rollback();
+        report.draftsPruned = 0;
+        report.invoicingInfosPruned = 0;
+    } else if (!db.commit()) {
+        qWarning() << "Failed to commit pruning Orders.db:" << db.lastError().text();
+        db.rollback();
+        report.draftsPruned = 0;
+        report.invoicingInfosPruned = 0;
     }
-    
-    m_db.commit();
+
+    // 2. Free pages given back to the file system. A database created before auto_vacuum was set
+    // is converted once by a full VACUUM
+    int autoVacuum = 0;
+    if (query.exec(OrderManagerSql::SELECT_AUTO_VACUUM) && query.next()) {
+        autoVacuum = query.value(0).toInt();
+    }
+    query.finish();
+    if (autoVacuum != 2) {
+        if (!query.exec(OrderManagerSql::AUTO_VACUUM_INCREMENTAL) || !query.exec(OrderManagerSql::VACUUM)) {
+            qWarning() << "Failed to vacuum Orders.db:" << query.lastError().text();
+        }
+    } else {
+        int freePages = 0;
+        if (query.exec(OrderManagerSql::SELECT_FREELIST_COUNT) && query.next()) {
+            freePages = query.value(0).toInt();
+        }
+        query.finish();
+        // The pragma frees one page per step and QSqlQuery steps once per exec()
+        db.transaction();
+        QSqlQuery qVacuum(db);
+        qVacuum.prepare(OrderManagerSql::INCREMENTAL_VACUUM);
+        for (int i = 0; i < freePages; ++i) {
+            if (!qVacuum.exec()) {
+                qWarning() << "Failed to vacuum Orders.db:" << qVacuum.lastError().text();
+                break;
+            }
+        }
+        qVacuum.finish();
+        db.commit();
+    }
+
+    // 3. Planner statistics, then the WAL is written back and truncated
+    for (const QString &sql : OrderManagerSql::ANALYZE) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to analyze Orders.db:" << query.lastError().text();
+        }
+    }
+    if (!query.exec(OrderManagerSql::WAL_CHECKPOINT_TRUNCATE)) {
+        qWarning() << "Failed to checkpoint Orders.db:" << query.lastError().text();
+    }
+    query.finish();
+
+    report.bytesAfter = databaseSize();
+    report.bytesReclaimed = report.bytesBefore - report.bytesAfter;
+    report.msecs = timer.elapsed();
+    return report;
 }
 
-ActivityUpdate *OrderManager::createActivityUpdateModel(const QString &shipmentId, QObject* parent)
+QList<OrderManager::ActivityTotal> OrderManager::getActivityTotals(const QDate &dateFrom, const QDate &dateTo) const
 {
-    ActivityUpdate *model = new ActivityUpdate(parent);
-    QList<ActivityUpdateItem> items;
-    
-    QSqlQuery q;
-    q.prepare("SELECT event_date, type, id, amount, currency FROM financial_events WHERE shipment_id = ? OR shipment_id LIKE ? ORDER BY event_date DESC");
-    q.addBindValue(shipmentId);
-    q.addBindValue(shipmentId + "-%"); // Match revisions
-    
-    if (q.exec()) {
-        while (q.next()) {
-            items.append({
-                QDateTime::fromString(q.value(0).toString(), Qt::ISODate),
-                q.value(1).toString(),
-                q.value(2).toString(),
-                q.value(3).toDouble(),
-                q.value(4).toString(),
-                "Issued"
-            });
+    QList<ActivityTotal> totals;
+    QSqlDatabase db = _db();
+    const QStringList schemas = _attachPartitions(db, dateFrom, dateTo);
+    QString sql = OrderManagerSql::SELECT_ACTIVITY_TOTALS_PERIOD;
+    if (schemas.size() > 1) {
+        QStringList selects;
+        for (const QString &schema : schemas) {
+            selects << OrderManagerSql::SELECT_ACTIVITY_TOTALS_OF_SCHEMA.arg(schema);
         }
+        sql = OrderManagerSql::SELECT_ACTIVITY_TOTALS_OF_UNION.arg(selects.join(" UNION ALL "));
     }
-    
-    model->setItems(items);
-    return model;
+    QSqlQuery query(db);
+    query.prepare(sql);
+    for (qsizetype i = 0; i < schemas.size(); ++i) {
+        bindPeriod(query, dateFrom, dateTo);
+    }
+    if (!query.exec()) {
+        qWarning() << "Failed to compute activity totals:" << query.lastError().text();
+        return totals;
+    }
+    while (query.next()) {
+        ActivityTotal total;
+        total.store = query.value(0).toString();
+        total.currency = query.value(1).toString();
+        total.countryCodeFrom = query.value(2).toString();
+        total.countryCodeTo = query.value(3).toString();
+        total.taxScheme = static_cast<TaxScheme>(query.value(4).toInt());
+        total.vatRate = query.value(5).toDouble();
+        total.amountTaxed = query.value(6).toDouble();
+        total.amountTaxes = query.value(7).toDouble();
+        total.count = query.value(8).toInt();
+        totals << total;
+    }
+    return totals;
 }
 
-QMultiMap<QDateTime, QSharedPointer<Shipment>> OrderManager::getShipmentAndRefunds(
-        const QDate &dateFrom,
-        const QDate &dateTo,
-        std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+QList<PeriodAggregate> OrderManager::getPeriodAggregates(const QDate &monthFrom,
+                                                         const QDate &monthTo,
+                                                         const ActivitySource *activitySource) const
 {
-    QMultiMap<QDateTime, QSharedPointer<Shipment>> results;
-    
-    QString queryStr = "SELECT current_json, source_key, event_date, id FROM shipments WHERE 1=1";
-    if (dateFrom.isValid()) {
-        queryStr += QString(" AND event_date >= '%1'").arg(dateFrom.toString(Qt::ISODate));
+    QList<PeriodAggregate> aggregates;
+    QSqlDatabase db = _db();
+    // Partitions only hold the aggregates of the rows archived before period_aggregates existed (migration 9),
+    // the later ones staying in Orders.db
+    const QStringList schemas = _attachPartitions(db, monthFrom, monthTo);
+    const QString sourceCondition = activitySource ? " AND source_key = ?" : "";
+    QStringList selects;
+    for (const QString &schema : schemas) {
+        selects << OrderManagerSql::SELECT_PERIOD_AGGREGATES_OF_SCHEMA.arg(schema, sourceCondition);
     }
-    if (dateTo.isValid()) {
-        queryStr += QString(" AND event_date <= '%1'").arg(dateTo.toString(Qt::ISODate));
+    QSqlQuery query(db);
+    query.prepare(OrderManagerSql::SELECT_PERIOD_AGGREGATES_OF_UNION.arg(selects.join(" UNION ALL ")));
+    for (qsizetype i = 0; i < schemas.size(); ++i) {
+        query.addBindValue(monthFrom.isValid() ? monthFrom.toString("yyyy-MM") : OrderManagerSql::EVENT_DATE_MIN);
+        query.addBindValue(monthTo.isValid() ? monthTo.toString("yyyy-MM") : OrderManagerSql::EVENT_DATE_MAX);
+        if (activitySource) {
+            query.addBindValue(activitySource->toKey());
+        }
+    }
+    if (!query.exec()) {
+        qWarning() << "Failed to read period aggregates:" << query.lastError().text();
+        return aggregates;
     }
-    
-    QSqlQuery query(queryStr);
-    
     while (query.next()) {
-        QString jsonStr = query.value(0).toString();
-        QString sourceKey = query.value(1).toString();
-        QString dateStr = query.value(2).toString();
-        QString id = query.value(3).toString();
-        QDateTime eventDate = QDateTime::fromString(dateStr, Qt::ISODate);
-        
-        // Parse Source
-        // source_key: type|channel|subchannel|report
-        QStringList parts = sourceKey.split('|');
-        ActivitySource source;
-        if (parts.size() >= 4) {
-             source.type = static_cast<ActivitySourceType>(parts[0].toInt());
-             source.channel = parts[1];
-             source.subchannel = parts[2];
-             source.reportOrMethode = parts[3];
-        } else {
-            source.type = ActivitySourceType::API; // Default
+        PeriodAggregate aggregate;
+        aggregate.month = QDate::fromString(query.value(0).toString() + "-01", Qt::ISODate);
+        aggregate.source = ActivitySource::fromKey(query.value(1).toString());
+        aggregate.store = query.value(2).toString();
+        aggregate.taxScheme = static_cast<TaxScheme>(query.value(3).toInt());
+        aggregate.countryCodeFrom = query.value(4).toString();
+        aggregate.countryCodeTo = query.value(5).toString();
+        aggregate.vatRate = query.value(6).toDouble();
+        aggregate.currency = query.value(7).toString();
+        aggregate.amountTaxed = query.value(8).toDouble();
+        aggregate.amountTaxes = query.value(9).toDouble();
+        aggregate.count = query.value(10).toInt();
+        aggregates << aggregate;
+    }
+    return aggregates;
+}
+
+QList<OrderManager::DirtyPeriod> OrderManager::getDirtyPeriods() const
+{
+    QList<DirtyPeriod> dirtyPeriods;
+    QSqlQuery query(_db());
+    if (!query.exec(OrderManagerSql::SELECT_DIRTY_PERIODS)) {
+        qWarning() << "Failed to read dirty periods:" << query.lastError().text();
+        return dirtyPeriods;
+    }
+    while (query.next()) {
+        DirtyPeriod dirtyPeriod;
+        dirtyPeriod.source = ActivitySource::fromKey(query.value(0).toString());
+        dirtyPeriod.store = query.value(1).toString();
+        dirtyPeriod.month = QDate::fromString(query.value(2).toString() + "-01", Qt::ISODate);
+        dirtyPeriod.version = query.value(3).toLongLong();
+        dirtyPeriods << dirtyPeriod;
+    }
+    return dirtyPeriods;
+}
+
+void OrderManager::markPeriodClean(const DirtyPeriod &dirtyPeriod)
+{
+    QSqlQuery query(_db());
+    query.prepare(OrderManagerSql::DELETE_DIRTY_PERIOD);
+    query.addBindValue(dirtyPeriod.source.toKey());
+    query.addBindValue(dirtyPeriod.store);
+    query.addBindValue(dirtyPeriod.month.toString("yyyy-MM"));
+    query.addBindValue(dirtyPeriod.version);
+    if (!query.exec()) {
+        qWarning() << "Failed to mark period" << dirtyPeriod.month << "clean:" << query.lastError().text();
+    }
+}
+
+qint64 OrderManager::changesSince(qint64 seq, std::function<bool(const Change &)> callback) const
+{
+    QSqlQuery query(_db());
+    query.setForwardOnly(true);
+    query.prepare(OrderManagerSql::SELECT_CHANGES_SINCE);
+    query.addBindValue(seq);
+    if (!query.exec()) {
+        qWarning() << "Failed to read changes since" << seq << ":" << query.lastError().text();
+        return seq;
+    }
+    qint64 lastSeq = seq;
+    while (query.next()) {
+        Change change;
+        change.seq = query.value(0).toLongLong();
+        change.shipmentId = query.value(1).toString();
+        change.rootId = query.value(2).toString();
+        if (!query.value(3).isNull()) {
+            change.source = ActivitySource::fromKey(query.value(3).toString());
         }
-        
-        // Parse Shipment
-        QJsonObject obj = QJsonDocument::fromJson(jsonStr.toUtf8()).object();
-        QSharedPointer<Shipment> shipment = QSharedPointer<Shipment>::create(Shipment::fromJson(obj));
-        
-        // Check for Reversal
-        if (id.contains("-rev-")) {
-            QList<Activity> newActs;
-            for (const auto &act : shipment->getActivities()) {
-                Amount negatedAmount(-act.getAmountTaxed(), -act.getAmountTaxesSource());
-                auto res = Activity::create(act.getEventId(),
-                                            act.getActivityId(),
-                                            act.getSubActivityId(),
-                                            act.getDateTime(),
-                                            act.getCurrency(),
-                                            act.getCountryCodeFrom(),
-                                            act.getCountryCodeTo(),
-                                            act.getCountryCodeVatPaidTo(),
-                                            negatedAmount,
-                                            act.getTaxSource(),
-                                            act.getTaxDeclaringCountryCode(),
-                                            act.getTaxScheme(),
-                                            act.getTaxJurisdictionLevel(),
-                                            act.getSaleType(),
-                                            act.getVatTerritoryFrom(),
-                                            act.getVatTerritoryTo());
-               if (res.value) {
-                   newActs.append(*res.value);
-               }
+        change.eventDate = QDate::fromString(query.value(4).toString().left(10), Qt::ISODate);
+        change.kind = toChangeKind(query.value(5).toString());
+        change.changedAt = QDateTime::fromString(query.value(6).toString(), Qt::ISODate);
+        lastSeq = change.seq;
+        if (callback && !callback(change)) {
+            break;
+        }
+    }
+    return lastSeq;
+}
+
+qint64 OrderManager::getLastChangeSeq() const
+{
+    QSqlQuery query(_db());
+    if (!query.exec(OrderManagerSql::SELECT_LAST_CHANGE_SEQ) || !query.next()) {
+        qWarning() << "Failed to read the last change:" << query.lastError().text();
+        return 0;
+    }
+    return query.value(0).toLongLong();
+}
+
+void OrderManager::pruneChanges(qint64 seqUntil)
+{
+    QSqlQuery query(_db());
+    query.prepare(OrderManagerSql::DELETE_CHANGES_UNTIL);
+    query.addBindValue(seqUntil);
+    if (!query.exec()) {
+        qWarning() << "Failed to prune changes until" << seqUntil << ":" << query.lastError().text();
+    }
+}
+
+bool OrderManager::copyDatabase(const QString &filePath, int yearUntil)
+{
+    QSqlDatabase db = _db();
+    return _fillArchiveBatch(db, yearUntil) && _copyArchiveBatch(db, filePath, 0, yearUntil);
+}
+
+bool OrderManager::removeInDatabase(int yearUntil)
+{
+    QSqlDatabase db = _db();
+    return _fillArchiveBatch(db, yearUntil) && _removeArchiveBatch(db, ChangeKind::Removed);
+}
+
+bool OrderManager::archiveYears(int yearUntil)
+{
+    QSqlDatabase db = _db();
+    if (!_fillArchiveBatch(db, yearUntil)) {
+        return false;
+    }
+    QSqlQuery query(db);
+    if (!query.exec(OrderManagerSql::SELECT_ARCHIVE_BATCH_YEAR_RANGE) || !query.next()) {
+        qWarning() << "Failed to read the years to archive:" << query.lastError().text();
+        return false;
+    }
+    if (query.value(0).isNull()) {
+        return true; // Nothing to archive
+    }
+    const int firstYear = query.value(0).toInt();
+    const int lastYear = query.value(1).toInt();
+    query.finish();
+
+    for (int year = firstYear; year <= lastYear; ++year) {
+        query.prepare(OrderManagerSql::SELECT_ARCHIVE_BATCH_HAS_YEAR);
+        query.addBindValue(year);
+        if (!query.exec() || !query.next()) {
+            qWarning() << "Failed to read the rows to archive of" << year << ":" << query.lastError().text();
+            return false;
+        }
+        if (!query.value(0).toBool()) {
+            continue;
+        }
+        query.finish();
+        const QString filePath = m_workingDirectory.absoluteFilePath(PARTITION_FILE_NAME.arg(year));
+        const bool copied = _copyArchiveBatch(db, filePath, year, year);
+        setWritable(filePath, false);
+        if (!copied) {
+            return false;
+        }
+    }
+    // Removed from Orders.db once every partition is written. If interrupted before, archiving again replaces the copies
+    return _removeArchiveBatch(db, ChangeKind::Archived);
+}
+
+bool OrderManager::_fillArchiveBatch(QSqlDatabase db, int yearUntil)
+{
+    QSqlQuery query(db);
+    for (const QString &sql : OrderManagerSql::CREATE_ARCHIVE_BATCH) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to create archive_batch:" << query.lastError().text();
+            return false;
+        }
+    }
+    if (!query.exec(OrderManagerSql::CLEAR_ARCHIVE_BATCH)) {
+        qWarning() << "Failed to clear archive_batch:" << query.lastError().text();
+        return false;
+    }
+    const QString dateBefore = QDate(yearUntil + 1, 1, 1).toString(Qt::ISODate);
+    query.prepare(OrderManagerSql::INSERT_ARCHIVE_BATCH_BEFORE);
+    query.addBindValue(dateBefore);
+    query.addBindValue(dateBefore);
+    if (!query.exec()) {
+        qWarning() << "Failed to select the rows to archive until" << yearUntil << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool OrderManager::_copyArchiveBatch(QSqlDatabase db, const QString &filePath, int yearFrom, int yearTo)
+{
+    if (!_initPartition(filePath)) {
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare(OrderManagerSql::ATTACH_DATABASE.arg(ARCHIVE_SCHEMA));
+    query.addBindValue(filePath);
+    if (!query.exec()) {
+        qWarning() << "Failed to attach" << filePath << ":" << query.lastError().text();
+        return false;
+    }
+
+    bool ok = true;
+    db.transaction();
+    for (const QString &sql : OrderManagerSql::COPY_ARCHIVE_BATCH) {
+        query.prepare(sql.arg(ARCHIVE_SCHEMA));
+        query.addBindValue(yearFrom);
+        query.addBindValue(yearTo);
+        if (!query.exec()) {
+            qWarning() << "Failed to copy to" << filePath << ":" << query.lastError().text();
+            ok = false;
+            break;
+        }
+    }
+    if (ok && !db.commit()) {
+        qWarning() << "Failed to commit the copy to" << filePath << ":" << db.lastError().text();
+        ok = false;
+    }
+    if (!ok) {
+        db.rollback();
+    }
+
+    query.finish();
+    if (!query.exec(OrderManagerSql::DETACH_DATABASE.arg(ARCHIVE_SCHEMA))) {
+        qWarning() << "Failed to detach" << filePath << ":" << query.lastError().text();
+    }
+    return ok;
+}
+
+bool OrderManager::_removeArchiveBatch(QSqlDatabase db, ChangeKind changeKind)
+{
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare(OrderManagerSql::INSERT_CHANGES_OF_ARCHIVE_BATCH);
+    query.addBindValue(toString(changeKind));
+    if (!query.exec()) {
+        qWarning() << "Failed to log archived rows:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    for (const QString &sql : OrderManagerSql::DELETE_ARCHIVE_BATCH) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to remove archived rows:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    query.exec(OrderManagerSql::CLEAR_ARCHIVE_BATCH);
+    if (!db.commit()) {
+        qWarning() << "Failed to commit the removal of archived rows:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+QStringList OrderManager::_attachPartitions(QSqlDatabase db, const QDate &dateFrom, const QDate &dateTo) const
+{
+    QStringList schemas{"main"};
+    QStringList neededSchemas;
+    const QList<int> years = getPartitionYears(m_workingDirectory);
+    for (int year : years) {
+        if ((dateFrom.isValid() && year < dateFrom.year()) || (dateTo.isValid() && year > dateTo.year())) {
+            continue;
+        }
+        neededSchemas << PARTITION_SCHEMA.arg(year);
+    }
+    if (neededSchemas.isEmpty()) {
+        return schemas; // Open periods only, in Orders.db
+    }
+
+    const QStringList attachedSchemas = getAttachedSchemas(db);
+    QSqlQuery query(db);
+    // SQLite attaches up to 10 databases by default: partitions of previous periods are detached
+    // (unless a cursor still reads them)
+    for (const QString &schema : std::as_const(attachedSchemas)) {
+        if (schema.startsWith('y') && !neededSchemas.contains(schema)) {
+            query.exec(OrderManagerSql::DETACH_DATABASE.arg(schema));
+        }
+    }
+    for (const QString &schema : std::as_const(neededSchemas)) {
+        if (!attachedSchemas.contains(schema)) {
+            const QString filePath = m_workingDirectory.absoluteFilePath(PARTITION_FILE_NAME.arg(schema.mid(1)));
+            query.prepare(OrderManagerSql::ATTACH_DATABASE.arg(schema));
+            query.addBindValue(QUrl::fromLocalFile(filePath).toString(QUrl::FullyEncoded) + "?mode=ro");
+            if (!query.exec()) {
+                qWarning() << "Failed to attach partition" << filePath << ":" << query.lastError().text();
+                continue;
             }
-            shipment = QSharedPointer<Shipment>::create(Shipment(newActs));
         }
+        schemas << schema;
+    }
+    return schemas;
+}
+
+OrderTimeline OrderManager::getOrderTimeline(const QString &orderId) const
+{
+    OrderTimeline timeline;
+    timeline.orderId = orderId;
+    QSqlDatabase db = _db();
+    const bool snapshot = db.transaction(); // One snapshot for the four reads, unless already in a transaction
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
 
-        if (!acceptCallback || acceptCallback(&source, shipment.data())) {
-            results.insert(eventDate, shipment);
+    query.prepare(OrderManagerSql::SELECT_ORDER);
+    query.addBindValue(orderId);
+    if (query.exec() && query.next()) {
+        timeline.found = true;
+        timeline.store = query.value(0).toString();
+        const QString addressJson = query.value(1).toString();
+        if (!addressJson.isEmpty()) {
+            timeline.addressTo = QSharedPointer<Address>::create(
+                        Address::fromJson(QJsonDocument::fromJson(addressJson.toUtf8()).object()));
+        }
+    }
+    query.finish();
+
+    query.prepare(OrderManagerSql::SELECT_SHIPMENTS_OF_ORDER);
+    query.addBindValue(orderId);
+    if (query.exec()) {
+        while (query.next()) {
+            OrderTimeline::Revision revision;
+            revision.id = query.value(0).toString();
+            revision.rootId = query.value(1).toString();
+            revision.revisionKind = toRevisionKind(query.value(2).toString());
+            revision.status = query.value(3).toString();
+            revision.eventDate = QDateTime::fromString(query.value(4).toString(), Qt::ISODate);
+            revision.publicationDate = QDateTime::fromString(query.value(5).toString(), Qt::ISODate);
+            revision.source = ActivitySource::fromKey(query.value(6).toString());
+            revision.shipment = QSharedPointer<Shipment>::create(Shipment::fromCbor(query.value(7).toByteArray()));
+            revision.isHead = query.value(8).toBool();
+            revision.isPublishedHead = query.value(9).toBool();
+            timeline.revisions << revision;
+        }
+    } else {
+        qWarning() << "Failed to read the shipments of order" << orderId << ":" << query.lastError().text();
+    }
+    query.finish();
+    timeline.found = timeline.found || !timeline.revisions.isEmpty();
+
+    query.prepare(OrderManagerSql::SELECT_FINANCIAL_EVENTS_OF_ORDER);
+    query.addBindValue(orderId);
+    if (query.exec()) {
+        while (query.next()) {
+            OrderTimeline::FinancialEvent event;
+            event.eventDate = QDateTime::fromString(query.value(0).toString(), Qt::ISODate);
+            event.type = query.value(1).toString();
+            event.id = query.value(2).toString();
+            event.amount = query.value(3).toDouble();
+            event.currency = query.value(4).toString();
+            event.shipmentId = query.value(5).toString();
+            timeline.financialEvents << event;
+        }
+    } else {
+        qWarning() << "Failed to read the financial events of order" << orderId << ":" << query.lastError().text();
+    }
+    query.finish();
+
+    query.prepare(OrderManagerSql::SELECT_INVOICING_INFOS_OF_ORDER);
+    query.addBindValue(orderId);
+    if (query.exec()) {
+        while (query.next()) {
+            timeline.rootId_invoicingInfo.insert(
+                        query.value(0).toString(),
+                        QSharedPointer<InvoicingInfo>::create(InvoicingInfo::fromCbor(query.value(1).toByteArray())));
+        }
+    } else {
+        qWarning() << "Failed to read the invoicing infos of order" << orderId << ":" << query.lastError().text();
+    }
+    query.finish();
+    if (snapshot) {
+        db.commit();
+    }
+    return timeline;
+}
+
+ActivityUpdate *OrderManager::createActivityUpdateModel(const QString &shipmentId, QObject* parent)
+{
+    ActivityUpdate *model = new ActivityUpdate(parent);
+    auto pager = QSharedPointer<KeysetPager>::create(
+                _db(),
+                OrderManagerSql::SELECT_FINANCIAL_EVENTS_OF_ROOT_PAGE,
+                OrderManagerSql::FINANCIAL_EVENTS_PAGE_KEYS,
+                QVariantList{shipmentId, shipmentId}, // Match revisions by root_id
+                KeysetPager::Order::Descending);
+    model->setPager(pager, [](const QVariantList &row) -> ActivityUpdateItem {
+        return {
+            QDateTime::fromString(row[0].toString(), Qt::ISODate),
+            row[1].toString(),
+            row[2].toString(),
+            row[3].toDouble(),
+            row[4].toString(),
+            "Issued"
+        };
+    });
+    // The first page only, the next ones are fetched as the view scrolls
+    model->fetchMore(QModelIndex());
+    return model;
+}
+
+QSharedPointer<KeysetPager> OrderManager::openShipmentPager(const ShipmentQuery &shipmentQuery,
+                                                            ShipmentSort sort,
+                                                            KeysetPager::Order order) const
+{
+    QStringList keyColumns;
+    switch (sort) {
+    case ShipmentSort::EventDate:
+        keyColumns = OrderManagerSql::SHIPMENTS_PAGE_KEYS_EVENT_DATE;
+        break;
+    case ShipmentSort::OrderId:
+        keyColumns = OrderManagerSql::SHIPMENTS_PAGE_KEYS_ORDER_ID;
+        break;
+    case ShipmentSort::Id:
+        keyColumns = OrderManagerSql::SHIPMENTS_PAGE_KEYS_ID;
+        break;
+    case ShipmentSort::Source:
+        keyColumns = OrderManagerSql::SHIPMENTS_PAGE_KEYS_SOURCE;
+        break;
+    case ShipmentSort::Status:
+        keyColumns = OrderManagerSql::SHIPMENTS_PAGE_KEYS_STATUS;
+        break;
+    }
+    QStringList orderBy;
+    for (const auto &column : std::as_const(keyColumns)) {
+        orderBy << (order == KeysetPager::Order::Ascending ? column : column + " DESC");
+    }
+    // The period is selected with the date index only when reading in date order. An order id prefix
+    // selects few rows with idx_shipments_order, sorted afterwards
+    const bool useDateIndex = sort == ShipmentSort::EventDate && shipmentQuery.orderIdPrefix.isEmpty();
+    QVariantList bindValues;
+    const QString sql = OrderManagerSql::SELECT_SHIPMENTS_PAGE.arg(
+                keyColumns.join(", "),
+                shipmentQuery.toWhereClause(bindValues, "main", useDateIndex),
+                orderBy.join(", "),
+                "%1");
+    return QSharedPointer<KeysetPager>::create(_db(), sql, keyColumns, bindValues, order);
+}
+
+QSharedPointer<ShipmentCursor> OrderManager::openShipmentCursor(const QDate &dateFrom,
+                                                                const QDate &dateTo,
+                                                                const ActivitySource *activitySource) const
+{
+    ShipmentQuery shipmentQuery;
+    shipmentQuery.dateFrom = dateFrom;
+    shipmentQuery.dateTo = dateTo;
+    if (activitySource) {
+        shipmentQuery.sources << *activitySource;
+    }
+    return openShipmentCursor(shipmentQuery);
+}
+
+QSharedPointer<ShipmentCursor> OrderManager::openShipmentCursor(const ShipmentQuery &shipmentQuery) const
+{
+    QSqlDatabase db = _db();
+    const QStringList schemas = _attachPartitions(db, shipmentQuery.dateFrom, shipmentQuery.dateTo);
+    QVariantList bindValues;
+    QString sql;
+    if (schemas.size() == 1) {
+        sql = OrderManagerSql::SELECT_SHIPMENTS_QUERY.arg(shipmentQuery.toWhereClause(bindValues));
+    } else {
+        QStringList selects;
+        for (const QString &schema : schemas) {
+            selects << OrderManagerSql::SELECT_SHIPMENTS_OF_SCHEMA.arg(schema, shipmentQuery.toWhereClause(bindValues, schema));
+        }
+        sql = selects.join(" UNION ALL ") + " ORDER BY event_date";
+    }
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    for (const auto &value : std::as_const(bindValues)) {
+        query.addBindValue(value);
+    }
+    if (!query.exec()) {
+        qWarning() << "Failed to open shipment cursor:" << query.lastError().text();
+    }
+    return QSharedPointer<ShipmentCursor>::create(std::move(query));
+}
+
+QMultiMap<QDateTime, QSharedPointer<Shipment>> OrderManager::getShipmentAndRefunds(
+        const QDate &dateFrom,
+        const QDate &dateTo,
+        std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+{
+    ShipmentQuery shipmentQuery;
+    shipmentQuery.dateFrom = dateFrom;
+    shipmentQuery.dateTo = dateTo;
+    return getShipmentAndRefunds(shipmentQuery, acceptCallback);
+}
+
+QMultiMap<QDateTime, QSharedPointer<Shipment>> OrderManager::getShipmentAndRefunds(
+        const ShipmentQuery &shipmentQuery,
+        std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+{
+    QMultiMap<QDateTime, QSharedPointer<Shipment>> results;
+    auto cursor = openShipmentCursor(shipmentQuery);
+    while (cursor->next()) {
+        if (!acceptCallback || acceptCallback(&cursor->getActivitySource(), &cursor->getShipment())) {
+            results.insert(cursor->getDateTime(), QSharedPointer<Shipment>::create(cursor->getShipment()));
         }
     }
-    
     return results;
 }
 
@@ -561,74 +1775,24 @@ QHash<ActivitySource, QMultiMap<QDateTime, QSharedPointer<Shipment>>> OrderManag
         const QDate &dateTo,
         std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
 {
-    QHash<ActivitySource, QMultiMap<QDateTime, QSharedPointer<Shipment>>> results;
-    
-    QString queryStr = "SELECT current_json, source_key, event_date, id FROM shipments WHERE 1=1";
-    if (dateFrom.isValid()) {
-        queryStr += QString(" AND event_date >= '%1'").arg(dateFrom.toString(Qt::ISODate));
-    }
-    if (dateTo.isValid()) {
-        queryStr += QString(" AND event_date <= '%1'").arg(dateTo.toString(Qt::ISODate));
-    }
-    
-    QSqlQuery query(queryStr);
-    
-    while (query.next()) {
-        QString jsonStr = query.value(0).toString();
-        QString sourceKey = query.value(1).toString();
-        QString dateStr = query.value(2).toString();
-        QString id = query.value(3).toString();
-        QDateTime eventDate = QDateTime::fromString(dateStr, Qt::ISODate);
-        
-        // Parse Source
-        QStringList parts = sourceKey.split('|');
-        ActivitySource source;
-        if (parts.size() >= 4) {
-             source.type = static_cast<ActivitySourceType>(parts[0].toInt());
-             source.channel = parts[1];
-             source.subchannel = parts[2];
-             source.reportOrMethode = parts[3];
-        } else {
-            source.type = ActivitySourceType::API; // Default
-        }
-        
-        // Parse Shipment
-        QJsonObject obj = QJsonDocument::fromJson(jsonStr.toUtf8()).object();
-        QSharedPointer<Shipment> shipment = QSharedPointer<Shipment>::create(Shipment::fromJson(obj));
-        
-        // Check for Reversal
-        if (id.contains("-rev-")) {
-            QList<Activity> newActs;
-            for (const auto &act : shipment->getActivities()) {
-                Amount negatedAmount(-act.getAmountTaxed(), -act.getAmountTaxesSource());
-                auto res = Activity::create(act.getEventId(),
-                                            act.getActivityId(),
-                                            act.getSubActivityId(),
-                                            act.getDateTime(),
-                                            act.getCurrency(),
-                                            act.getCountryCodeFrom(),
-                                            act.getCountryCodeTo(),
-                                            act.getCountryCodeVatPaidTo(),
-                                            negatedAmount,
-                                            act.getTaxSource(),
-                                            act.getTaxDeclaringCountryCode(),
-                                            act.getTaxScheme(),
-                                            act.getTaxJurisdictionLevel(),
-                                            act.getSaleType(),
-                                            act.getVatTerritoryFrom(),
-                                            act.getVatTerritoryTo());
-               if (res.value) {
-                   newActs.append(*res.value);
-               }
-            }
-            shipment = QSharedPointer<Shipment>::create(Shipment(newActs));
-        }
+    ShipmentQuery shipmentQuery;
+    shipmentQuery.dateFrom = dateFrom;
+    shipmentQuery.dateTo = dateTo;
+    return getActivitySource_ShipmentAndRefunds(shipmentQuery, acceptCallback);
+}
 
-        if (!acceptCallback || acceptCallback(&source, shipment.data())) {
-            results[source].insert(eventDate, shipment);
+QHash<ActivitySource, QMultiMap<QDateTime, QSharedPointer<Shipment>>> OrderManager::getActivitySource_ShipmentAndRefunds(
+        const ShipmentQuery &shipmentQuery,
+        std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+{
+    QHash<ActivitySource, QMultiMap<QDateTime, QSharedPointer<Shipment>>> results;
+    auto cursor = openShipmentCursor(shipmentQuery);
+    while (cursor->next()) {
+        if (!acceptCallback || acceptCallback(&cursor->getActivitySource(), &cursor->getShipment())) {
+            results[cursor->getActivitySource()].insert(
+                        cursor->getDateTime(), QSharedPointer<Shipment>::create(cursor->getShipment()));
         }
     }
-    
     return results;
 }
 
@@ -658,48 +1822,31 @@ OrderManager::ConflictStatus OrderManager::checkConflict(const Shipment &existin
     return ConflictStatus::ContentDiffers;
 }
 
-QSharedPointer<Shipment> OrderManager::getHeadShipment(const QString &id, QString *outStatus, QString *outJson) const
+QSharedPointer<Shipment> OrderManager::getHeadShipment(const QString &id, QString *outStatus, QByteArray *outData) const
 {
-    // 1. Check Drafts (including revisions)
-    {
-        QSqlQuery q;
-        q.prepare("SELECT id, current_json, status FROM shipments WHERE status = 'Draft' AND (root_id = ? OR id = ?) ORDER BY event_date DESC, id DESC LIMIT 1");
-        q.addBindValue(id);
-        q.addBindValue(id);
-        if (q.exec() && q.next()) {
-             if (outStatus) *outStatus = q.value("status").toString();
-             if (outJson) *outJson = q.value("current_json").toString();
-             QJsonObject obj = QJsonDocument::fromJson(q.value("current_json").toString().toUtf8()).object();
-             return QSharedPointer<Shipment>::create(Shipment::fromJson(obj));
-        }
-    }
+    // 1. Head of a root shipment (maintained on insert / publish)
+    QSqlQuery q(_db());
+    q.prepare(OrderManagerSql::SELECT_HEAD_SHIPMENT);
+    q.addBindValue(id);
+    bool found = q.exec() && q.next();
 
-    // 2. Check Published Revisions
-    {
-        QSqlQuery q;
-        q.prepare("SELECT id, current_json, status FROM shipments WHERE status = 'Published' AND root_id = ? ORDER BY event_date DESC, id DESC LIMIT 1");
+    // 2. A revision ID is its own head
+    if (!found) {
+        q.prepare(OrderManagerSql::SELECT_SHIPMENT);
         q.addBindValue(id);
-        if (q.exec() && q.next()) {
-             if (outStatus) *outStatus = q.value("status").toString();
-             if (outJson) *outJson = q.value("current_json").toString();
-             QJsonObject obj = QJsonDocument::fromJson(q.value("current_json").toString().toUtf8()).object();
-             return QSharedPointer<Shipment>::create(Shipment::fromJson(obj));
-        }
+        found = q.exec() && q.next();
     }
 
-    // 3. Check Original (if not covered above)
-    {
-         QSqlQuery q;
-         q.prepare("SELECT id, current_json, status FROM shipments WHERE id = ?");
-         q.addBindValue(id);
-         if (q.exec() && q.next()) {
-             if (outStatus) *outStatus = q.value("status").toString();
-             if (outJson) *outJson = q.value("current_json").toString();
-             QJsonObject obj = QJsonDocument::fromJson(q.value("current_json").toString().toUtf8()).object();
-             return QSharedPointer<Shipment>::create(Shipment::fromJson(obj));
-         }
+    if (found) {
+        const QByteArray data = q.value("current_data").toByteArray();
+        if (outStatus) {
+            *outStatus = q.value("status").toString();
+        }
+        if (outData) {
+            *outData = data;
+        }
+        return QSharedPointer<Shipment>::create(Shipment::fromCbor(data));
     }
-
     return nullptr;
 }
 
@@ -712,7 +1859,19 @@ QSharedPointer<Shipment> OrderManager::getShipmentOrRefundIfDifferent(const QStr
 
     if (!shipmentOrRefund) return nullptr;
     
-    QSharedPointer<Shipment> existing = getHeadShipment(shipmentOrRefund->getId());
+    // Unchanged re-imports are detected on the stored hash without decoding the head
+    QSharedPointer<Shipment> existing;
+    QSqlQuery q(_db());
+    q.prepare(OrderManagerSql::SELECT_HEAD_SHIPMENT);
+    q.addBindValue(shipmentOrRefund->getId());
+    if (q.exec() && q.next()) {
+        if (q.value("content_hash").toByteArray() == getContentHash(shipmentOrRefund->toCbor())) {
+            return nullptr;
+        }
+        existing = QSharedPointer<Shipment>::create(Shipment::fromCbor(q.value("current_data").toByteArray()));
+    } else {
+        existing = getHeadShipment(shipmentOrRefund->getId());
+    }
     if (!existing) return nullptr;
     
     ConflictStatus status = checkConflict(*existing, *shipmentOrRefund);
@@ -725,82 +1884,27 @@ QSharedPointer<Shipment> OrderManager::getShipmentOrRefundIfDifferent(const QStr
 }
 
 QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>> OrderManager::getActivitySource_store_ShipmentAndRefunds(
-        const QDate &dateFrom
-        , const QDate &dateTo
-        , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+        const QDate &dateFrom,
+        const QDate &dateTo,
+        std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
 {
-    QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>> results;
-
-    QString queryStr = "SELECT s.current_json, s.source_key, s.event_date, s.id, o.store "
-                       "FROM shipments s "
-                       "LEFT JOIN orders o ON s.order_id = o.id "
-                       "WHERE 1=1";
-
-    if (dateFrom.isValid()) {
-        queryStr += QString(" AND s.event_date >= '%1'").arg(dateFrom.toString(Qt::ISODate));
-    }
-    if (dateTo.isValid()) {
-        queryStr += QString(" AND s.event_date <= '%1'").arg(dateTo.toString(Qt::ISODate));
-    }
-
-    QSqlQuery query(queryStr);
-
-    while (query.next()) {
-        QString jsonStr = query.value(0).toString();
-        QString sourceKey = query.value(1).toString();
-        QString dateStr = query.value(2).toString();
-        QString id = query.value(3).toString();
-        QString store = query.value(4).toString();
-        QDateTime eventDate = QDateTime::fromString(dateStr, Qt::ISODate);
-
-        // Parse Source
-        QStringList parts = sourceKey.split('|');
-        ActivitySource source;
-        if (parts.size() >= 4) {
-             source.type = static_cast<ActivitySourceType>(parts[0].toInt());
-             source.channel = parts[1];
-             source.subchannel = parts[2];
-             source.reportOrMethode = parts[3];
-        } else {
-            source.type = ActivitySourceType::API; // Default
-        }
-
-        // Parse Shipment
-        QJsonObject obj = QJsonDocument::fromJson(jsonStr.toUtf8()).object();
-        QSharedPointer<Shipment> shipment = QSharedPointer<Shipment>::create(Shipment::fromJson(obj));
-
-        // Check for Reversal
-        if (id.contains("-rev-")) {
-            QList<Activity> newActs;
-            for (const auto &act : shipment->getActivities()) {
-                Amount negatedAmount(-act.getAmountTaxed(), -act.getAmountTaxesSource());
-                auto res = Activity::create(act.getEventId(),
-                                            act.getActivityId(),
-                                            act.getSubActivityId(),
-                                            act.getDateTime(),
-                                            act.getCurrency(),
-                                            act.getCountryCodeFrom(),
-                                            act.getCountryCodeTo(),
-                                            act.getCountryCodeVatPaidTo(),
-                                            negatedAmount,
-                                            act.getTaxSource(),
-                                            act.getTaxDeclaringCountryCode(),
-                                            act.getTaxScheme(),
-                                            act.getTaxJurisdictionLevel(),
-                                            act.getSaleType(),
-                                            act.getVatTerritoryFrom(),
-                                            act.getVatTerritoryTo());
-               if (res.value) {
-                   newActs.append(*res.value);
-               }
-            }
-            shipment = QSharedPointer<Shipment>::create(Shipment(newActs));
-        }
+    ShipmentQuery shipmentQuery;
+    shipmentQuery.dateFrom = dateFrom;
+    shipmentQuery.dateTo = dateTo;
+    return getActivitySource_store_ShipmentAndRefunds(shipmentQuery, acceptCallback);
+}
 
-        if (!acceptCallback || acceptCallback(&source, shipment.data())) {
-            results[source][store].insert(eventDate, shipment);
+QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>> OrderManager::getActivitySource_store_ShipmentAndRefunds(
+        const ShipmentQuery &shipmentQuery,
+        std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+{
+    QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>> results;
+    auto cursor = openShipmentCursor(shipmentQuery);
+    while (cursor->next()) {
+        if (!acceptCallback || acceptCallback(&cursor->getActivitySource(), &cursor->getShipment())) {
+            results[cursor->getActivitySource()][cursor->getStore()].insert(
+                        cursor->getDateTime(), QSharedPointer<Shipment>::create(cursor->getShipment()));
         }
     }
-
     return results;
 }
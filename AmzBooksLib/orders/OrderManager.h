@@ -16,16 +16,30 @@
 #include <functional>
 
 #include <QSqlDatabase>
+#include <QMutex>
+#include <QStringList>
 #include <QJsonObject>
 
 #include "ActivitySource.h"
+#include "AbstractImporter.h"
+#include "books/TaxScheme.h"
+#include "PeriodAggregate.h"
+#include "ChangeKind.h"
+#include "OrderTimeline.h"
+#include "KeysetPager.h"
 
 class Address;
 class ActivitySource;
 class Shipment;
 class InvoicingInfo;
 class ActivityUpdate;
+class ShipmentCursor;
+class QThread;
+struct ShipmentQuery;
 
+// Each instance has its own named connections: one for the thread that created it, and one per other thread
+// using it (opened on first use with OrderManagerSql::CONNECTION_PRAGMAS), so that report queries and journal
+// generation can read from worker threads while an import writes (WAL journal)
 class OrderManager
 {
     friend class TestOrderManager;
@@ -54,25 +68,144 @@ public:
 
     // Retrieves the invoicing info associated with a shipment's root ID.
     QSharedPointer<InvoicingInfo> getInvoicingInfo(const QString &shipmentId) const;
-    void publish(QDate &dateUntil); //Shipment updated are published and the original from source are ignored (when replaced) except if they were published already
+
+    // Order, address, every shipment row with its revisions, financial events and invoicing infos of an order,
+    // read in one transaction by order ID (Orders.db only, archived orders are not found)
+    OrderTimeline getOrderTimeline(const QString &orderId) const;
+
+    // Bulk entry point for importers: records shipments, refunds, stores, addresses and invoicing infos
+    // in chunked transactions, reusing the prepared statements across rows.
+    // Same Draft / Published / conflict semantics as recordShipmentFromSource (the order ID is the activity event ID).
+    // Returns false if a chunk failed, which is rolled back: the chunks before it stay recorded, recording the same
+    // orders again being a no-op for them
+    bool recordOrderInfos(const AbstractImporter::OrderInfos &orderInfos,
+                          const ActivitySource &activitySource,
+                          const QDate &newDateIfConflict = QDate());
+    //Shipment updated are published and the original from source are ignored (when replaced) except if they were published already.
+    // Drafts until dateUntil are published in one transaction with set-based statements, by chunks.
+    // progressCallback(published, total) is called after each chunk, returning false cancels and rolls back the whole publish.
+    // Returns false if cancelled or failed (nothing is published then)
+    bool publish(QDate &dateUntil, std::function<bool(int, int)> progressCallback = nullptr);
     void clearUnpublished(); // Usefull if data were loaded with a bug. It will clear all unpublished
-    void deleteDatabase(); // Usefull to reset + also for unit tests
+    void deleteDatabase(); // Removes every row and the yearly partitions. Usefull to reset + also for unit tests
+    // Called once clearUnpublished() or deleteDatabase() removed rows, for what is kept outside Orders.db about the
+    // rows recorded, such as the rows an importer skips (AbstractImporterFile::clearImportedRows)
+    void addClearedCallback(std::function<void()> callback);
+    // Bulk maintenance under continuous imports: prunes the draft revisions left behind and the invoicing infos
+    // of shipments that are gone, gives the free pages back to the file system (incremental vacuum)
+    // and refreshes the statistics of the query planner
+    struct CompactionReport {
+        int draftsPruned = 0;
+        int invoicingInfosPruned = 0;
+        qint64 bytesBefore = 0; // Size of Orders.db
+        qint64 bytesAfter = 0;
+        qint64 bytesReclaimed = 0;
+        qint64 msecs = 0; // Time taken
+    };
+    CompactionReport compact();
+    // Streams the shipments and refunds of a period (of one source if activitySource is set) in event date order,
+    // decoding one row at a time. The maps returned by the functions below are built from it.
+    QSharedPointer<ShipmentCursor> openShipmentCursor(const QDate &dateFrom,
+                                                      const QDate &dateTo,
+                                                      const ActivitySource *activitySource = nullptr) const;
+    QSharedPointer<ShipmentCursor> openShipmentCursor(const ShipmentQuery &shipmentQuery) const;
+    // Reads the shipment rows of Orders.db matching shipmentQuery page by page, without decoding them, for browsing
+    // the whole table. Rows are id, order_id, store, source_key, event_date, status, revision_kind.
+    // Each sort reads an index in order (then event date for source and status), so a page costs the same anywhere
+    enum class ShipmentSort {
+        EventDate,
+        OrderId,
+        Id,
+        Source,
+        Status
+    };
+    QSharedPointer<KeysetPager> openShipmentPager(const ShipmentQuery &shipmentQuery,
+                                                  ShipmentSort sort = ShipmentSort::EventDate,
+                                                  KeysetPager::Order order = KeysetPager::Order::Ascending) const;
+    // The ShipmentQuery overloads filter in SQL before decoding; acceptCallback is an optional residual filter
     QMultiMap<QDateTime, QSharedPointer<Shipment>> getShipmentAndRefunds(
             const QDate &dateFrom
             , const QDate &dateTo
             , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const;
+    QMultiMap<QDateTime, QSharedPointer<Shipment>> getShipmentAndRefunds(
+            const ShipmentQuery &shipmentQuery
+            , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback = nullptr) const;
     QHash<ActivitySource, QMultiMap<QDateTime, QSharedPointer<Shipment>>> getActivitySource_ShipmentAndRefunds(
             const QDate &dateFrom
             , const QDate &dateTo
             , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const;
+    QHash<ActivitySource, QMultiMap<QDateTime, QSharedPointer<Shipment>>> getActivitySource_ShipmentAndRefunds(
+            const ShipmentQuery &shipmentQuery
+            , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback = nullptr) const;
     QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>> getActivitySource_store_ShipmentAndRefunds(
             const QDate &dateFrom
             , const QDate &dateTo
             , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const;
-    void copyDatabase(const QString &filePath, int yearUntil); // To archive all orders
-    void removeInDatabase(int yearUntil); // To remove old data
+    QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>> getActivitySource_store_ShipmentAndRefunds(
+            const ShipmentQuery &shipmentQuery
+            , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback = nullptr) const;
+
+    // Net amounts of the activities of a period grouped by store / currency / countries / tax scheme / VAT rate,
+    // computed in SQL from the activities table (reversals are stored negated so corrections cancel out)
+    struct ActivityTotal {
+        QString store;
+        QString currency;
+        QString countryCodeFrom;
+        QString countryCodeTo;
+        TaxScheme taxScheme;
+        double vatRate;
+        double amountTaxed;
+        double amountTaxes;
+        int count;
+    };
+    QList<ActivityTotal> getActivityTotals(const QDate &dateFrom, const QDate &dateTo) const;
+    // Published amounts of the months from monthFrom to monthTo (whole months), of one source if activitySource is set,
+    // read from period_aggregates (maintained by publish, drafts are not in it). The aggregates stay in Orders.db
+    // when rows are archived or removed, so that closed years can still be summed
+    QList<PeriodAggregate> getPeriodAggregates(const QDate &monthFrom,
+                                               const QDate &monthTo,
+                                               const ActivitySource *activitySource = nullptr) const;
+    // Periods whose aggregates changed (publish, or a published row updated) since their journal entries were last
+    // generated, see JournalEntryFactory::regenerateDirtyJournalEntries(). Every published period is dirty at first
+    struct DirtyPeriod {
+        ActivitySource source;
+        QString store; // Empty if unknown
+        QDate month; // First day
+        qint64 version = 0; // Incremented on each change
+    };
+    QList<DirtyPeriod> getDirtyPeriods() const;
+    // Once its journal entry is regenerated. A period changed again since it was read stays dirty
+    void markPeriodClean(const DirtyPeriod &dirtyPeriod);
+    // Yearly archiving of the revision groups (a root shipment and its revisions) that are all published and dated
+    // until the end of yearUntil: copyDatabase() copies them into a database of the same schema at filePath,
+    // removeInDatabase() deletes them from Orders.db, and archiveYears() moves each row into the read-only
+    // Orders-<year>.db partition of its event year, next to Orders.db which then keeps only the open periods.
+    // Period queries attach the partitions of the years they span. Closed years are not expected to be recorded again.
+    // Return false on failure, Orders.db being then unchanged
+    bool copyDatabase(const QString &filePath, int yearUntil); // To archive all orders
+    bool removeInDatabase(int yearUntil); // To remove old data
+    bool archiveYears(int yearUntil);
+
+    // Change feed: every shipment row recorded, updated, revised, published, removed or archived appends an entry
+    // to change_log with a monotonically increasing sequence number, so that downstream jobs (journal regeneration,
+    // exports, GUI refresh) rebuild only the shipments and periods changed since the last sequence they read.
+    struct Change {
+        qint64 seq = 0;
+        ChangeKind kind = ChangeKind::Updated;
+        QString shipmentId; // Empty for a Reset (deleteDatabase), after which everything has to be rebuilt
+        QString rootId;
+        ActivitySource source;
+        QDate eventDate; // Period of the row when the change was logged
+        QDateTime changedAt;
+    };
+    // Streams the changes after seq in order, callback returning false stops.
+    // Returns the sequence number of the last change streamed (seq if none), to pass to the next call
+    qint64 changesSince(qint64 seq, std::function<bool(const Change &)> callback) const;
+    qint64 getLastChangeSeq() const; // 0 if nothing was ever logged
+    void pruneChanges(qint64 seqUntil); // Once read by every consumer, the last change being always kept
     
-    // Returns a new model for specific view usage
+    // Returns a new model for specific view usage, holding the first page of the history; the next pages
+    // are read as the view scrolls, from the connection of the calling thread
     ActivityUpdate *createActivityUpdateModel(const QString &shipmentId, QObject* parent = nullptr); 
 
     // Returns a valid pointer if a shipment (or refund) exists for this orderId and IS DIFFERENT from the provided one.
@@ -84,10 +217,55 @@ public:
                                                             , const Shipment *shipmentOrRefund) const;
 
 private:
+    // Connection of the calling thread
+    QSqlDatabase _db() const;
+    QSqlDatabase _openConnection(const QString &connectionName) const;
     void initDb();
+    bool _initSchema(QSqlDatabase db); // Tables of Orders.db or of a yearly partition
+    bool _createSchema(QSqlDatabase db); // Tables of a new file, at OrderManagerSql::SCHEMA_VERSION
+    bool migrateDb(QSqlDatabase db); // Applies OrderManagerSql::MIGRATIONS above PRAGMA user_version
+    bool _migrateData(QSqlDatabase db, int version); // Data backfill of a migration that can't be expressed in SQL
+
+    // Yearly partitions
+    bool _initPartition(const QString &filePath); // Creates or migrates a partition, left writable
+    void _migratePartitions();
+    bool _fillArchiveBatch(QSqlDatabase db, int yearUntil); // Rows to archive into the temp table archive_batch
+    bool _copyArchiveBatch(QSqlDatabase db, const QString &filePath, int yearFrom, int yearTo);
+    bool _removeArchiveBatch(QSqlDatabase db, ChangeKind changeKind); // Logged as Archived or Removed
+    // Attaches read-only the partitions of the years of a period on db, returns the schemas to query (main first)
+    QStringList _attachPartitions(QSqlDatabase db, const QDate &dateFrom, const QDate &dateTo) const;
+
+    // Statements prepared once per connection and rebound for each row
+    class PreparedQueries;
+    void _recordShipment(const QString &orderId,
+                         const QString &sourceKey,
+                         const Shipment *shipmentOrRefund,
+                         const QDate &newDateIfConflict,
+                         PreparedQueries &queries);
+    // Points the head of a root shipment to its current effective row
+    void _updateHead(const QString &rootId, const QString &headId, PreparedQueries &queries);
+    // Appends a row as it is now to change_log
+    void _logChange(const QString &shipmentId, ChangeKind kind, PreparedQueries &queries);
+    // Adds (sign 1) or removes (sign -1) the activities of a published row in period_aggregates, marking its period dirty
+    void _updatePeriodAggregates(const QString &shipmentId, int sign, PreparedQueries &queries);
+    // Replaces the activities rows of a shipment row
+    void _writeActivities(const QString &shipmentId,
+                          const Shipment &shipmentOrRefund,
+                          PreparedQueries &queries);
+    void _recordOrder(const QString &orderId, const QString &store, PreparedQueries &queries);
+    void _recordAddressTo(const QString &orderId, const Address &addressTo, PreparedQueries &queries);
+    void _recordInvoicingInfo(const QString &shipmentOrRefundId,
+                              const InvoicingInfo *invoicingInfo,
+                              PreparedQueries &queries);
     
+    QDir m_workingDirectory;
     QString m_filePathDb;
+    QString m_connectionName; // Unique per instance, connections of other threads are suffixed with the thread ID
+    QThread *m_thread; // Thread that created this instance, using m_db
     QSqlDatabase m_db;
+    mutable QMutex m_connectionsMutex;
+    mutable QStringList m_threadConnectionNames; // Removed on destruction if their thread is still running
+    QList<std::function<void()>> m_clearedCallbacks;
 
     enum class ConflictStatus {
         NoChange,     // Content is identical
@@ -99,9 +277,9 @@ private:
     ConflictStatus checkConflict(const Shipment &existing, const Shipment &incoming) const;
 
     // Helper to retrieve the "current effective" shipment/refund for a given ID.
-    // Priority: 1. Latest Draft (if any), 2. Latest Published.
+    // Priority: 1. Latest Draft (if any), 2. Latest Published, resolved with the shipment_heads pointer.
     // Returns nullptr if not found.
-    QSharedPointer<Shipment> getHeadShipment(const QString &id, QString *outStatus = nullptr, QString *outJson = nullptr) const;
+    QSharedPointer<Shipment> getHeadShipment(const QString &id, QString *outStatus = nullptr, QByteArray *outData = nullptr) const;
 };
 
 #endif // ORDERMANAGER_H
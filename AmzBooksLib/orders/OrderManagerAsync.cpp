@@ -0,0 +1,123 @@
+#include "OrderManagerAsync.h"
+
+#include <QtConcurrent>
+#include <QCoroFuture>
+
+namespace {
+    // Reads running together, each with its own connection
+    const int READ_THREAD_COUNT = 4;
+}
+
+OrderManagerAsync::OrderManagerAsync(QSharedPointer<OrderManager> orderManager)
+    : m_orderManager(std::move(orderManager))
+{
+    m_writePool.setMaxThreadCount(1);
+    m_writePool.setExpiryTimeout(-1);
+    m_readPool.setMaxThreadCount(qMin(READ_THREAD_COUNT, QThread::idealThreadCount()));
+}
+
+OrderManagerAsync::~OrderManagerAsync()
+{
+    // Pool threads remove their connections when they finish, before m_orderManager is released
+    m_writePool.waitForDone();
+    m_readPool.waitForDone();
+}
+
+OrderManager *OrderManagerAsync::orderManager() const
+{
+    return m_orderManager.data();
+}
+
+QCoro::Task<void> OrderManagerAsync::recordShipmentFromSource(QString orderId,
+                                                              ActivitySource activitySource,
+                                                              Shipment shipmentOrRefund,
+                                                              QDate newDateIfConflict)
+{
+    co_await QtConcurrent::run(&m_writePool, [this, orderId, activitySource, shipmentOrRefund, newDateIfConflict]() {
+        m_orderManager->recordShipmentFromSource(orderId, &activitySource, &shipmentOrRefund, newDateIfConflict);
+    });
+}
+
+QCoro::Task<bool> OrderManagerAsync::recordOrderInfos(AbstractImporter::OrderInfos orderInfos,
+                                                      ActivitySource activitySource,
+                                                      QDate newDateIfConflict)
+{
+    // The coroutine frame keeps the arguments alive until the write is done, no need to copy them again
+    co_return co_await QtConcurrent::run(&m_writePool, [this, &orderInfos, &activitySource, newDateIfConflict]() {
+        return m_orderManager->recordOrderInfos(orderInfos, activitySource, newDateIfConflict);
+    });
+}
+
+QCoro::Task<void> OrderManagerAsync::recordInvoicingInfo(QString shipmentOrRefundId, InvoicingInfo invoicingInfo)
+{
+    co_await QtConcurrent::run(&m_writePool, [this, shipmentOrRefundId, invoicingInfo]() {
+        m_orderManager->recordInvoicingInfo(shipmentOrRefundId, &invoicingInfo);
+    });
+}
+
+QCoro::Task<bool> OrderManagerAsync::publish(QDate dateUntil, std::function<bool(int, int)> progressCallback)
+{
+    co_return co_await QtConcurrent::run(&m_writePool, [this, dateUntil, progressCallback]() mutable {
+        return m_orderManager->publish(dateUntil, progressCallback);
+    });
+}
+
+QCoro::Task<OrderManager::CompactionReport> OrderManagerAsync::compact()
+{
+    co_return co_await QtConcurrent::run(&m_writePool, [this]() {
+        return m_orderManager->compact();
+    });
+}
+
+QCoro::Task<QSharedPointer<Shipment>> OrderManagerAsync::getShipmentOrRefundIfDifferent(QString orderId,
+                                                                                       ActivitySource activitySource,
+                                                                                       Shipment shipmentOrRefund) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, orderId, activitySource, shipmentOrRefund]() {
+        return m_orderManager->getShipmentOrRefundIfDifferent(orderId, &activitySource, &shipmentOrRefund);
+    });
+}
+
+QCoro::Task<QSharedPointer<InvoicingInfo>> OrderManagerAsync::getInvoicingInfo(QString shipmentId) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, shipmentId]() {
+        return m_orderManager->getInvoicingInfo(shipmentId);
+    });
+}
+
+QCoro::Task<OrderTimeline> OrderManagerAsync::getOrderTimeline(QString orderId) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, orderId]() {
+        return m_orderManager->getOrderTimeline(orderId);
+    });
+}
+
+QCoro::Task<QList<OrderManager::ActivityTotal>> OrderManagerAsync::getActivityTotals(QDate dateFrom, QDate dateTo) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, dateFrom, dateTo]() {
+        return m_orderManager->getActivityTotals(dateFrom, dateTo);
+    });
+}
+
+QCoro::Task<QList<PeriodAggregate>> OrderManagerAsync::getPeriodAggregates(QDate monthFrom, QDate monthTo) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, monthFrom, monthTo]() {
+        return m_orderManager->getPeriodAggregates(monthFrom, monthTo);
+    });
+}
+
+QCoro::Task<QList<PeriodAggregate>> OrderManagerAsync::getPeriodAggregates(QDate monthFrom, QDate monthTo, ActivitySource activitySource) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, monthFrom, monthTo, activitySource]() {
+        return m_orderManager->getPeriodAggregates(monthFrom, monthTo, &activitySource);
+    });
+}
+
+QCoro::Task<QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>>> OrderManagerAsync::getActivitySource_store_ShipmentAndRefunds(
+        ShipmentQuery shipmentQuery
+        , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback) const
+{
+    co_return co_await QtConcurrent::run(&m_readPool, [this, shipmentQuery, acceptCallback]() {
+        return m_orderManager->getActivitySource_store_ShipmentAndRefunds(shipmentQuery, acceptCallback);
+    });
+}
@@ -0,0 +1,58 @@
+#ifndef ORDERMANAGERASYNC_H
+#define ORDERMANAGERASYNC_H
+
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QCoroTask>
+
+#include "OrderManager.h"
+#include "ShipmentQuery.h"
+#include "Shipment.h"
+#include "InvoicingInfo.h"
+
+// Asynchronous facade of an OrderManager so that the GUI stays responsive during imports and publishes.
+// Writes run one after the other, in call order, on a dedicated database thread; reads run on a small pool of
+// threads. Each thread uses its own connection of the OrderManager, reads seeing the last committed state (WAL).
+// Arguments are taken by value as they are used after the caller returns.
+class OrderManagerAsync
+{
+public:
+    explicit OrderManagerAsync(QSharedPointer<OrderManager> orderManager);
+    ~OrderManagerAsync(); // Waits for the running and queued calls
+
+    OrderManager *orderManager() const;
+
+    // Writes
+    QCoro::Task<void> recordShipmentFromSource(QString orderId,
+                                               ActivitySource activitySource,
+                                               Shipment shipmentOrRefund,
+                                               QDate newDateIfConflict);
+    QCoro::Task<bool> recordOrderInfos(AbstractImporter::OrderInfos orderInfos,
+                                       ActivitySource activitySource,
+                                       QDate newDateIfConflict = QDate());
+    QCoro::Task<void> recordInvoicingInfo(QString shipmentOrRefundId, InvoicingInfo invoicingInfo);
+    // progressCallback is called on the database thread
+    QCoro::Task<bool> publish(QDate dateUntil, std::function<bool(int, int)> progressCallback = nullptr);
+    QCoro::Task<OrderManager::CompactionReport> compact();
+
+    // Reads
+    QCoro::Task<QSharedPointer<Shipment>> getShipmentOrRefundIfDifferent(QString orderId,
+                                                                        ActivitySource activitySource,
+                                                                        Shipment shipmentOrRefund) const;
+    QCoro::Task<QSharedPointer<InvoicingInfo>> getInvoicingInfo(QString shipmentId) const;
+    QCoro::Task<OrderTimeline> getOrderTimeline(QString orderId) const;
+    QCoro::Task<QList<OrderManager::ActivityTotal>> getActivityTotals(QDate dateFrom, QDate dateTo) const;
+    QCoro::Task<QList<PeriodAggregate>> getPeriodAggregates(QDate monthFrom, QDate monthTo) const;
+    QCoro::Task<QList<PeriodAggregate>> getPeriodAggregates(QDate monthFrom, QDate monthTo, ActivitySource activitySource) const;
+    // acceptCallback is called on a read thread
+    QCoro::Task<QHash<ActivitySource, QHash<QString, QMultiMap<QDateTime, QSharedPointer<Shipment>>>>> getActivitySource_store_ShipmentAndRefunds(
+            ShipmentQuery shipmentQuery
+            , std::function<bool(const ActivitySource*, const Shipment*)> acceptCallback = nullptr) const;
+
+private:
+    QSharedPointer<OrderManager> m_orderManager;
+    QThreadPool m_writePool; // One thread that never expires: the database thread
+    mutable QThreadPool m_readPool;
+};
+
+#endif // ORDERMANAGERASYNC_H
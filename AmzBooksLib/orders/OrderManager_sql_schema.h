@@ -2,33 +2,42 @@
 #define ORDERMANAGER_SQL_SCHEMA_H
 
 #include <QString>
+#include <QStringList>
+#include <QList>
 
 namespace OrderManagerSql {
 
+// Tables and indexes of a new Orders.db or yearly partition, at SCHEMA_VERSION. OrderManager::_initSchema() runs
+// CREATE_SCHEMA on a file without tables and sets its user_version, older files are upgraded by MIGRATIONS below
 const QString CREATE_TABLE_ORDERS = R"(
-    CREATE TABLE If NOT EXISTS orders (
+    CREATE TABLE IF NOT EXISTS orders (
         id TEXT PRIMARY KEY,
         address_json TEXT,
         store TEXT
     )
 )";
 
+// Same column order as a file upgraded by MIGRATIONS
 const QString CREATE_TABLE_SHIPMENTS = R"(
     CREATE TABLE IF NOT EXISTS shipments (
         id TEXT PRIMARY KEY,
         order_id TEXT NOT NULL,
         status TEXT NOT NULL, -- 'Draft', 'Published'
-        original_json TEXT NOT NULL,
-        current_json TEXT NOT NULL,
-        published_json TEXT, -- NULL if not yet published
         publication_date TEXT, -- ISO8601 string or NULL
         event_date TEXT, -- ISO8601 string (Activity date)
-        source_key TEXT, -- For querying history by source
+        source_key TEXT, -- For querying history by source, '' without source
         root_id TEXT,    -- ID of the original/root shipment if this is a revision/correction
+        revision_kind TEXT NOT NULL DEFAULT 'Original', -- 'Original', 'Reversal', 'NewVersion'
+        content_hash BLOB, -- SHA-1 of current_data
+        tax_hash BLOB, -- Shipment::taxHash()
+        original_data BLOB, -- Shipment::toCbor()
+        current_data BLOB,
+        published_data BLOB, -- NULL if not yet published
         FOREIGN KEY(order_id) REFERENCES orders(id)
     )
 )";
 
+// What generated an event is the published_data of its shipment_id row
 const QString CREATE_TABLE_FINANCIAL_EVENTS = R"(
     CREATE TABLE IF NOT EXISTS financial_events (
         id TEXT PRIMARY KEY, -- Invoice Number
@@ -37,7 +46,6 @@ const QString CREATE_TABLE_FINANCIAL_EVENTS = R"(
         event_date TEXT NOT NULL,
         amount REAL NOT NULL,
         currency TEXT NOT NULL,
-        content_json TEXT NOT NULL, -- Snapshot of what generated this event
         FOREIGN KEY(shipment_id) REFERENCES shipments(id)
     )
 )";
@@ -45,10 +53,847 @@ const QString CREATE_TABLE_FINANCIAL_EVENTS = R"(
 const QString CREATE_TABLE_INVOICING_INFOS = R"(
     CREATE TABLE IF NOT EXISTS invoicing_infos (
         shipment_root_id TEXT PRIMARY KEY,
-        json TEXT NOT NULL
+        data BLOB -- InvoicingInfo::toCbor()
     )
 )";
 
+// Activities of each shipment row as columns, so that publish and aggregations don't decode current_data.
+// Amounts are signed: the rows of a reversal (-rev-) are stored negated
+const QString CREATE_TABLE_ACTIVITIES = R"(
+    CREATE TABLE IF NOT EXISTS activities (
+        shipment_id TEXT NOT NULL,
+        position INTEGER NOT NULL, -- Index in Shipment::getActivities()
+        event_id TEXT NOT NULL,
+        activity_id TEXT NOT NULL,
+        sub_activity_id TEXT,
+        date_time TEXT NOT NULL, -- ISO8601
+        currency TEXT NOT NULL,
+        country_from TEXT,
+        country_to TEXT,
+        country_vat_paid_to TEXT,
+        amount_taxed REAL NOT NULL,
+        amount_taxes REAL NOT NULL,
+        vat_rate REAL NOT NULL,
+        tax_source INTEGER NOT NULL,
+        tax_declaring_country TEXT,
+        tax_scheme INTEGER NOT NULL,
+        tax_jurisdiction_level INTEGER NOT NULL,
+        sale_type INTEGER NOT NULL,
+        vat_territory_from TEXT,
+        vat_territory_to TEXT,
+        PRIMARY KEY(shipment_id, position),
+        FOREIGN KEY(shipment_id) REFERENCES shipments(id)
+    ) WITHOUT ROWID
+)";
+
+// Head pointers per root shipment: the current effective row (latest draft, else latest published revision,
+// else the original) is one point lookup
+const QString CREATE_TABLE_SHIPMENT_HEADS = R"(
+    CREATE TABLE IF NOT EXISTS shipment_heads (
+        root_id TEXT PRIMARY KEY,
+        head_id TEXT NOT NULL, -- Current effective row (Original or NewVersion)
+        published_head_id TEXT, -- Latest published row (Original or NewVersion), NULL if never published
+        FOREIGN KEY(root_id) REFERENCES shipments(id)
+    ) WITHOUT ROWID
+)";
+
+// Net published amounts per month (YYYY-MM of the event date), source, store, tax scheme, route, VAT rate and
+// currency, maintained by publish(). Reversal rows count -1, so that a fully reversed group has count 0
+const QString CREATE_TABLE_PERIOD_AGGREGATES = R"(
+    CREATE TABLE IF NOT EXISTS period_aggregates (
+        month TEXT NOT NULL,
+        source_key TEXT NOT NULL,
+        store TEXT NOT NULL, -- '' if unknown
+        tax_scheme INTEGER NOT NULL,
+        country_from TEXT NOT NULL,
+        country_to TEXT NOT NULL,
+        vat_rate REAL NOT NULL,
+        currency TEXT NOT NULL,
+        amount_taxed REAL NOT NULL,
+        amount_taxes REAL NOT NULL,
+        count INTEGER NOT NULL,
+        PRIMARY KEY(month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency)
+    ) WITHOUT ROWID
+)";
+
+// Append-only feed of the changed shipment rows, read with OrderManager::changesSince()
+const QString CREATE_TABLE_CHANGE_LOG = R"(
+    CREATE TABLE IF NOT EXISTS change_log (
+        seq INTEGER PRIMARY KEY AUTOINCREMENT, -- Never reused, even after pruning or deleteDatabase()
+        shipment_id TEXT, -- NULL for a Reset
+        root_id TEXT,
+        source_key TEXT,
+        event_date TEXT, -- Of the row when the change was logged
+        kind TEXT NOT NULL, -- ChangeKind
+        changed_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%dT%H:%M:%S', 'now', 'localtime'))
+    )
+)";
+
+// Periods (source, store, month) whose period aggregates changed since their journal entries were generated
+const QString CREATE_TABLE_DIRTY_PERIODS = R"(
+    CREATE TABLE IF NOT EXISTS dirty_periods (
+        source_key TEXT NOT NULL,
+        store TEXT NOT NULL, -- '' if unknown
+        month TEXT NOT NULL, -- YYYY-MM
+        version INTEGER NOT NULL DEFAULT 1, -- Incremented on each change, so that a period changed while regenerated stays dirty
+        PRIMARY KEY(source_key, store, month)
+    ) WITHOUT ROWID
+)";
+
+const QStringList CREATE_SCHEMA = {
+    CREATE_TABLE_ORDERS,
+    CREATE_TABLE_SHIPMENTS,
+    CREATE_TABLE_FINANCIAL_EVENTS,
+    CREATE_TABLE_INVOICING_INFOS,
+    CREATE_TABLE_ACTIVITIES,
+    CREATE_TABLE_SHIPMENT_HEADS,
+    CREATE_TABLE_PERIOD_AGGREGATES,
+    CREATE_TABLE_CHANGE_LOG,
+    CREATE_TABLE_DIRTY_PERIODS,
+    // Hot access paths: revision lookups, source date range, period queries, publish, history, shipments of an order
+    "CREATE INDEX IF NOT EXISTS idx_shipments_root_status ON shipments(root_id, status, event_date, id)",
+    "CREATE INDEX IF NOT EXISTS idx_shipments_source_date ON shipments(source_key, event_date)",
+    "CREATE INDEX IF NOT EXISTS idx_shipments_status_date ON shipments(status, event_date)",
+    "CREATE INDEX IF NOT EXISTS idx_shipments_event_date ON shipments(event_date)",
+    "CREATE INDEX IF NOT EXISTS idx_shipments_order ON shipments(order_id)",
+    "CREATE INDEX IF NOT EXISTS idx_financial_events_shipment ON financial_events(shipment_id, event_date)"
+};
+
+// Run on each connection opened by OrderManager. WAL lets readers of other threads run while a transaction writes,
+// synchronous NORMAL is durable with WAL except on power loss, busy_timeout makes a second writer wait instead of failing
+const QStringList CONNECTION_PRAGMAS = {
+    "PRAGMA auto_vacuum = INCREMENTAL", // Only applies when Orders.db is created, OrderManager::compact() converts older ones
+    "PRAGMA journal_mode = WAL",
+    "PRAGMA synchronous = NORMAL",
+    "PRAGMA foreign_keys = ON",
+    "PRAGMA busy_timeout = 5000",
+    "PRAGMA cache_size = -16000", // 16 MB of page cache per connection
+    "PRAGMA mmap_size = 268435456", // 256 MB memory-mapped reads
+    "PRAGMA temp_store = MEMORY"
+};
+
+// Schema migrations of the files created before CREATE_SCHEMA, whose version 0 had the orders, shipments
+// (with *_json columns), financial_events and invoicing_infos tables only. MIGRATIONS[i] upgrades a database from
+// PRAGMA user_version i to i + 1; OrderManager::initDb() applies the missing ones in order, each in its own
+// transaction together with the user_version bump. They stay as they were run: later changes are new migrations
+const QList<QStringList> MIGRATIONS = {
+    // 1: indexes for the hot access paths (revision lookups, source date range, period queries, publish, history)
+    {
+        "CREATE INDEX IF NOT EXISTS idx_shipments_root_status ON shipments(root_id, status, event_date, id)",
+        "CREATE INDEX IF NOT EXISTS idx_shipments_source_date ON shipments(source_key, event_date)",
+        "CREATE INDEX IF NOT EXISTS idx_shipments_status_date ON shipments(status, event_date)",
+        "CREATE INDEX IF NOT EXISTS idx_shipments_event_date ON shipments(event_date)",
+        "CREATE INDEX IF NOT EXISTS idx_financial_events_shipment ON financial_events(shipment_id, event_date)"
+    },
+    // 2: activities of each shipment row as columns, so that publish and aggregations don't parse current_json.
+    // Amounts are signed: the rows of a reversal (-rev-) are stored negated. Existing rows are backfilled by OrderManager::_migrateData()
+    {
+        R"(
+        CREATE TABLE IF NOT EXISTS activities (
+            shipment_id TEXT NOT NULL,
+            position INTEGER NOT NULL, -- Index in Shipment::getActivities()
+            event_id TEXT NOT NULL,
+            activity_id TEXT NOT NULL,
+            sub_activity_id TEXT,
+            date_time TEXT NOT NULL, -- ISO8601
+            currency TEXT NOT NULL,
+            country_from TEXT,
+            country_to TEXT,
+            country_vat_paid_to TEXT,
+            amount_taxed REAL NOT NULL,
+            amount_taxes REAL NOT NULL,
+            vat_rate REAL NOT NULL,
+            tax_source INTEGER NOT NULL,
+            tax_declaring_country TEXT,
+            tax_scheme INTEGER NOT NULL,
+            tax_jurisdiction_level INTEGER NOT NULL,
+            sale_type INTEGER NOT NULL,
+            vat_territory_from TEXT,
+            vat_territory_to TEXT,
+            PRIMARY KEY(shipment_id, position),
+            FOREIGN KEY(shipment_id) REFERENCES shipments(id)
+        ) WITHOUT ROWID
+        )"
+    },
+    // 3: explicit revision kind, reversal rows store their negated content so that reads don't rebuild it.
+    // The JSON of existing reversal rows is negated by OrderManager::_migrateData()
+    {
+        "ALTER TABLE shipments ADD COLUMN revision_kind TEXT NOT NULL DEFAULT 'Original'", // 'Original', 'Reversal', 'NewVersion'
+        "UPDATE shipments SET revision_kind = 'Reversal' WHERE root_id IS NOT NULL AND id LIKE '%-rev-%'",
+        "UPDATE shipments SET revision_kind = 'NewVersion' WHERE root_id IS NOT NULL AND id LIKE '%-v-%'"
+    },
+    // 4: head pointers per root shipment, maintained on insert / publish so that the current effective row
+    // (latest draft, else latest published revision, else the original) is one point lookup
+    {
+        R"(
+        CREATE TABLE IF NOT EXISTS shipment_heads (
+            root_id TEXT PRIMARY KEY,
+            head_id TEXT NOT NULL, -- Current effective row (Original or NewVersion)
+            published_head_id TEXT, -- Latest published row (Original or NewVersion), NULL if never published
+            FOREIGN KEY(root_id) REFERENCES shipments(id)
+        ) WITHOUT ROWID
+        )",
+        R"(
+        INSERT OR REPLACE INTO shipment_heads (root_id, head_id, published_head_id)
+        SELECT s.id,
+               COALESCE((SELECT r.id FROM shipments r
+                         WHERE (r.id = s.id OR r.root_id = s.id) AND r.status = 'Draft' AND r.revision_kind != 'Reversal'
+                         ORDER BY r.event_date DESC, r.id DESC LIMIT 1),
+                        (SELECT r.id FROM shipments r
+                         WHERE r.root_id = s.id AND r.status = 'Published' AND r.revision_kind != 'Reversal'
+                         ORDER BY r.event_date DESC, r.id DESC LIMIT 1),
+                        s.id),
+               CASE WHEN s.status = 'Published' THEN
+                   COALESCE((SELECT r.id FROM shipments r
+                             WHERE r.root_id = s.id AND r.status = 'Published' AND r.revision_kind != 'Reversal'
+                             ORDER BY r.event_date DESC, r.id DESC LIMIT 1),
+                            s.id)
+               END
+        FROM shipments s
+        WHERE s.root_id IS NULL
+        )"
+    },
+    // 5: content hash (SHA-1 of current_json) and tax hash (Shipment::taxHash) of each row, so that re-imports
+    // skip unchanged rows and detect conflicts without decoding. Filled by OrderManager::_migrateData()
+    {
+        "ALTER TABLE shipments ADD COLUMN content_hash BLOB",
+        "ALTER TABLE shipments ADD COLUMN tax_hash BLOB"
+    },
+    // 6: compact binary content (Shipment::toCbor / InvoicingInfo::toCbor) next to the JSON columns.
+    // Filled from the JSON by OrderManager::_migrateData(), content_hash becomes the SHA-1 of current_data
+    {
+        "ALTER TABLE shipments ADD COLUMN original_data BLOB",
+        "ALTER TABLE shipments ADD COLUMN current_data BLOB",
+        "ALTER TABLE shipments ADD COLUMN published_data BLOB", // NULL if not yet published
+        "ALTER TABLE invoicing_infos ADD COLUMN data BLOB"
+    },
+    // 7: drop the JSON copies (requires SQLite 3.35). A financial event doesn't keep its own snapshot anymore,
+    // what generated it is the published_data of its shipment_id row, which is immutable once published
+    {
+        "ALTER TABLE shipments DROP COLUMN original_json",
+        "ALTER TABLE shipments DROP COLUMN current_json",
+        "ALTER TABLE shipments DROP COLUMN published_json",
+        "ALTER TABLE financial_events DROP COLUMN content_json",
+        "ALTER TABLE invoicing_infos DROP COLUMN json"
+    },
+    // 8: shipments of an order, so that archiving only deletes the orders left without shipments
+    {
+        "CREATE INDEX IF NOT EXISTS idx_shipments_order ON shipments(order_id)"
+    },
+    // 9: net published amounts per month (YYYY-MM of the event date), source, store, tax scheme, route, VAT rate
+    // and currency, maintained by publish() so that journal entries don't read the activities. Backfilled from the
+    // published rows. Reversal rows count -1, so that a fully reversed group has count 0
+    {
+        R"(
+        CREATE TABLE IF NOT EXISTS period_aggregates (
+            month TEXT NOT NULL,
+            source_key TEXT NOT NULL,
+            store TEXT NOT NULL, -- '' if unknown
+            tax_scheme INTEGER NOT NULL,
+            country_from TEXT NOT NULL,
+            country_to TEXT NOT NULL,
+            vat_rate REAL NOT NULL,
+            currency TEXT NOT NULL,
+            amount_taxed REAL NOT NULL,
+            amount_taxes REAL NOT NULL,
+            count INTEGER NOT NULL,
+            PRIMARY KEY(month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency)
+        ) WITHOUT ROWID
+        )",
+        "INSERT INTO period_aggregates (month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency, "
+        "amount_taxed, amount_taxes, count) "
+        "SELECT substr(s.event_date, 1, 7), COALESCE(s.source_key, ''), COALESCE(o.store, ''), a.tax_scheme, "
+        "COALESCE(a.country_from, ''), COALESCE(a.country_to, ''), a.vat_rate, a.currency, "
+        "SUM(a.amount_taxed), SUM(a.amount_taxes), SUM(CASE WHEN s.revision_kind = 'Reversal' THEN -1 ELSE 1 END) "
+        "FROM shipments s "
+        "JOIN activities a ON a.shipment_id = s.id "
+        "LEFT JOIN orders o ON s.order_id = o.id "
+        "WHERE s.status = 'Published' AND s.event_date IS NOT NULL "
+        "GROUP BY 1, 2, 3, 4, 5, 6, 7, 8"
+    },
+    // 10: append-only feed of the shipment rows changed by record / publish / revision / maintenance paths,
+    // read by downstream jobs with OrderManager::changesSince(). Starts empty
+    {
+        R"(
+        CREATE TABLE IF NOT EXISTS change_log (
+            seq INTEGER PRIMARY KEY AUTOINCREMENT, -- Never reused, even after pruning or deleteDatabase()
+            shipment_id TEXT, -- NULL for a Reset
+            root_id TEXT,
+            source_key TEXT,
+            event_date TEXT, -- Of the row when the change was logged
+            kind TEXT NOT NULL, -- ChangeKind
+            changed_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%dT%H:%M:%S', 'now', 'localtime'))
+        )
+        )"
+    },
+    // 11: periods (source, store, month) whose period aggregates changed since their journal entries were generated,
+    // marked with the aggregates. Every published period is dirty at first
+    {
+        R"(
+        CREATE TABLE IF NOT EXISTS dirty_periods (
+            source_key TEXT NOT NULL,
+            store TEXT NOT NULL, -- '' if unknown
+            month TEXT NOT NULL, -- YYYY-MM
+            version INTEGER NOT NULL DEFAULT 1, -- Incremented on each change, so that a period changed while regenerated stays dirty
+            PRIMARY KEY(source_key, store, month)
+        ) WITHOUT ROWID
+        )",
+        "INSERT OR IGNORE INTO dirty_periods (source_key, store, month) "
+        "SELECT DISTINCT source_key, store, month FROM period_aggregates"
+    },
+    // 12: rows recorded without a source get source_key '' like the new ones: a NULL key compares to nothing,
+    // so a page ending on such a row ended the pages sorted by source (SHIPMENTS_PAGE_KEYS_SOURCE)
+    {
+        "UPDATE shipments SET source_key = '' WHERE source_key IS NULL"
+    }
+};
+
+const int SCHEMA_VERSION = MIGRATIONS.size();
+
+// False for a new file, created at SCHEMA_VERSION, whereas an existing one is migrated
+const QString SELECT_HAS_SHIPMENTS_TABLE = "SELECT EXISTS (SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'shipments')";
+
+// Lowest / highest bound of an open date range in period queries, so that they always use the event_date index
+const QString EVENT_DATE_MIN = "";
+const QString EVENT_DATE_MAX = "9999-12-31";
+
+const QString SELECT_LAST_EVENT_DATE = "SELECT MAX(event_date) FROM shipments WHERE source_key = ?";
+
+const QString SELECT_FIRST_EVENT_DATE = "SELECT MIN(event_date) FROM shipments WHERE source_key = ?";
+
+// Rows of a period for ShipmentCursor (current_data, source_key, event_date, id, store) in one database,
+// %1 being main or an attached yearly partition, %2 the condition compiled from a ShipmentQuery for it.
+// The SELECTs of the databases covering a period are joined with UNION ALL and ordered by event_date
+const QString SELECT_SHIPMENTS_OF_SCHEMA = "SELECT s.current_data, s.source_key, s.event_date, s.id, o.store "
+                                           "FROM %1.shipments s "
+                                           "LEFT JOIN %1.orders o ON s.order_id = o.id "
+                                           "WHERE %2";
+
+// Same in Orders.db only, in event date order. %1 is the condition compiled from a ShipmentQuery
+const QString SELECT_SHIPMENTS_QUERY = SELECT_SHIPMENTS_OF_SCHEMA.arg("main", "%1") + " ORDER BY s.event_date";
+
+// Pages of the shipment rows of Orders.db for KeysetPager, without decoding them
+// (id, order_id, store, source_key, event_date, status, revision_kind then the key columns).
+// %1 is the key columns, %2 the condition compiled from a ShipmentQuery, %3 the ORDER BY of the key columns
+// and %4 the key condition, to be replaced by %1 for KeysetPager
+const QString SELECT_SHIPMENTS_PAGE = "SELECT s.id, s.order_id, o.store, s.source_key, s.event_date, s.status, s.revision_kind, %1 "
+                                      "FROM main.shipments s "
+                                      "LEFT JOIN main.orders o ON s.order_id = o.id "
+                                      "WHERE %2%4 "
+                                      "ORDER BY %3 LIMIT ?";
+
+// Keys of SELECT_SHIPMENTS_PAGE for each order of the rows. Each one is the start of an index of shipments
+// (whose rows are ordered by rowid) and ends with a unique column, so that a page is an index range
+const QStringList SHIPMENTS_PAGE_KEYS_EVENT_DATE = {"s.event_date", "s.rowid"};
+const QStringList SHIPMENTS_PAGE_KEYS_ORDER_ID = {"s.order_id", "s.rowid"};
+const QStringList SHIPMENTS_PAGE_KEYS_ID = {"s.id"};
+const QStringList SHIPMENTS_PAGE_KEYS_SOURCE = {"s.source_key", "s.event_date", "s.rowid"};
+const QStringList SHIPMENTS_PAGE_KEYS_STATUS = {"s.status", "s.event_date", "s.rowid"};
+
+// Current effective row of a root shipment
+const QString SELECT_HEAD_SHIPMENT = "SELECT s.id, s.current_data, s.status, s.content_hash FROM shipment_heads h "
+                                     "JOIN shipments s ON s.id = h.head_id "
+                                     "WHERE h.root_id = ?";
+
+const QString SELECT_SHIPMENT = "SELECT id, current_data, status FROM shipments WHERE id = ?";
+
+const QString UPDATE_SHIPMENT_CURRENT_DATA = "UPDATE shipments SET current_data = ?, content_hash = ?, tax_hash = ? WHERE id = ?";
+
+// Set-based publish: the drafts to publish are listed once in a connection-local table, in event date order,
+// then published by ranges of its rowid (financial events, status and published heads of a whole range per statement)
+const QStringList CREATE_PUBLISH_BATCH = {
+    R"(
+    CREATE TEMP TABLE IF NOT EXISTS publish_batch (
+        id TEXT PRIMARY KEY,
+        root_id TEXT NOT NULL, -- Own ID for a root shipment
+        revision_kind TEXT NOT NULL
+    )
+    )",
+    "CREATE INDEX IF NOT EXISTS temp.idx_publish_batch_root ON publish_batch(root_id)"
+};
+
+const QString CLEAR_PUBLISH_BATCH = "DELETE FROM publish_batch";
+
+const QString INSERT_PUBLISH_BATCH_UNTIL = "INSERT INTO publish_batch (id, root_id, revision_kind) "
+                                           "SELECT id, COALESCE(root_id, id), revision_kind FROM shipments "
+                                           "WHERE status = 'Draft' AND (event_date IS NULL OR event_date <= ?) "
+                                           "ORDER BY event_date, id";
+
+const QString SELECT_PUBLISH_BATCH_RANGE = "SELECT (SELECT MIN(rowid) FROM publish_batch), (SELECT MAX(rowid) FROM publish_batch)";
+
+// One financial event per activity of a range of publish_batch. A reversal gives a credit note with positive amounts
+// (its activities are stored negated). The event ID is INV-/CN- + shipment ID [+ -subActivityId], and [+ #position]
+// when an earlier activity of the shipment has the same sub activity ID, so that it is unique and deterministic
+const QString INSERT_FINANCIAL_EVENTS_OF_BATCH = "INSERT INTO financial_events (id, shipment_id, type, event_date, amount, currency) "
+                                                 "SELECT CASE WHEN b.revision_kind = 'Reversal' THEN 'CN-' ELSE 'INV-' END || b.id "
+                                                 "|| CASE WHEN COALESCE(a.sub_activity_id, '') = '' THEN '' ELSE '-' || a.sub_activity_id END "
+                                                 "|| CASE WHEN EXISTS (SELECT 1 FROM activities d WHERE d.shipment_id = a.shipment_id "
+                                                 "AND d.position < a.position AND COALESCE(d.sub_activity_id, '') = COALESCE(a.sub_activity_id, '')) "
+                                                 "THEN '#' || a.position ELSE '' END, "
+                                                 "b.id, "
+                                                 "CASE WHEN b.revision_kind = 'Reversal' THEN 'CreditNote' ELSE 'Invoice' END, "
+                                                 "a.date_time, "
+                                                 "CASE WHEN b.revision_kind = 'Reversal' THEN -1.0 ELSE 1.0 END * (a.amount_taxed + a.amount_taxes), "
+                                                 "a.currency "
+                                                 "FROM publish_batch b "
+                                                 "JOIN activities a ON a.shipment_id = b.id "
+                                                 "WHERE b.rowid BETWEEN ? AND ? "
+                                                 "ORDER BY b.rowid, a.position";
+
+const QString UPDATE_SHIPMENTS_PUBLISHED_OF_BATCH = "UPDATE shipments SET status = 'Published', published_data = current_data, publication_date = ? "
+                                                    "WHERE id IN (SELECT id FROM publish_batch WHERE rowid BETWEEN ? AND ?)";
+
+// The latest published row of a root is its last non-reversal row in the range (rows being in event date order)
+const QString UPDATE_PUBLISHED_HEADS_OF_BATCH = "UPDATE shipment_heads SET published_head_id = "
+                                                "(SELECT b.id FROM publish_batch b WHERE b.root_id = shipment_heads.root_id "
+                                                "AND b.revision_kind != 'Reversal' AND b.rowid BETWEEN ? AND ? "
+                                                "ORDER BY b.rowid DESC LIMIT 1) "
+                                                "WHERE root_id IN (SELECT root_id FROM publish_batch "
+                                                "WHERE revision_kind != 'Reversal' AND rowid BETWEEN ? AND ?)";
+
+// Period aggregates of a range of publish_batch, added to the existing rows of their keys
+const QString UPSERT_PERIOD_AGGREGATES_OF_BATCH = "INSERT INTO period_aggregates (month, source_key, store, tax_scheme, "
+                                                  "country_from, country_to, vat_rate, currency, amount_taxed, amount_taxes, count) "
+                                                  "SELECT substr(s.event_date, 1, 7), COALESCE(s.source_key, ''), COALESCE(o.store, ''), a.tax_scheme, "
+                                                  "COALESCE(a.country_from, ''), COALESCE(a.country_to, ''), a.vat_rate, a.currency, "
+                                                  "SUM(a.amount_taxed), SUM(a.amount_taxes), SUM(CASE WHEN b.revision_kind = 'Reversal' THEN -1 ELSE 1 END) "
+                                                  "FROM publish_batch b "
+                                                  "JOIN shipments s ON s.id = b.id "
+                                                  "JOIN activities a ON a.shipment_id = b.id "
+                                                  "LEFT JOIN orders o ON s.order_id = o.id "
+                                                  "WHERE b.rowid BETWEEN ? AND ? AND s.event_date IS NOT NULL "
+                                                  "GROUP BY 1, 2, 3, 4, 5, 6, 7, 8 "
+                                                  "ON CONFLICT(month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency) "
+                                                  "DO UPDATE SET amount_taxed = amount_taxed + excluded.amount_taxed, "
+                                                  "amount_taxes = amount_taxes + excluded.amount_taxes, count = count + excluded.count";
+
+// Adds (sign 1) or removes (sign -1) a published row from the period aggregates, around its update in place
+// (content differing without tax conflict, that can still move its event date or activities)
+const QString UPSERT_PERIOD_AGGREGATES_OF_SHIPMENT = "INSERT INTO period_aggregates (month, source_key, store, tax_scheme, "
+                                                     "country_from, country_to, vat_rate, currency, amount_taxed, amount_taxes, count) "
+                                                     "SELECT substr(s.event_date, 1, 7), COALESCE(s.source_key, ''), COALESCE(o.store, ''), a.tax_scheme, "
+                                                     "COALESCE(a.country_from, ''), COALESCE(a.country_to, ''), a.vat_rate, a.currency, "
+                                                     "? * SUM(a.amount_taxed), ? * SUM(a.amount_taxes), "
+                                                     "? * SUM(CASE WHEN s.revision_kind = 'Reversal' THEN -1 ELSE 1 END) "
+                                                     "FROM shipments s "
+                                                     "JOIN activities a ON a.shipment_id = s.id "
+                                                     "LEFT JOIN orders o ON s.order_id = o.id "
+                                                     "WHERE s.id = ? AND s.status = 'Published' AND s.event_date IS NOT NULL "
+                                                     "GROUP BY 1, 2, 3, 4, 5, 6, 7, 8 "
+                                                     "ON CONFLICT(month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency) "
+                                                     "DO UPDATE SET amount_taxed = amount_taxed + excluded.amount_taxed, "
+                                                     "amount_taxes = amount_taxes + excluded.amount_taxes, count = count + excluded.count";
+
+// Periods of a range of publish_batch marked dirty
+const QString UPSERT_DIRTY_PERIODS_OF_BATCH = "INSERT INTO dirty_periods (source_key, store, month) "
+                                              "SELECT DISTINCT COALESCE(s.source_key, ''), COALESCE(o.store, ''), substr(s.event_date, 1, 7) "
+                                              "FROM publish_batch b "
+                                              "JOIN shipments s ON s.id = b.id "
+                                              "LEFT JOIN orders o ON s.order_id = o.id "
+                                              "WHERE b.rowid BETWEEN ? AND ? AND s.event_date IS NOT NULL "
+                                              "ON CONFLICT(source_key, store, month) DO UPDATE SET version = version + 1";
+
+// Period of a published row marked dirty, with UPSERT_PERIOD_AGGREGATES_OF_SHIPMENT
+const QString UPSERT_DIRTY_PERIOD_OF_SHIPMENT = "INSERT INTO dirty_periods (source_key, store, month) "
+                                                "SELECT COALESCE(s.source_key, ''), COALESCE(o.store, ''), substr(s.event_date, 1, 7) "
+                                                "FROM shipments s "
+                                                "LEFT JOIN orders o ON s.order_id = o.id "
+                                                "WHERE s.id = ? AND s.status = 'Published' AND s.event_date IS NOT NULL "
+                                                "ON CONFLICT(source_key, store, month) DO UPDATE SET version = version + 1";
+
+// Whole table, a few rows between two regenerations of the journal entries
+const QString SELECT_DIRTY_PERIODS = "SELECT source_key, store, month, version FROM dirty_periods ORDER BY source_key, store, month";
+
+// Unless changed again since it was read
+const QString DELETE_DIRTY_PERIOD = "DELETE FROM dirty_periods WHERE source_key = ? AND store = ? AND month = ? AND version = ?";
+
+// Change feed: a row as it is now (kind bound, then its ID)
+const QString INSERT_CHANGE = "INSERT INTO change_log (shipment_id, root_id, source_key, event_date, kind) "
+                              "SELECT id, COALESCE(root_id, id), source_key, event_date, ? FROM shipments WHERE id = ?";
+
+// Rows of a range of publish_batch, in publish order
+const QString INSERT_CHANGES_OF_PUBLISH_BATCH = "INSERT INTO change_log (shipment_id, root_id, source_key, event_date, kind) "
+                                                "SELECT s.id, b.root_id, s.source_key, s.event_date, 'Published' "
+                                                "FROM publish_batch b "
+                                                "JOIN shipments s ON s.id = b.id "
+                                                "WHERE b.rowid BETWEEN ? AND ? "
+                                                "ORDER BY b.rowid";
+
+const QString SELECT_CHANGES_SINCE = "SELECT seq, shipment_id, root_id, source_key, event_date, kind, changed_at "
+                                     "FROM change_log WHERE seq > ? ORDER BY seq";
+
+const QString SELECT_LAST_CHANGE_SEQ = "SELECT COALESCE(MAX(seq), 0) FROM change_log";
+
+// The last entry is kept so that SELECT_LAST_CHANGE_SEQ never goes back
+const QString DELETE_CHANGES_UNTIL = "DELETE FROM change_log WHERE seq <= ? AND seq < (SELECT MAX(seq) FROM change_log)";
+
+// Pages of the financial events of a root shipment and its revisions for KeysetPager, most recent first
+// (event_date, type, id, amount, currency then the key event_date, id). %1 is the key condition
+const QStringList FINANCIAL_EVENTS_PAGE_KEYS = {"event_date", "id"};
+const QString SELECT_FINANCIAL_EVENTS_OF_ROOT_PAGE = "SELECT event_date, type, id, amount, currency, event_date, id "
+                                                     "FROM financial_events "
+                                                     "WHERE shipment_id IN (SELECT id FROM shipments WHERE id = ? OR root_id = ?)%1 "
+                                                     "ORDER BY event_date DESC, id DESC LIMIT ?";
+
+const QString SELECT_INVOICING_INFO = "SELECT data FROM invoicing_infos WHERE shipment_root_id = ?";
+
+// Statements of the record path, shared by the per-row and the bulk entry points
+// so that a bulk import prepares each of them once and only rebinds values per row.
+const QString INSERT_ORDER_ID = "INSERT OR IGNORE INTO orders (id) VALUES (?)";
+
+const QString UPSERT_ORDER_STORE = "INSERT INTO orders (id, store) VALUES (?, ?) "
+                                   "ON CONFLICT(id) DO UPDATE SET store=excluded.store";
+
+const QString UPDATE_ORDER_ADDRESS = "UPDATE orders SET address_json = ? WHERE id = ?";
+
+// Status of a root shipment with its latest published row (a NewVersion, else itself)
+const QString SELECT_SHIPMENT_STATUS = "SELECT r.status, r.content_hash, r.source_key, "
+                                       "COALESCE(p.id, r.id), COALESCE(p.current_data, r.current_data), "
+                                       "COALESCE(p.content_hash, r.content_hash), COALESCE(p.tax_hash, r.tax_hash) "
+                                       "FROM shipments r "
+                                       "LEFT JOIN shipment_heads h ON h.root_id = r.id "
+                                       "LEFT JOIN shipments p ON p.id = h.published_head_id "
+                                       "WHERE r.id = ?";
+
+const QString UPSERT_HEAD = "INSERT INTO shipment_heads (root_id, head_id) VALUES (?, ?) "
+                            "ON CONFLICT(root_id) DO UPDATE SET head_id = excluded.head_id";
+
+const QString SELECT_DRAFT_REVISIONS = "SELECT id, revision_kind FROM shipments WHERE root_id = ? AND status = 'Draft'";
+
+const QString UPDATE_SHIPMENT_DRAFT = "UPDATE shipments SET original_data = ?, current_data = ?, content_hash = ?, tax_hash = ?, event_date = ?, source_key = ? WHERE id = ?";
+
+const QString UPDATE_SHIPMENT_CURRENT = "UPDATE shipments SET current_data = ?, content_hash = ?, tax_hash = ?, event_date = ?, source_key = ? WHERE id = ?";
+
+const QString INSERT_SHIPMENT = "INSERT INTO shipments (id, order_id, status, original_data, current_data, content_hash, tax_hash, event_date, source_key) VALUES (?, ?, 'Draft', ?, ?, ?, ?, ?, ?)";
+
+const QString INSERT_SHIPMENT_REVISION = "INSERT INTO shipments (id, order_id, status, original_data, current_data, content_hash, tax_hash, event_date, source_key, root_id, revision_kind) VALUES (?, ?, 'Draft', ?, ?, ?, ?, ?, ?, ?, ?)";
+
+const QString DELETE_ACTIVITIES = "DELETE FROM activities WHERE shipment_id = ?";
+
+const QString INSERT_ACTIVITY = "INSERT INTO activities (shipment_id, position, event_id, activity_id, sub_activity_id, date_time, currency, "
+                                "country_from, country_to, country_vat_paid_to, amount_taxed, amount_taxes, vat_rate, tax_source, "
+                                "tax_declaring_country, tax_scheme, tax_jurisdiction_level, sale_type, vat_territory_from, vat_territory_to) "
+                                "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+const QString SELECT_ACTIVITIES_OF_SHIPMENT = "SELECT sub_activity_id, date_time, currency, amount_taxed, amount_taxes "
+                                              "FROM activities WHERE shipment_id = ? ORDER BY position";
+
+// Used by the data backfills of migrations 2, 3, 5 and 6
+const QString SELECT_ALL_SHIPMENT_JSONS = "SELECT id, root_id, current_json FROM shipments";
+
+const QString SELECT_ALL_JSONS = "SELECT id, original_json, current_json, published_json FROM shipments";
+
+const QString UPDATE_SHIPMENT_DATA = "UPDATE shipments SET original_data = ?, current_data = ?, published_data = ?, content_hash = ? WHERE id = ?";
+
+const QString SELECT_INVOICING_INFO_JSONS = "SELECT shipment_root_id, json FROM invoicing_infos";
+
+const QString UPDATE_INVOICING_INFO_DATA = "UPDATE invoicing_infos SET data = ? WHERE shipment_root_id = ?";
+
+const QString SELECT_REVERSAL_JSONS = "SELECT id, original_json, current_json, published_json FROM shipments WHERE revision_kind = 'Reversal'";
+
+const QString UPDATE_SHIPMENT_HASHES = "UPDATE shipments SET content_hash = ?, tax_hash = ? WHERE id = ?";
+
+const QString UPDATE_SHIPMENT_JSONS = "UPDATE shipments SET original_json = ?, current_json = ?, published_json = ? WHERE id = ?";
+
+// Order timeline: each statement is one lookup by order ID (orders primary key, then idx_shipments_order)
+const QString SELECT_ORDER = "SELECT store, address_json FROM orders WHERE id = ?";
+
+// Rows of an order with their head pointers (is head, is published head)
+const QString SELECT_SHIPMENTS_OF_ORDER = "SELECT s.id, COALESCE(s.root_id, s.id), s.revision_kind, s.status, s.event_date, "
+                                          "s.publication_date, s.source_key, s.current_data, "
+                                          "COALESCE(h.head_id = s.id, 0), COALESCE(h.published_head_id = s.id, 0) "
+                                          "FROM shipments s "
+                                          "LEFT JOIN shipment_heads h ON h.root_id = COALESCE(s.root_id, s.id) "
+                                          "WHERE s.order_id = ? "
+                                          "ORDER BY s.event_date, s.id";
+
+const QString SELECT_FINANCIAL_EVENTS_OF_ORDER = "SELECT e.event_date, e.type, e.id, e.amount, e.currency, e.shipment_id "
+                                                 "FROM shipments s "
+                                                 "JOIN financial_events e ON e.shipment_id = s.id "
+                                                 "WHERE s.order_id = ? "
+                                                 "ORDER BY e.event_date, e.id";
+
+const QString SELECT_INVOICING_INFOS_OF_ORDER = "SELECT i.shipment_root_id, i.data "
+                                                "FROM shipments s "
+                                                "JOIN invoicing_infos i ON i.shipment_root_id = s.id "
+                                                "WHERE s.order_id = ? AND s.root_id IS NULL";
+
+// Net totals of a period in one database (%1: main or an attached yearly partition): as reversals are stored negated,
+// summing all rows (drafts and revisions included) gives the amounts of the latest version of each shipment
+const QString SELECT_ACTIVITY_TOTALS_OF_SCHEMA = "SELECT o.store AS store, a.currency AS currency, a.country_from AS country_from, "
+                                                 "a.country_to AS country_to, a.tax_scheme AS tax_scheme, a.vat_rate AS vat_rate, "
+                                                 "SUM(a.amount_taxed) AS amount_taxed, SUM(a.amount_taxes) AS amount_taxes, COUNT(*) AS n "
+                                                 "FROM %1.shipments s "
+                                                 "JOIN %1.activities a ON a.shipment_id = s.id "
+                                                 "LEFT JOIN %1.orders o ON s.order_id = o.id "
+                                                 "WHERE s.event_date >= ? AND s.event_date <= ? "
+                                                 "GROUP BY o.store, a.currency, a.country_from, a.country_to, a.tax_scheme, a.vat_rate";
+
+const QString SELECT_ACTIVITY_TOTALS_PERIOD = SELECT_ACTIVITY_TOTALS_OF_SCHEMA.arg("main");
+
+// Totals of a period spanning several databases, %1 being their SELECT_ACTIVITY_TOTALS_OF_SCHEMA joined with UNION ALL
+const QString SELECT_ACTIVITY_TOTALS_OF_UNION = "SELECT store, currency, country_from, country_to, tax_scheme, vat_rate, "
+                                                "SUM(amount_taxed), SUM(amount_taxes), SUM(n) "
+                                                "FROM (%1) "
+                                                "GROUP BY store, currency, country_from, country_to, tax_scheme, vat_rate";
+
+// Period aggregates of a range of months (YYYY-MM) in one database (%1: main or an attached yearly partition),
+// %2 being empty or " AND source_key = ?"
+const QString SELECT_PERIOD_AGGREGATES_OF_SCHEMA = "SELECT month, source_key, store, tax_scheme, country_from, country_to, "
+                                                   "vat_rate, currency, amount_taxed, amount_taxes, count "
+                                                   "FROM %1.period_aggregates "
+                                                   "WHERE month >= ? AND month <= ?%2";
+
+// Sums of the SELECT_PERIOD_AGGREGATES_OF_SCHEMA of the databases covering the months (%1, joined with UNION ALL),
+// fully reversed groups left out
+const QString SELECT_PERIOD_AGGREGATES_OF_UNION = "SELECT month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency, "
+                                                  "SUM(amount_taxed), SUM(amount_taxes), SUM(count) "
+                                                  "FROM (%1) "
+                                                  "GROUP BY month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency "
+                                                  "HAVING SUM(count) != 0 OR SUM(amount_taxed) != 0 OR SUM(amount_taxes) != 0 "
+                                                  "ORDER BY month, source_key, store, tax_scheme, country_from, country_to, vat_rate, currency";
+
+// Same in Orders.db only, of all sources or of one
+const QString SELECT_PERIOD_AGGREGATES = SELECT_PERIOD_AGGREGATES_OF_UNION.arg(SELECT_PERIOD_AGGREGATES_OF_SCHEMA.arg("main", ""));
+
+const QString SELECT_PERIOD_AGGREGATES_OF_SOURCE = SELECT_PERIOD_AGGREGATES_OF_UNION.arg(
+            SELECT_PERIOD_AGGREGATES_OF_SCHEMA.arg("main", " AND source_key = ?"));
+
+// Yearly archiving: closed years are moved from Orders.db into Orders-<year>.db partitions of the same schema.
+// A root shipment is archived with all its revisions once they are all published and dated before a year end,
+// each row going to the partition of its own event year (and its activities, financial events, order, head and
+// invoicing info with it), so that Orders.db keeps every revision group that can still change
+const QStringList CREATE_ARCHIVE_BATCH = {
+    R"(
+    CREATE TEMP TABLE IF NOT EXISTS archive_batch (
+        id TEXT PRIMARY KEY,
+        root_id TEXT NOT NULL, -- Own ID for a root shipment
+        order_id TEXT NOT NULL,
+        year INTEGER NOT NULL -- Of event_date, the partition of the row
+    )
+    )",
+    "CREATE INDEX IF NOT EXISTS temp.idx_archive_batch_year ON archive_batch(year)",
+    "CREATE INDEX IF NOT EXISTS temp.idx_archive_batch_order ON archive_batch(order_id)"
+};
+
+const QString CLEAR_ARCHIVE_BATCH = "DELETE FROM archive_batch";
+
+// A partition is attached as archive to be written, and read-only as y<year> by period queries, with a URI filename
+// ending with ?mode=ro (connections are opened with QSQLITE_OPEN_URI). A schema name can't be a bound value
+const QString ATTACH_DATABASE = "ATTACH DATABASE ? AS %1";
+
+const QString DETACH_DATABASE = "DETACH DATABASE %1";
+
+// Partitions use a rollback journal so that they can be attached read-only without a -shm file
+const QString PARTITION_JOURNAL_MODE = "PRAGMA journal_mode = DELETE";
+
+// Rows dated before the bound first day of the year following the last archived one, of closed revision groups
+const QString INSERT_ARCHIVE_BATCH_BEFORE = "INSERT INTO archive_batch (id, root_id, order_id, year) "
+                                            "SELECT s.id, COALESCE(s.root_id, s.id), s.order_id, CAST(substr(s.event_date, 1, 4) AS INTEGER) "
+                                            "FROM shipments s "
+                                            "WHERE s.event_date < ? "
+                                            "AND NOT EXISTS (SELECT 1 FROM shipments r "
+                                            "WHERE (r.id = COALESCE(s.root_id, s.id) OR r.root_id = COALESCE(s.root_id, s.id)) "
+                                            "AND (r.status != 'Published' OR r.event_date IS NULL OR r.event_date >= ?))";
+
+const QString SELECT_ARCHIVE_BATCH_YEAR_RANGE = "SELECT (SELECT MIN(year) FROM archive_batch), (SELECT MAX(year) FROM archive_batch)";
+
+const QString SELECT_ARCHIVE_BATCH_HAS_YEAR = "SELECT EXISTS (SELECT 1 FROM archive_batch WHERE year = ?)";
+
+// Copies the rows of archive_batch with a year in the bound range into the attached partition %1.
+// INSERT OR REPLACE so that archiving again after an interruption doesn't fail
+const QStringList COPY_ARCHIVE_BATCH = {
+    "INSERT OR REPLACE INTO %1.orders (id, address_json, store) "
+    "SELECT o.id, o.address_json, o.store FROM main.orders o "
+    "WHERE o.id IN (SELECT order_id FROM archive_batch WHERE year BETWEEN ? AND ?)",
+    "INSERT OR REPLACE INTO %1.shipments (id, order_id, status, publication_date, event_date, source_key, root_id, "
+    "revision_kind, content_hash, tax_hash, original_data, current_data, published_data) "
+    "SELECT s.id, s.order_id, s.status, s.publication_date, s.event_date, s.source_key, s.root_id, "
+    "s.revision_kind, s.content_hash, s.tax_hash, s.original_data, s.current_data, s.published_data FROM main.shipments s "
+    "WHERE s.id IN (SELECT id FROM archive_batch WHERE year BETWEEN ? AND ?)",
+    "INSERT OR REPLACE INTO %1.activities SELECT a.* FROM main.activities a "
+    "WHERE a.shipment_id IN (SELECT id FROM archive_batch WHERE year BETWEEN ? AND ?)",
+    "INSERT OR REPLACE INTO %1.financial_events (id, shipment_id, type, event_date, amount, currency) "
+    "SELECT f.id, f.shipment_id, f.type, f.event_date, f.amount, f.currency FROM main.financial_events f "
+    "WHERE f.shipment_id IN (SELECT id FROM archive_batch WHERE year BETWEEN ? AND ?)",
+    "INSERT OR REPLACE INTO %1.shipment_heads (root_id, head_id, published_head_id) "
+    "SELECT h.root_id, h.head_id, h.published_head_id FROM main.shipment_heads h "
+    "WHERE h.root_id IN (SELECT id FROM archive_batch WHERE id = root_id AND year BETWEEN ? AND ?)",
+    "INSERT OR REPLACE INTO %1.invoicing_infos (shipment_root_id, data) "
+    "SELECT i.shipment_root_id, i.data FROM main.invoicing_infos i "
+    "WHERE i.shipment_root_id IN (SELECT id FROM archive_batch WHERE id = root_id AND year BETWEEN ? AND ?)"
+};
+
+// Rows leaving Orders.db, logged before DELETE_ARCHIVE_BATCH (kind bound: Archived or Removed)
+const QString INSERT_CHANGES_OF_ARCHIVE_BATCH = "INSERT INTO change_log (shipment_id, root_id, source_key, event_date, kind) "
+                                                "SELECT s.id, archive_batch.root_id, s.source_key, s.event_date, ? "
+                                                "FROM archive_batch "
+                                                "JOIN shipments s ON s.id = archive_batch.id";
+
+// Removes the rows of archive_batch from Orders.db, children first for the foreign keys
+// (the root of each archived row being archived too, heads and invoicing infos are matched by id)
+const QStringList DELETE_ARCHIVE_BATCH = {
+    "DELETE FROM financial_events WHERE shipment_id IN (SELECT id FROM archive_batch)",
+    "DELETE FROM activities WHERE shipment_id IN (SELECT id FROM archive_batch)",
+    "DELETE FROM shipment_heads WHERE root_id IN (SELECT id FROM archive_batch)",
+    "DELETE FROM invoicing_infos WHERE shipment_root_id IN (SELECT id FROM archive_batch)",
+    "DELETE FROM shipments WHERE id IN (SELECT id FROM archive_batch)",
+    "DELETE FROM orders WHERE id IN (SELECT order_id FROM archive_batch) "
+    "AND NOT EXISTS (SELECT 1 FROM shipments s WHERE s.order_id = orders.id)"
+};
+
+const QString SELECT_ROOT_ID = "SELECT COALESCE(root_id, id) FROM shipments WHERE id = ?";
+
+const QString UPSERT_INVOICING_INFO = "INSERT OR REPLACE INTO invoicing_infos (shipment_root_id, data) VALUES (?, ?)";
+
+// Maintenance. clearUnpublished() removes every draft row: the heads of published roots point back to their latest
+// published row, draft roots are removed with their head and invoicing info. The drafts are logged as Removed first
+const QStringList CLEAR_UNPUBLISHED = {
+    "INSERT INTO change_log (shipment_id, root_id, source_key, event_date, kind) "
+    "SELECT id, COALESCE(root_id, id), source_key, event_date, 'Removed' FROM shipments WHERE status = 'Draft'",
+    "UPDATE shipment_heads SET head_id = COALESCE(published_head_id, root_id) "
+    "WHERE root_id IN (SELECT root_id FROM shipments WHERE status = 'Draft' AND root_id IS NOT NULL)",
+    "DELETE FROM shipment_heads WHERE root_id IN (SELECT id FROM shipments WHERE status = 'Draft' AND root_id IS NULL)",
+    "DELETE FROM invoicing_infos WHERE shipment_root_id IN (SELECT id FROM shipments WHERE status = 'Draft' AND root_id IS NULL)",
+    "DELETE FROM activities WHERE shipment_id IN (SELECT id FROM shipments WHERE status = 'Draft')",
+    "DELETE FROM shipments WHERE status = 'Draft'"
+};
+
+// deleteDatabase(): whole tables, children first for the foreign keys
+const QStringList DELETE_ALL = {
+    "DELETE FROM financial_events",
+    "DELETE FROM activities",
+    "DELETE FROM shipment_heads",
+    "DELETE FROM invoicing_infos",
+    "DELETE FROM shipments",
+    "DELETE FROM orders",
+    "DELETE FROM period_aggregates",
+    "DELETE FROM dirty_periods",
+    "DELETE FROM change_log",
+    "INSERT INTO change_log (kind) VALUES ('Reset')"
+};
+
+// compact() lists the draft revisions left behind in a connection-local table: the revisions of a root that isn't
+// a published row, the NewVersion drafts that aren't the head of their root (recordShipmentFromSource rewrites the
+// current one in place), then the Reversal drafts whose NewVersion (same root and timestamp) is missing or pruned
+const QStringList CREATE_COMPACTION_BATCH = {
+    "CREATE TEMP TABLE IF NOT EXISTS compaction_batch (id TEXT PRIMARY KEY)"
+};
+
+const QString CLEAR_COMPACTION_BATCH = "DELETE FROM compaction_batch";
+
+const QString INSERT_COMPACTION_ORPHAN_DRAFTS = "INSERT OR IGNORE INTO compaction_batch (id) "
+                                                "SELECT s.id FROM shipments s "
+                                                "WHERE s.status = 'Draft' AND s.root_id IS NOT NULL "
+                                                "AND (NOT EXISTS (SELECT 1 FROM shipments r WHERE r.id = s.root_id AND r.status = 'Published') "
+                                                "OR (s.revision_kind = 'NewVersion' AND NOT EXISTS "
+                                                "(SELECT 1 FROM shipment_heads h WHERE h.root_id = s.root_id AND h.head_id = s.id)))";
+
+// <root>-rev-<timestamp> goes with <root>-v-<timestamp>
+const QString INSERT_COMPACTION_ORPHAN_REVERSALS = "INSERT OR IGNORE INTO compaction_batch (id) "
+                                                   "SELECT s.id FROM shipments s "
+                                                   "WHERE s.status = 'Draft' AND s.revision_kind = 'Reversal' "
+                                                   "AND (s.root_id || '-v-' || substr(s.id, length(s.root_id) + 6) IN (SELECT id FROM compaction_batch) "
+                                                   "OR NOT EXISTS (SELECT 1 FROM shipments v "
+                                                   "WHERE v.id = s.root_id || '-v-' || substr(s.id, length(s.root_id) + 6)))";
+
+const QString SELECT_COMPACTION_BATCH_COUNT = "SELECT COUNT(*) FROM compaction_batch";
+
+const QStringList DELETE_COMPACTION_BATCH = {
+    "INSERT INTO change_log (shipment_id, root_id, source_key, event_date, kind) "
+    "SELECT s.id, COALESCE(s.root_id, s.id), s.source_key, s.event_date, 'Removed' "
+    "FROM compaction_batch b JOIN shipments s ON s.id = b.id",
+    "UPDATE shipment_heads SET head_id = COALESCE(published_head_id, root_id) "
+    "WHERE root_id IN (SELECT s.root_id FROM compaction_batch b JOIN shipments s ON s.id = b.id) "
+    "AND head_id IN (SELECT id FROM compaction_batch)",
+    "DELETE FROM activities WHERE shipment_id IN (SELECT id FROM compaction_batch)",
+    "DELETE FROM shipments WHERE id IN (SELECT id FROM compaction_batch)"
+};
+
+// Invoicing infos whose root shipment is gone (cleared, or recorded for a shipment that never was)
+const QString DELETE_DEAD_INVOICING_INFOS = "DELETE FROM invoicing_infos "
+                                            "WHERE NOT EXISTS (SELECT 1 FROM shipments s WHERE s.id = invoicing_infos.shipment_root_id)";
+
+// Size of Orders.db without its WAL
+const QString SELECT_DATABASE_SIZE = "SELECT page_count * page_size FROM pragma_page_count(), pragma_page_size()";
+
+const QString SELECT_AUTO_VACUUM = "PRAGMA auto_vacuum"; // 2 = INCREMENTAL
+
+const QString SELECT_FREELIST_COUNT = "PRAGMA freelist_count";
+
+const QString AUTO_VACUUM_INCREMENTAL = "PRAGMA auto_vacuum = INCREMENTAL";
+
+const QString VACUUM = "VACUUM";
+
+// Frees one page of the freelist per step
+const QString INCREMENTAL_VACUUM = "PRAGMA incremental_vacuum";
+
+// Statistics of the query planner from a sample of each index, so that it stays fast on a large database
+const QStringList ANALYZE = {
+    "PRAGMA analysis_limit = 1000",
+    "ANALYZE"
+};
+
+const QString WAL_CHECKPOINT_TRUNCATE = "PRAGMA wal_checkpoint(TRUNCATE)";
+
+// Every statement run by OrderManager, checked by TestOrderManagerQueryPlans to never fall back to a full table scan
+// (SELECT_SHIPMENTS_QUERY is checked there with compiled ShipmentQuery filters, SELECT_SHIPMENTS_PAGE with each key
+// to be read in index order, COPY_ARCHIVE_BATCH on main, the publish_batch and archive_batch statements after CREATE_PUBLISH_BATCH and CREATE_ARCHIVE_BATCH).
+// The whole-table maintenance statements of deleteDatabase() and compact(), and SELECT_DIRTY_PERIODS are not in it
+const QStringList ALL_QUERIES = QStringList{
+    SELECT_LAST_EVENT_DATE,
+    SELECT_FIRST_EVENT_DATE,
+    SELECT_HEAD_SHIPMENT,
+    SELECT_SHIPMENT,
+    UPDATE_SHIPMENT_CURRENT_DATA,
+    CLEAR_PUBLISH_BATCH,
+    INSERT_PUBLISH_BATCH_UNTIL,
+    SELECT_PUBLISH_BATCH_RANGE,
+    INSERT_FINANCIAL_EVENTS_OF_BATCH,
+    UPDATE_SHIPMENTS_PUBLISHED_OF_BATCH,
+    UPDATE_PUBLISHED_HEADS_OF_BATCH,
+    SELECT_FINANCIAL_EVENTS_OF_ROOT_PAGE.arg(""),
+    SELECT_FINANCIAL_EVENTS_OF_ROOT_PAGE.arg(" AND (event_date, id) < (?, ?)"),
+    SELECT_INVOICING_INFO,
+    INSERT_ORDER_ID,
+    UPSERT_ORDER_STORE,
+    UPDATE_ORDER_ADDRESS,
+    SELECT_SHIPMENT_STATUS,
+    UPSERT_HEAD,
+    SELECT_DRAFT_REVISIONS,
+    UPDATE_SHIPMENT_DRAFT,
+    UPDATE_SHIPMENT_CURRENT,
+    INSERT_SHIPMENT,
+    INSERT_SHIPMENT_REVISION,
+    SELECT_ROOT_ID,
+    UPSERT_INVOICING_INFO,
+    DELETE_ACTIVITIES,
+    INSERT_ACTIVITY,
+    SELECT_ACTIVITIES_OF_SHIPMENT,
+    SELECT_ACTIVITY_TOTALS_PERIOD,
+    SELECT_ORDER,
+    SELECT_SHIPMENTS_OF_ORDER,
+    SELECT_FINANCIAL_EVENTS_OF_ORDER,
+    SELECT_INVOICING_INFOS_OF_ORDER,
+    UPSERT_PERIOD_AGGREGATES_OF_BATCH,
+    UPSERT_PERIOD_AGGREGATES_OF_SHIPMENT,
+    SELECT_PERIOD_AGGREGATES,
+    SELECT_PERIOD_AGGREGATES_OF_SOURCE,
+    UPSERT_DIRTY_PERIODS_OF_BATCH,
+    UPSERT_DIRTY_PERIOD_OF_SHIPMENT,
+    DELETE_DIRTY_PERIOD,
+    INSERT_CHANGE,
+    INSERT_CHANGES_OF_PUBLISH_BATCH,
+    SELECT_CHANGES_SINCE,
+    SELECT_LAST_CHANGE_SEQ,
+    DELETE_CHANGES_UNTIL,
+    INSERT_CHANGES_OF_ARCHIVE_BATCH,
+    CLEAR_ARCHIVE_BATCH,
+    INSERT_ARCHIVE_BATCH_BEFORE,
+    SELECT_ARCHIVE_BATCH_YEAR_RANGE,
+    SELECT_ARCHIVE_BATCH_HAS_YEAR
+} + DELETE_ARCHIVE_BATCH + CLEAR_UNPUBLISHED;
+
 } // namespace OrderManagerSql
 
 #endif // ORDERMANAGER_SQL_SCHEMA_H
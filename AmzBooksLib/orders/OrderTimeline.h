@@ -0,0 +1,50 @@
+#ifndef ORDERTIMELINE_H
+#define ORDERTIMELINE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+#include "ActivitySource.h"
+#include "RevisionKind.h"
+
+class Address;
+class Shipment;
+class InvoicingInfo;
+
+// OrderTimeline = everything Orders.db knows about an order, read by OrderManager::getOrderTimeline()
+// in one read transaction with indexed lookups by order ID, so that the GUI shows an order in one call.
+struct OrderTimeline {
+    struct Revision {
+        QString id;
+        QString rootId; // Own ID for a root shipment
+        RevisionKind revisionKind;
+        QString status; // "Draft", "Published"
+        QDateTime eventDate;
+        QDateTime publicationDate; // Invalid if not published
+        ActivitySource source;
+        bool isHead = false; // Current effective row of its root
+        bool isPublishedHead = false; // Latest published row of its root
+        QSharedPointer<Shipment> shipment; // Current content, reversals negated
+    };
+    struct FinancialEvent {
+        QString id; // Invoice or credit note number
+        QString shipmentId;
+        QString type; // "Invoice", "CreditNote"
+        QDateTime eventDate;
+        double amount;
+        QString currency;
+    };
+
+    QString orderId;
+    bool found = false; // False if the order is unknown (or archived)
+    QString store;
+    QSharedPointer<Address> addressTo; // Null if not recorded
+    QList<Revision> revisions; // Shipments, refunds and their revisions, in event date order
+    QList<FinancialEvent> financialEvents; // In event date order
+    QHash<QString, QSharedPointer<InvoicingInfo>> rootId_invoicingInfo;
+};
+
+#endif // ORDERTIMELINE_H
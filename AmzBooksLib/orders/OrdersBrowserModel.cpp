@@ -0,0 +1,239 @@
+#include "OrdersBrowserModel.h"
+
+OrdersBrowserModel::OrdersBrowserModel(QSharedPointer<OrderManager> orderManager, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_orderManager(std::move(orderManager))
+{
+    m_workerPool.setMaxThreadCount(1);
+    m_workerPool.setExpiryTimeout(-1);
+
+    m_filterTimer.setSingleShot(true);
+    m_filterTimer.setInterval(FILTER_DELAY_MSECS);
+    connect(&m_filterTimer, &QTimer::timeout, this, [this]() {
+        if (m_pendingOrderIdFilter != m_shipmentQuery.orderIdPrefix) {
+            m_shipmentQuery.orderIdPrefix = m_pendingOrderIdFilter;
+            _reload();
+        }
+    });
+
+    _reload();
+}
+
+OrdersBrowserModel::~OrdersBrowserModel()
+{
+    m_filterTimer.stop();
+    // The pager queries belong to the worker connection, released after the queued reads
+    m_workerPool.start([this]() {
+        m_pager.reset();
+    });
+    m_workerPool.waitForDone();
+}
+
+void OrdersBrowserModel::setShipmentQuery(const ShipmentQuery &shipmentQuery)
+{
+    const QString orderIdPrefix = m_shipmentQuery.orderIdPrefix;
+    m_shipmentQuery = shipmentQuery;
+    m_shipmentQuery.orderIdPrefix = orderIdPrefix;
+    _reload();
+}
+
+const ShipmentQuery &OrdersBrowserModel::getShipmentQuery() const
+{
+    return m_shipmentQuery;
+}
+
+void OrdersBrowserModel::setOrderIdFilter(const QString &orderIdPrefix)
+{
+    m_pendingOrderIdFilter = orderIdPrefix.trimmed();
+    m_filterTimer.start(); // Restarts the delay
+}
+
+void OrdersBrowserModel::setPageSize(int pageSize)
+{
+    m_pageSize = qMax(1, pageSize);
+}
+
+const OrdersBrowserModel::Row &OrdersBrowserModel::getRow(int row) const
+{
+    return m_rows[row];
+}
+
+bool OrdersBrowserModel::isLoading() const
+{
+    return m_loading;
+}
+
+int OrdersBrowserModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return m_rows.size();
+}
+
+int OrdersBrowserModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return ColumnCount;
+}
+
+QVariant OrdersBrowserModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    const auto &row = m_rows[index.row()];
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case ColumnDate: return row.eventDate;
+        case ColumnOrder: return row.orderId;
+        case ColumnShipment: return row.id;
+        case ColumnStore: return row.store;
+        case ColumnSource: return QString("%1 %2").arg(row.source.channel, row.source.subchannel);
+        case ColumnStatus: return row.status;
+        case ColumnRevisionKind: return row.revisionKind;
+        }
+    } else if (role == Qt::ToolTipRole && index.column() == ColumnSource) {
+        return row.source.reportOrMethode;
+    }
+    return QVariant();
+}
+
+QVariant OrdersBrowserModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+
+    switch (section) {
+    case ColumnDate: return tr("Date");
+    case ColumnOrder: return tr("Order");
+    case ColumnShipment: return tr("Shipment");
+    case ColumnStore: return tr("Store");
+    case ColumnSource: return tr("Source");
+    case ColumnStatus: return tr("Status");
+    case ColumnRevisionKind: return tr("Revision");
+    }
+    return QVariant();
+}
+
+bool OrdersBrowserModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return false;
+    }
+    return !m_atEnd;
+}
+
+void OrdersBrowserModel::fetchMore(const QModelIndex &parent)
+{
+    // The view asks again once the page being read is inserted
+    if (parent.isValid() || m_atEnd || m_loading) {
+        return;
+    }
+    _readPage(false);
+}
+
+void OrdersBrowserModel::sort(int column, Qt::SortOrder order)
+{
+    OrderManager::ShipmentSort shipmentSort;
+    switch (column) {
+    case ColumnDate:
+        shipmentSort = OrderManager::ShipmentSort::EventDate;
+        break;
+    case ColumnOrder:
+        shipmentSort = OrderManager::ShipmentSort::OrderId;
+        break;
+    case ColumnShipment:
+        shipmentSort = OrderManager::ShipmentSort::Id;
+        break;
+    case ColumnSource:
+        shipmentSort = OrderManager::ShipmentSort::Source;
+        break;
+    case ColumnStatus:
+        shipmentSort = OrderManager::ShipmentSort::Status;
+        break;
+    default:
+        return;
+    }
+    const auto keysetOrder = order == Qt::AscendingOrder ? KeysetPager::Order::Ascending
+                                                         : KeysetPager::Order::Descending;
+    if (shipmentSort == m_sort && keysetOrder == m_order) {
+        return;
+    }
+    m_sort = shipmentSort;
+    m_order = keysetOrder;
+    _reload();
+}
+
+void OrdersBrowserModel::_reload()
+{
+    ++m_generation;
+    beginResetModel();
+    m_rows.clear();
+    m_atEnd = false;
+    endResetModel();
+    _readPage(true);
+}
+
+void OrdersBrowserModel::_readPage(bool firstPage)
+{
+    _setLoading(true);
+    // Reads are queued on the worker thread in call order, the values of the current reload being copied
+    m_workerPool.start([this,
+                        firstPage,
+                        generation = m_generation,
+                        shipmentQuery = m_shipmentQuery,
+                        shipmentSort = m_sort,
+                        order = m_order,
+                        pageSize = m_pageSize]() {
+        if (firstPage) {
+            m_pager = m_orderManager->openShipmentPager(shipmentQuery, shipmentSort, order);
+            m_pager->setPageSize(pageSize);
+        }
+        const QList<QVariantList> page = m_pager->fetchPage();
+        const bool atEnd = m_pager->atEnd();
+
+        QList<Row> rows;
+        rows.reserve(page.size());
+        QString sourceKey;
+        ActivitySource source = ActivitySource::fromKey(QString());
+        for (const auto &values : page) {
+            // Consecutive rows usually share the source, avoid splitting the key again
+            const QString rowSourceKey = values[3].toString();
+            if (rowSourceKey != sourceKey) {
+                sourceKey = rowSourceKey;
+                source = ActivitySource::fromKey(sourceKey);
+            }
+            rows << Row{values[0].toString(),
+                        values[1].toString(),
+                        values[2].toString(),
+                        source,
+                        QDateTime::fromString(values[4].toString(), Qt::ISODate),
+                        values[5].toString(),
+                        values[6].toString()};
+        }
+        QMetaObject::invokeMethod(this, [this, generation, rows, atEnd]() {
+            _onPageRead(generation, rows, atEnd);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void OrdersBrowserModel::_onPageRead(int generation, const QList<Row> &rows, bool atEnd)
+{
+    if (generation != m_generation) {
+        return; // Page of a previous sort or filter, the current one is still being read
+    }
+    m_atEnd = atEnd;
+    if (!rows.isEmpty()) {
+        beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size() + rows.size() - 1);
+        m_rows << rows;
+        endInsertRows();
+    }
+    _setLoading(false);
+}
+
+void OrdersBrowserModel::_setLoading(bool loading)
+{
+    if (m_loading != loading) {
+        m_loading = loading;
+        emit loadingChanged(loading);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef ORDERSBROWSERMODEL_H
+#define ORDERSBROWSERMODEL_H
+
+#include <QAbstractTableModel>
+#include <QDateTime>
+#include <QList>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "ActivitySource.h"
+#include "OrderManager.h"
+#include "ShipmentQuery.h"
+
+// OrdersBrowserModel = table of the shipment rows of Orders.db, for browsing millions of them.
+// Rows are read one page at a time as the view scrolls (canFetchMore / fetchMore), in the order of an index
+// (see OrderManager::openShipmentPager), on a worker thread with its own connection so that the view never
+// waits for SQLite. Sorting or filtering starts again from the first page; the order id filter is applied
+// once typing pauses.
+class OrdersBrowserModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        ColumnDate,
+        ColumnOrder,
+        ColumnShipment,
+        ColumnStore,
+        ColumnSource,
+        ColumnStatus,
+        ColumnRevisionKind,
+        ColumnCount
+    };
+
+    struct Row {
+        QString id;
+        QString orderId;
+        QString store;
+        ActivitySource source;
+        QDateTime eventDate;
+        QString status;
+        QString revisionKind;
+    };
+
+    static constexpr int FILTER_DELAY_MSECS = 300;
+
+    explicit OrdersBrowserModel(QSharedPointer<OrderManager> orderManager, QObject *parent = nullptr);
+    ~OrdersBrowserModel() override; // Waits for the pages being read
+
+    // Filters on the period, sources, stores, statuses..., applied at once (orderIdPrefix is replaced by the order id filter)
+    void setShipmentQuery(const ShipmentQuery &shipmentQuery);
+    const ShipmentQuery &getShipmentQuery() const;
+    // Order id prefix typed by the user, applied FILTER_DELAY_MSECS after the last call
+    void setOrderIdFilter(const QString &orderIdPrefix);
+    void setPageSize(int pageSize);
+
+    const Row &getRow(int row) const;
+    bool isLoading() const; // A page is being read
+
+    // QAbstractTableModel interface
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    // Store and revision kind columns have no index to read them in order and are not sortable
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+signals:
+    void loadingChanged(bool loading);
+
+private:
+    void _reload();
+    void _readPage(bool firstPage);
+    void _onPageRead(int generation, const QList<OrdersBrowserModel::Row> &rows, bool atEnd);
+    void _setLoading(bool loading);
+
+    QSharedPointer<OrderManager> m_orderManager;
+    ShipmentQuery m_shipmentQuery;
+    OrderManager::ShipmentSort m_sort = OrderManager::ShipmentSort::EventDate;
+    KeysetPager::Order m_order = KeysetPager::Order::Ascending;
+    int m_pageSize = KeysetPager::DEFAULT_PAGE_SIZE;
+    QList<Row> m_rows;
+    bool m_atEnd = false;
+    bool m_loading = false;
+    int m_generation = 0; // Incremented on each reload, so that the pages of a previous sort or filter are dropped
+    QTimer m_filterTimer;
+    QString m_pendingOrderIdFilter;
+    QSharedPointer<KeysetPager> m_pager; // Only used on the worker thread
+    QThreadPool m_workerPool; // One thread that never expires: the worker connection
+};
+
+#endif // ORDERSBROWSERMODEL_H
@@ -0,0 +1,27 @@
+#ifndef PERIODAGGREGATE_H
+#define PERIODAGGREGATE_H
+
+#include <QDate>
+#include <QString>
+
+#include "ActivitySource.h"
+#include "books/TaxScheme.h"
+
+// PeriodAggregate = net published amounts of a month for one source, store, tax scheme, route, VAT rate and currency.
+// OrderManager maintains them in the period_aggregates table on publish (see OrderManager::getPeriodAggregates),
+// so that journal entries and VAT returns read a few rows per month instead of every activity.
+struct PeriodAggregate {
+    QDate month; // First day of the month of the shipment event dates
+    ActivitySource source;
+    QString store; // Empty if the order store is unknown
+    TaxScheme taxScheme;
+    QString countryCodeFrom;
+    QString countryCodeTo;
+    double vatRate; // Fraction, as Activity::getVatRate()
+    QString currency;
+    double amountTaxed;
+    double amountTaxes;
+    int count; // Activities, reversals counting -1
+};
+
+#endif // PERIODAGGREGATE_H
@@ -0,0 +1,25 @@
+#include "RevisionKind.h"
+
+static const QHash<RevisionKind, QString> REVISIONKIND_STRING = {
+    {RevisionKind::Original, "Original"},
+    {RevisionKind::Reversal, "Reversal"},
+    {RevisionKind::NewVersion, "NewVersion"}
+};
+
+static const QHash<QString, RevisionKind> STRING_REVISIONKIND = [] {
+    QHash<QString, RevisionKind> map;
+    for (auto it = REVISIONKIND_STRING.begin(); it != REVISIONKIND_STRING.end(); ++it) {
+        map.insert(it.value(), it.key());
+    }
+    return map;
+}();
+
+QString toString(RevisionKind kind)
+{
+    return REVISIONKIND_STRING.value(kind, "Original");
+}
+
+RevisionKind toRevisionKind(const QString &str)
+{
+    return STRING_REVISIONKIND.value(str, RevisionKind::Original);
+}
@@ -0,0 +1,23 @@
+#ifndef REVISIONKIND_H
+#define REVISIONKIND_H
+
+#include <QHash>
+
+// Kind of a shipment row of Orders.db: the row recorded from the source, or one of the two rows
+// created when a published shipment changes (reversal of the published amounts + new version)
+enum class RevisionKind {
+    Original,
+    Reversal,
+    NewVersion
+};
+
+inline uint qHash(RevisionKind key, uint seed = 0)
+{
+    return ::qHash(static_cast<int>(key), seed);
+}
+
+QString toString(RevisionKind kind);
+RevisionKind toRevisionKind(const QString &str);
+
+
+#endif // REVISIONKIND_H
@@ -1,5 +1,7 @@
 #include "Shipment.h"
 #include <QJsonArray>
+#include <QCborValue>
+#include <QDebug>
 
 Shipment::Shipment(QList<Activity> activities)
     : m_activities(std::move(activities))
@@ -19,6 +21,26 @@ const QList<Activity>& Shipment::getActivities() const noexcept
     return m_activities;
 }
 
+Shipment Shipment::negated() const
+{
+    QList<Activity> activities;
+    activities.reserve(m_activities.size());
+    for (const auto &activity : m_activities) {
+        activities << activity.negated();
+    }
+    return Shipment(activities);
+}
+
+QByteArray Shipment::taxHash() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(m_activities.size()));
+    for (const auto &activity : m_activities) {
+        activity.addTaxFieldsToHash(hash);
+    }
+    return hash.result();
+}
+
 QJsonObject Shipment::toJson() const
 {
     QJsonArray arr;
@@ -45,3 +67,30 @@ Shipment Shipment::fromJson(const QJsonObject &json)
     return Shipment(list);
 }
 
+
+QByteArray Shipment::toCbor() const
+{
+    QCborArray activities;
+    for (const auto &act : m_activities) {
+        activities.append(act.toCbor());
+    }
+    // Amounts are written as half / single precision floats when it is lossless
+    return QCborValue(QCborArray{CBOR_VERSION, activities}).toCbor(
+                QCborValue::UseFloat | QCborValue::UseFloat16);
+}
+
+Shipment Shipment::fromCbor(const QByteArray &data)
+{
+    const QCborArray cbor = QCborValue::fromCbor(data).toArray();
+    QList<Activity> list;
+    if (cbor.at(0).toInteger() != CBOR_VERSION) {
+        qWarning() << "Unsupported shipment encoding version:" << cbor.at(0).toInteger();
+        return Shipment(list);
+    }
+    const QCborArray activities = cbor.at(1).toArray();
+    list.reserve(activities.size());
+    for (const auto &val : activities) {
+        list.append(Activity::fromCbor(val.toArray()));
+    }
+    return Shipment(list);
+}
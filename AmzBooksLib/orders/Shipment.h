@@ -18,9 +18,21 @@ public:
 
     const QList<Activity>& getActivities() const noexcept;
 
+    // Same shipment with negated activities (content of a reversal)
+    Shipment negated() const;
+
+    // Hash of the fields compared by OrderManager conflict detection (activity count + Activity::isDifferentTaxes)
+    QByteArray taxHash() const;
+
     static Shipment fromJson(const QJsonObject &json);
     QJsonObject toJson() const;
 
+    // Compact binary encoding stored in Orders.db: a CBOR array [CBOR_VERSION, [activities]]
+    // with positional fields, deterministic so that equal content gives equal bytes
+    static constexpr int CBOR_VERSION = 1;
+    static Shipment fromCbor(const QByteArray &data);
+    QByteArray toCbor() const;
+
 protected:
     QList<Activity> m_activities;
 };
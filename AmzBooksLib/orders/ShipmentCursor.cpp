@@ -0,0 +1,56 @@
+#include "ShipmentCursor.h"
+
+ShipmentCursor::ShipmentCursor(QSqlQuery &&query)
+    : m_query(std::move(query))
+    , m_activitySource(ActivitySource::fromKey(QString()))
+    , m_shipment(QList<Activity>{})
+{
+}
+
+bool ShipmentCursor::next()
+{
+    if (!m_query.next()) {
+        m_query.finish();
+        return false;
+    }
+    const QByteArray data = m_query.value(0).toByteArray();
+    const QString sourceKey = m_query.value(1).toString();
+    m_dateTime = QDateTime::fromString(m_query.value(2).toString(), Qt::ISODate);
+    m_id = m_query.value(3).toString();
+    m_store = m_query.value(4).toString();
+
+    // Consecutive rows usually share the source, avoid splitting the key again
+    if (sourceKey != m_sourceKey) {
+        m_sourceKey = sourceKey;
+        m_activitySource = ActivitySource::fromKey(sourceKey);
+    }
+
+    // Reversal rows are stored negated
+    m_shipment = Shipment::fromCbor(data);
+    return true;
+}
+
+const ActivitySource &ShipmentCursor::getActivitySource() const noexcept
+{
+    return m_activitySource;
+}
+
+const QString &ShipmentCursor::getStore() const noexcept
+{
+    return m_store;
+}
+
+const QDateTime &ShipmentCursor::getDateTime() const noexcept
+{
+    return m_dateTime;
+}
+
+const QString &ShipmentCursor::getId() const noexcept
+{
+    return m_id;
+}
+
+const Shipment &ShipmentCursor::getShipment() const noexcept
+{
+    return m_shipment;
+}
@@ -0,0 +1,43 @@
+#ifndef SHIPMENTCURSOR_H
+#define SHIPMENTCURSOR_H
+
+#include <QString>
+#include <QDateTime>
+#include <QSqlQuery>
+
+#include "ActivitySource.h"
+#include "Shipment.h"
+
+// ShipmentCursor = forward-only iteration over the shipment / refund rows of Orders.db, ordered by event date,
+// decoding one row at a time so that a full fiscal year can be aggregated with constant memory.
+// Reversal rows come with negated activities, as they are stored.
+// Obtained from OrderManager::openShipmentCursor(); must not outlive the OrderManager.
+class ShipmentCursor
+{
+public:
+    // query must be executed and select current_data, source_key, event_date, id, store
+    explicit ShipmentCursor(QSqlQuery &&query);
+    ShipmentCursor(const ShipmentCursor &) = delete;
+    ShipmentCursor &operator=(const ShipmentCursor &) = delete;
+
+    // Moves to the next row, returns false when all rows were read
+    bool next();
+
+    // Values of the current row (valid after next() returned true)
+    const ActivitySource &getActivitySource() const noexcept;
+    const QString &getStore() const noexcept;
+    const QDateTime &getDateTime() const noexcept;
+    const QString &getId() const noexcept;
+    const Shipment &getShipment() const noexcept;
+
+private:
+    QSqlQuery m_query;
+    QString m_sourceKey;
+    ActivitySource m_activitySource;
+    QString m_store;
+    QDateTime m_dateTime;
+    QString m_id;
+    Shipment m_shipment;
+};
+
+#endif // SHIPMENTCURSOR_H
@@ -0,0 +1,100 @@
+#include "ShipmentQuery.h"
+#include "OrderManager_sql_schema.h"
+
+namespace {
+    QString placeholders(qsizetype count) {
+        QStringList marks;
+        marks.reserve(count);
+        for (qsizetype i = 0; i < count; ++i) {
+            marks << "?";
+        }
+        return marks.join(", ");
+    }
+
+    // "column IN (?, ?)" and its bound values
+    template<typename T, typename ToVariant>
+    QString inClause(const QString &column, const QList<T> &values, QVariantList &bindValues, ToVariant toVariant) {
+        for (const auto &value : values) {
+            bindValues << toVariant(value);
+        }
+        return QString("%1 IN (%2)").arg(column, placeholders(values.size()));
+    }
+
+    QString inClause(const QString &column, const QStringList &values, QVariantList &bindValues) {
+        return inClause(column, values, bindValues, [](const QString &value) { return QVariant(value); });
+    }
+
+    // Makes a value literal in a GLOB pattern
+    QString escapeGlob(const QString &value) {
+        QString escaped;
+        escaped.reserve(value.size());
+        for (const QChar &c : value) {
+            if (c == '*' || c == '?' || c == '[') {
+                escaped += QString("[%1]").arg(c);
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+}
+
+QString ShipmentQuery::toWhereClause(QVariantList &bindValues, const QString &schema, bool useDateIndex) const
+{
+    // The event_date range is always bound so that the event_date indexes stay usable,
+    // unary + keeping SQLite from picking them when the rows are read in the order of another index
+    QStringList conditions{useDateIndex ? "s.event_date >= ? AND s.event_date <= ?"
+                                        : "+s.event_date >= ? AND +s.event_date <= ?"};
+    bindValues << (dateFrom.isValid() ? dateFrom.toString(Qt::ISODate) : OrderManagerSql::EVENT_DATE_MIN);
+    bindValues << (dateTo.isValid() ? dateTo.toString(Qt::ISODate) : OrderManagerSql::EVENT_DATE_MAX);
+
+    if (!sources.isEmpty()) {
+        conditions << inClause("s.source_key", sources, bindValues, [](const ActivitySource &source) {
+            return QVariant(source.toKey());
+        });
+    }
+    if (!channels.isEmpty()) {
+        // source_key is type|channel|subchannel|report
+        QStringList channelConditions;
+        for (const auto &channel : channels) {
+            channelConditions << "substr(s.source_key, instr(s.source_key, '|') + 1) GLOB ?";
+            bindValues << escapeGlob(channel) + "|*";
+        }
+        conditions << "(" + channelConditions.join(" OR ") + ")";
+    }
+    if (!orderIdPrefix.isEmpty()) {
+        // A prefix GLOB is a range of idx_shipments_order
+        conditions << "s.order_id GLOB ?";
+        bindValues << escapeGlob(orderIdPrefix) + "*";
+    }
+    if (!stores.isEmpty()) {
+        conditions << inClause("o.store", stores, bindValues);
+    }
+    if (!statuses.isEmpty()) {
+        conditions << inClause("s.status", statuses, bindValues);
+    }
+    if (!revisionKinds.isEmpty()) {
+        conditions << inClause("s.revision_kind", revisionKinds, bindValues, [](RevisionKind kind) {
+            return QVariant(toString(kind));
+        });
+    }
+
+    QStringList activityConditions;
+    if (!taxSchemes.isEmpty()) {
+        activityConditions << inClause("a.tax_scheme", taxSchemes, bindValues, [](TaxScheme scheme) {
+            return QVariant(static_cast<int>(scheme));
+        });
+    }
+    if (!countryCodesFrom.isEmpty()) {
+        activityConditions << inClause("a.country_from", countryCodesFrom, bindValues);
+    }
+    if (!countryCodesTo.isEmpty()) {
+        activityConditions << inClause("a.country_to", countryCodesTo, bindValues);
+    }
+    if (!activityConditions.isEmpty()) {
+        conditions << QString("EXISTS (SELECT 1 FROM %1.activities a WHERE a.shipment_id = s.id AND %2)")
+                      .arg(schema, activityConditions.join(" AND "));
+    }
+
+    return conditions.join(" AND ");
+}
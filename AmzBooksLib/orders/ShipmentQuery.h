@@ -0,0 +1,37 @@
+#ifndef SHIPMENTQUERY_H
+#define SHIPMENTQUERY_H
+
+#include <QDate>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+#include "ActivitySource.h"
+#include "RevisionKind.h"
+#include "books/TaxScheme.h"
+
+// ShipmentQuery = declarative filter of the OrderManager period queries, compiled into an SQL WHERE clause
+// with bound values so that rows are filtered by SQLite before their JSON is decoded.
+// An empty list means no filter on that field; the filters of different fields are combined with AND.
+struct ShipmentQuery {
+    QDate dateFrom; // Invalid = open
+    QDate dateTo;   // Invalid = open
+    QList<ActivitySource> sources;
+    QStringList channels; // ActivitySource::channel, whatever the rest of the source
+    QStringList stores;
+    QString orderIdPrefix; // Orders whose id starts with it
+    // Activity filters: a shipment matches if one of its activities matches all of them
+    QList<TaxScheme> taxSchemes;
+    QStringList countryCodesFrom;
+    QStringList countryCodesTo;
+    QStringList statuses; // "Draft", "Published"
+    QList<RevisionKind> revisionKinds;
+
+    // Condition over shipments s (joined with orders o) of a database schema (main or an attached yearly partition),
+    // appending its bound values in order. useDateIndex false checks the period on each row instead of selecting
+    // the rows with idx_shipments_event_date, for reading them in the order of another index
+    QString toWhereClause(QVariantList &bindValues, const QString &schema = "main", bool useDateIndex = true) const;
+};
+
+#endif // SHIPMENTQUERY_H
@@ -23,8 +23,36 @@ SET(ORDERS_FILES
     ${CMAKE_CURRENT_LIST_DIR}/Result.h
     ${CMAKE_CURRENT_LIST_DIR}/OrderManager.cpp
     ${CMAKE_CURRENT_LIST_DIR}/OrderManager.h
+    ${CMAKE_CURRENT_LIST_DIR}/OrderManagerAsync.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/OrderManagerAsync.h
+    ${CMAKE_CURRENT_LIST_DIR}/ShipmentCursor.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ShipmentCursor.h
+    ${CMAKE_CURRENT_LIST_DIR}/KeysetPager.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/KeysetPager.h
+    ${CMAKE_CURRENT_LIST_DIR}/ContentHash.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ContentHash.h
+    ${CMAKE_CURRENT_LIST_DIR}/CsvStreamReader.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/CsvStreamReader.h
+    ${CMAKE_CURRENT_LIST_DIR}/ClosedKeySet.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ClosedKeySet.h
+    ${CMAKE_CURRENT_LIST_DIR}/FieldDecoder.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/FieldDecoder.h
+    ${CMAKE_CURRENT_LIST_DIR}/ImportedRowIndex.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ImportedRowIndex.h
+    ${CMAKE_CURRENT_LIST_DIR}/ImportedReports.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ImportedReports.h
+    ${CMAKE_CURRENT_LIST_DIR}/ShipmentQuery.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ShipmentQuery.h
+    ${CMAKE_CURRENT_LIST_DIR}/PeriodAggregate.h
+    ${CMAKE_CURRENT_LIST_DIR}/OrderTimeline.h
+    ${CMAKE_CURRENT_LIST_DIR}/RevisionKind.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/RevisionKind.h
+    ${CMAKE_CURRENT_LIST_DIR}/ChangeKind.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ChangeKind.h
     ${CMAKE_CURRENT_LIST_DIR}/ActivityUpdate.cpp
     ${CMAKE_CURRENT_LIST_DIR}/ActivityUpdate.h
+    ${CMAKE_CURRENT_LIST_DIR}/OrdersBrowserModel.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/OrdersBrowserModel.h
     ${CMAKE_CURRENT_LIST_DIR}/AbstractImporter.cpp
     ${CMAKE_CURRENT_LIST_DIR}/AbstractImporter.h
     ${CMAKE_CURRENT_LIST_DIR}/AbstractImporterApi.cpp